@@ -27,6 +27,10 @@
 #include "tracepoint.h"
 #include "location.h"
 #include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
 #include <tcl.h>
 #include "gdbtk.h"
 #include "gdbtk-cmds.h"
@@ -39,6 +43,53 @@ static Tcl_Obj **gdbtk_obj_array;
 static int gdbtk_obj_array_cnt;
 static int gdbtk_obj_array_ptr;
 
+/* Bumped whenever a breakpoint is created, deleted or modified, so that
+   gdb_get_breakpoints callers can tell whether their copy is stale.  */
+static long breakpoint_generation = 1;
+
+/* The breakpoint location index used by gdb_find_bp_at_line and
+   gdb_find_bp_at_addr.  BP_LINE_INDEX maps the full name of a source
+   file to the breakpoints set on each of its lines, and BP_ADDR_INDEX
+   maps an address to the breakpoints with a location there.
+   BP_INDEX_POINTS remembers what was entered for each breakpoint, so
+   that it can be taken out again when the breakpoint changes.  The
+   index is built on first use and kept up to date by the breakpoint
+   observers below; BP_INDEX_FILES caches the full names of the file
+   names looked up.  */
+struct bp_index_locations
+{
+  std::vector<CORE_ADDR> addresses;
+  std::vector<std::pair<std::string, int> > lines;
+};
+
+static bool bp_index_valid;
+static std::map<std::string, std::multimap<int, int> > bp_line_index;
+static std::multimap<CORE_ADDR, int> bp_addr_index;
+static std::map<int, bp_index_locations> bp_index_points;
+static std::map<std::string, std::string> bp_index_files;
+
+/* Breakpoint and tracepoint events waiting to be delivered to the GUI.
+   They are delivered together by gdbtk_tcl_breakpoints, when Tcl is
+   idle or when a gdb command completes, unless delivery is suspended.
+   BREAKPOINT_EVENTS_PENDING maps a breakpoint number to its event in
+   BREAKPOINT_EVENTS, which lets a "modify" be folded into the event
+   already queued for the same breakpoint.  Since the event only
+   carries the breakpoint number, the GUI reads the state of the
+   breakpoint when the event is delivered; a deleted breakpoint is
+   gone by then, so its last state is recorded in INFO.  */
+struct breakpoint_event
+{
+  int number;
+  bool tracepoint;
+  const char *action;
+  Tcl_Obj *info;
+};
+
+static std::vector<breakpoint_event> breakpoint_events;
+static std::map<int, size_t> breakpoint_events_pending;
+static int breakpoint_events_suspended;
+static bool breakpoint_events_scheduled;
+
 /* From breakpoint.c */
 extern struct breakpoint *breakpoint_chain;
 
@@ -81,6 +132,10 @@ const char *bpdisp[] =
  */
 
 /* Breakpoint-related functions */
+static int gdb_breakpoint_generation (ClientData, Tcl_Interp *, int,
+				      Tcl_Obj * CONST[]);
+static int gdb_breakpoint_events (ClientData, Tcl_Interp *, int,
+				  Tcl_Obj * CONST[]);
 static int gdb_find_bp_at_addr (ClientData, Tcl_Interp *, int,
 				Tcl_Obj * CONST objv[]);
 static int gdb_find_bp_at_line (ClientData, Tcl_Interp *, int,
@@ -89,6 +144,8 @@ static int gdb_get_breakpoint_info (ClientData, Tcl_Interp *, int,
 				    Tcl_Obj * CONST[]);
 static int gdb_get_breakpoint_list (ClientData, Tcl_Interp *, int,
 				    Tcl_Obj * CONST[]);
+static int gdb_get_breakpoints (ClientData, Tcl_Interp *, int,
+				Tcl_Obj * CONST[]);
 static int gdb_set_bp (ClientData, Tcl_Interp *, int, Tcl_Obj * CONST objv[]);
 
 /* Tracepoint-related functions */
@@ -105,6 +162,8 @@ static int gdb_trace_status (ClientData, Tcl_Interp *, int,
 static int gdb_tracepoint_exists_command (ClientData, Tcl_Interp *,
 					  int, Tcl_Obj * CONST objv[]);
 static Tcl_Obj *get_breakpoint_commands (struct command_line *cmd);
+static Tcl_Obj *breakpoint_info (struct breakpoint *, const char *);
+static Tcl_Obj *tracepoint_info (struct tracepoint *, const char *);
 
 static int tracepoint_exists (char *args);
 
@@ -114,11 +173,21 @@ void gdbtk_create_breakpoint (struct breakpoint *);
 void gdbtk_delete_breakpoint (struct breakpoint *);
 void gdbtk_modify_breakpoint (struct breakpoint *);
 static void breakpoint_notify (int, const char *);
+static void breakpoint_events_idle (ClientData);
+static void breakpoint_forget_disassembly (struct breakpoint *);
+static void breakpoint_index_add (struct breakpoint *);
+static void breakpoint_index_remove (int);
+static void breakpoint_index_build (void);
 
 int
 Gdbtk_Breakpoint_Init (Tcl_Interp *interp)
 {
   /* Breakpoint commands */
+  Tcl_CreateObjCommand (interp, "gdb_breakpoint_events", gdbtk_call_wrapper,
+			(ClientData) gdb_breakpoint_events, NULL);
+  Tcl_CreateObjCommand (interp, "gdb_breakpoint_generation",
+			gdbtk_call_wrapper,
+			(ClientData) gdb_breakpoint_generation, NULL);
   Tcl_CreateObjCommand (interp, "gdb_find_bp_at_addr", gdbtk_call_wrapper,
 			(ClientData) gdb_find_bp_at_addr, NULL);
   Tcl_CreateObjCommand (interp, "gdb_find_bp_at_line", gdbtk_call_wrapper,
@@ -127,6 +196,8 @@ Gdbtk_Breakpoint_Init (Tcl_Interp *interp)
 			(ClientData) gdb_get_breakpoint_info, NULL);
   Tcl_CreateObjCommand (interp, "gdb_get_breakpoint_list", gdbtk_call_wrapper,
 			(ClientData) gdb_get_breakpoint_list, NULL);
+  Tcl_CreateObjCommand (interp, "gdb_get_breakpoints", gdbtk_call_wrapper,
+			(ClientData) gdb_get_breakpoints, NULL);
   Tcl_CreateObjCommand (interp, "gdb_set_bp", gdbtk_call_wrapper,
 			(ClientData) gdb_set_bp, NULL);
 
@@ -182,6 +253,90 @@ gdbtk_read_next_line (void)
 */
 
 
+/* This implements the tcl command "gdb_breakpoint_generation"
+
+* Tcl Arguments:
+*    None.
+* Tcl Result:
+*    The generation of the breakpoint list, as reported by
+*    gdb_get_breakpoints.  It changes whenever a breakpoint is
+*    created, deleted or modified.
+*/
+static int
+gdb_breakpoint_generation (ClientData clientData, Tcl_Interp *interp,
+			   int objc, Tcl_Obj *CONST objv[])
+{
+  if (objc != 1)
+    {
+      Tcl_WrongNumArgs (interp, 1, objv, NULL);
+      return TCL_ERROR;
+    }
+
+  Tcl_SetLongObj (result_ptr->obj_ptr, breakpoint_generation);
+  return TCL_OK;
+}
+
+/* This implements the tcl command "gdb_breakpoint_events", which
+ * controls the delivery of breakpoint events to gdbtk_tcl_breakpoints.
+ *
+ * Arguments:
+ *    suspend - queue events until the matching resume
+ *    resume  - undo a suspend; the queued events are delivered once
+ *              Tcl is idle
+ *    flush   - deliver the queued events now
+ * Return:
+ *    The number of suspends still in effect.
+ */
+static int
+gdb_breakpoint_events (ClientData clientData, Tcl_Interp *interp,
+		       int objc, Tcl_Obj *CONST objv[])
+{
+  int index;
+  static const char *commands[] = {"suspend", "resume", "flush", NULL};
+  enum commands_enum { BP_EVENTS_SUSPEND, BP_EVENTS_RESUME, BP_EVENTS_FLUSH };
+
+  if (objc != 2)
+    {
+      Tcl_WrongNumArgs (interp, 1, objv, "suspend|resume|flush");
+      return TCL_ERROR;
+    }
+
+  if (Tcl_GetIndexFromObj (interp, objv[1], commands, "command", 0,
+			   &index) != TCL_OK)
+    {
+      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+      return TCL_ERROR;
+    }
+
+  switch ((enum commands_enum) index)
+    {
+    case BP_EVENTS_SUSPEND:
+      breakpoint_events_suspended++;
+      break;
+
+    case BP_EVENTS_RESUME:
+      if (breakpoint_events_suspended == 0)
+	{
+	  gdbtk_set_result (interp, "breakpoint events are not suspended");
+	  return TCL_ERROR;
+	}
+      if (--breakpoint_events_suspended == 0
+	  && !breakpoint_events.empty () && !breakpoint_events_scheduled)
+	{
+	  Tcl_DoWhenIdle (breakpoint_events_idle, NULL);
+	  breakpoint_events_scheduled = true;
+	}
+      break;
+
+    case BP_EVENTS_FLUSH:
+      gdbtk_breakpoint_events_flush ();
+      break;
+    }
+
+  Tcl_SetIntObj (result_ptr->obj_ptr, breakpoint_events_suspended);
+  return TCL_OK;
+}
+
 /* This implements the tcl command "gdb_find_bp_at_addr"
 
 * Tcl Arguments:
@@ -195,7 +350,7 @@ gdb_find_bp_at_addr (ClientData clientData, Tcl_Interp *interp,
 {
   CORE_ADDR addr;
   Tcl_WideInt waddr;
-  struct breakpoint *b;
+  std::vector<int> numbers;
 
   if (objc != 2)
     {
@@ -207,13 +362,19 @@ gdb_find_bp_at_addr (ClientData clientData, Tcl_Interp *interp,
     return TCL_ERROR;
   addr = waddr;
 
+  breakpoint_index_build ();
+  auto range = bp_addr_index.equal_range (addr);
+  for (auto it = range.first; it != range.second; ++it)
+    numbers.push_back (it->second);
+
+  std::sort (numbers.begin (), numbers.end ());
+  numbers.erase (std::unique (numbers.begin (), numbers.end ()),
+		 numbers.end ());
+
   Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
-  ALL_BREAKPOINTS (b)
-    {
-      if (b->loc != NULL && b->loc->address == addr)
-	Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
-				  Tcl_NewIntObj (b->number));
-    }
+  for (int num : numbers)
+    Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+			      Tcl_NewIntObj (num));
 
   return TCL_OK;
 }
@@ -223,8 +384,12 @@ gdb_find_bp_at_addr (ClientData clientData, Tcl_Interp *interp,
 * Tcl Arguments:
 *    filename: the file in which to find the breakpoint
 *    line:     the line number for the breakpoint
+*    last:     optional last line of a range of lines
 * Tcl Result:
-*    It returns a list of breakpoint numbers
+*    It returns a list of breakpoint numbers.  If LAST is given, it
+*    returns a flat list of line numbers, each followed by the list of
+*    breakpoints on that line, for the lines from LINE to LAST that
+*    have breakpoints.
 */
 static int
 gdb_find_bp_at_line (ClientData clientData, Tcl_Interp *interp,
@@ -232,39 +397,186 @@ gdb_find_bp_at_line (ClientData clientData, Tcl_Interp *interp,
 
 {
   struct symtab *s;
-  int line;
-  struct breakpoint *b;
+  int line, last;
+  const char *filename;
+  std::vector<int> numbers;
 
-  if (objc != 3)
+  if (objc != 3 && objc != 4)
     {
-      Tcl_WrongNumArgs (interp, 1, objv, "filename line");
+      Tcl_WrongNumArgs (interp, 1, objv, "filename line ?last?");
       return TCL_ERROR;
     }
 
-  s = lookup_symtab (Tcl_GetStringFromObj (objv[1], NULL));
-  if (s == NULL)
-    return TCL_ERROR;
-
   if (Tcl_GetIntFromObj (interp, objv[2], &line) == TCL_ERROR)
     {
       result_ptr->flags = GDBTK_IN_TCL_RESULT;
       return TCL_ERROR;
     }
 
+  last = line;
+  if (objc == 4
+      && Tcl_GetIntFromObj (interp, objv[3], &last) == TCL_ERROR)
+    {
+      result_ptr->flags = GDBTK_IN_TCL_RESULT;
+      return TCL_ERROR;
+    }
+
+  breakpoint_index_build ();
+
+  filename = Tcl_GetStringFromObj (objv[1], NULL);
+  auto file = bp_index_files.find (filename);
+  if (file == bp_index_files.end ())
+    {
+      s = lookup_symtab (filename);
+      if (s == NULL)
+	return TCL_ERROR;
+
+      file = bp_index_files.insert
+	(std::make_pair (std::string (filename),
+			 std::string (symtab_to_fullname (s)))).first;
+    }
+
   Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
-  ALL_BREAKPOINTS (b)
-  {
-    if (b->loc && b->loc->symtab && b->loc->line_number == line
-	&& !strcmp (b->loc->symtab->filename, s->filename))
-      {
-	Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
-				  Tcl_NewIntObj (b->number));
-      }
-  }
+  auto lines = bp_line_index.find (file->second);
+  if (lines == bp_line_index.end () || last < line)
+    return TCL_OK;
+
+  auto it = lines->second.lower_bound (line);
+  auto end = lines->second.upper_bound (last);
+  while (it != end)
+    {
+      int this_line = it->first;
+
+      numbers.clear ();
+      for (; it != end && it->first == this_line; ++it)
+	numbers.push_back (it->second);
+      std::sort (numbers.begin (), numbers.end ());
+      numbers.erase (std::unique (numbers.begin (), numbers.end ()),
+		     numbers.end ());
+
+      if (objc == 3)
+	{
+	  for (int num : numbers)
+	    Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				      Tcl_NewIntObj (num));
+	}
+      else
+	{
+	  Tcl_Obj *list = Tcl_NewObj ();
+
+	  for (int num : numbers)
+	    Tcl_ListObjAppendElement (NULL, list, Tcl_NewIntObj (num));
+	  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				    Tcl_NewIntObj (this_line));
+	  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr, list);
+	}
+    }
 
   return TCL_OK;
 }
 
+/* Enter all the locations of breakpoint B in the breakpoint location
+   index.  Only breakpoints and tracepoints set by the user are
+   indexed.  */
+static void
+breakpoint_index_add (struct breakpoint *b)
+{
+  struct bp_location *loc;
+  bp_index_locations *entry;
+
+  if (b->number <= 0
+      || (b->type != bp_breakpoint
+	  && b->type != bp_hardware_breakpoint
+	  && !is_tracepoint (b)))
+    return;
+
+  entry = &bp_index_points[b->number];
+  for (loc = b->loc; loc != NULL; loc = loc->next)
+    {
+      bp_addr_index.insert (std::make_pair (loc->address, b->number));
+      entry->addresses.push_back (loc->address);
+
+      if (loc->symtab != NULL && loc->line_number > 0)
+	{
+	  std::string fullname (symtab_to_fullname (loc->symtab));
+
+	  bp_line_index[fullname].insert
+	    (std::make_pair (loc->line_number, b->number));
+	  entry->lines.push_back (std::make_pair (fullname,
+						  loc->line_number));
+	}
+    }
+}
+
+/* Take breakpoint number NUM out of the breakpoint location index.  */
+static void
+breakpoint_index_remove (int num)
+{
+  auto entry = bp_index_points.find (num);
+
+  if (entry == bp_index_points.end ())
+    return;
+
+  for (CORE_ADDR addr : entry->second.addresses)
+    {
+      auto range = bp_addr_index.equal_range (addr);
+      for (auto it = range.first; it != range.second; )
+	if (it->second == num)
+	  it = bp_addr_index.erase (it);
+	else
+	  ++it;
+    }
+
+  for (const auto &where : entry->second.lines)
+    {
+      auto lines = bp_line_index.find (where.first);
+      if (lines == bp_line_index.end ())
+	continue;
+
+      auto range = lines->second.equal_range (where.second);
+      for (auto it = range.first; it != range.second; )
+	if (it->second == num)
+	  it = lines->second.erase (it);
+	else
+	  ++it;
+      if (lines->second.empty ())
+	bp_line_index.erase (lines);
+    }
+
+  bp_index_points.erase (entry);
+}
+
+/* Build the breakpoint location index, unless it is already up to
+   date.  */
+static void
+breakpoint_index_build (void)
+{
+  struct breakpoint *b;
+
+  if (bp_index_valid)
+    return;
+
+  bp_line_index.clear ();
+  bp_addr_index.clear ();
+  bp_index_points.clear ();
+  ALL_BREAKPOINTS (b)
+    breakpoint_index_add (b);
+  bp_index_valid = true;
+}
+
+/* Throw the breakpoint location index away.  This is called when
+   symbol files come and go, since the full names of the source files
+   may change with them.  */
+void
+gdbtk_breakpoint_index_flush (void)
+{
+  bp_index_valid = false;
+  bp_line_index.clear ();
+  bp_addr_index.clear ();
+  bp_index_points.clear ();
+  bp_index_files.clear ();
+}
+
 /* This implements the tcl command gdb_get_breakpoint_info
  *
  * Tcl Arguments:
@@ -278,15 +590,8 @@ static int
 gdb_get_breakpoint_info (ClientData clientData, Tcl_Interp *interp, int objc,
 			 Tcl_Obj *CONST objv[])
 {
-  struct symtab_and_line sal;
   int bpnum;
   struct breakpoint *b;
-  struct watchpoint *w;
-  const char *funcname, *filename;
-  const char *addr_string;
-  int isPending = 0;
-
-  Tcl_Obj *new_obj;
 
   if (objc != 2)
     {
@@ -307,25 +612,43 @@ gdb_get_breakpoint_info (ClientData clientData, Tcl_Interp *interp, int objc,
       return TCL_ERROR;
     }
 
+  Tcl_SetObjResult (interp, breakpoint_info (b, NULL));
+  result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+  return TCL_OK;
+}
+
+/* Build the gdb_get_breakpoint_info list describing breakpoint B.
+   If FILE is not NULL, return NULL instead unless B is set in the
+   source file named FILE.  */
+
+static Tcl_Obj *
+breakpoint_info (struct breakpoint *b, const char *file)
+{
+  struct symtab_and_line sal;
+  struct watchpoint *w;
+  const char *funcname, *filename;
+  const char *addr_string;
+  Tcl_Obj *list;
+
   w = (is_watchpoint (b)) ? (struct watchpoint *) b : NULL;
 
-  isPending = (b->loc == NULL);
-  Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
   /* Pending breakpoints will display "<PENDING>" as the file name and the
      user expression into the Function field of the breakpoint view.
     "0" and "0" in the line number and address field.  */
-  if (isPending)
+  if (b->loc == NULL)
     {
+      if (file != NULL)
+	return NULL;
+
       addr_string = event_location_to_string(b->location.get ());
 
-      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+      list = Tcl_NewObj ();
+      Tcl_ListObjAppendElement (NULL, list,
                                 Tcl_NewStringObj ("<PENDING>", -1));
-      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+      Tcl_ListObjAppendElement (NULL, list,
                                 Tcl_NewStringObj (addr_string, -1));
-      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
-                                Tcl_NewIntObj (0));
-      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
-                                Tcl_NewIntObj (0));
+      Tcl_ListObjAppendElement (NULL, list, Tcl_NewIntObj (0));
+      Tcl_ListObjAppendElement (NULL, list, Tcl_NewIntObj (0));
     }
   else
     {
@@ -334,43 +657,47 @@ gdb_get_breakpoint_info (ClientData clientData, Tcl_Interp *interp, int objc,
       filename = symtab_to_filename (sal.symtab);
       if (filename == NULL)
         filename = "";
-      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+      if (file != NULL && strcmp (filename, file) != 0)
+	return NULL;
+
+      list = Tcl_NewObj ();
+      Tcl_ListObjAppendElement (NULL, list,
                                 Tcl_NewStringObj (filename, -1));
       funcname = pc_function_name (b->loc->address);
-      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+      Tcl_ListObjAppendElement (NULL, list,
                                 Tcl_NewStringObj (funcname, -1));
-      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+      Tcl_ListObjAppendElement (NULL, list,
                                 Tcl_NewIntObj (b->loc->line_number));
-      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+      Tcl_ListObjAppendElement (NULL, list,
                                 Tcl_NewStringObj (core_addr_to_string
                                (b->loc->address), -1));
   }
 
-  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+  Tcl_ListObjAppendElement (NULL, list,
 			    Tcl_NewStringObj (bptypes[b->type], -1));
-  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+  Tcl_ListObjAppendElement (NULL, list,
 			    Tcl_NewBooleanObj (b->enable_state == bp_enabled));
-  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+  Tcl_ListObjAppendElement (NULL, list,
 			    Tcl_NewStringObj (bpdisp[b->disposition], -1));
-  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+  Tcl_ListObjAppendElement (NULL, list,
 			    Tcl_NewIntObj (b->ignore_count));
 
-  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+  Tcl_ListObjAppendElement (NULL, list,
 			    get_breakpoint_commands ((breakpoint_commands (b)) ? breakpoint_commands (b) : NULL));
 
-  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+  Tcl_ListObjAppendElement (NULL, list,
 			    Tcl_NewStringObj (b->cond_string, -1));
 
-  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+  Tcl_ListObjAppendElement (NULL, list,
 			    Tcl_NewIntObj (b->thread));
-  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+  Tcl_ListObjAppendElement (NULL, list,
 			    Tcl_NewIntObj (b->hit_count));
 
   addr_string = w? w->exp_string: event_location_to_string(b->location.get ());
-  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+  Tcl_ListObjAppendElement (NULL, list,
 			    Tcl_NewStringObj (addr_string, -1));
 
-  return TCL_OK;
+  return list;
 }
 
 /* Helper function for gdb_get_breakpoint_info, this function is
@@ -479,6 +806,133 @@ gdb_get_breakpoint_list (ClientData clientData, Tcl_Interp *interp,
   return TCL_OK;
 }
 
+/* This implements the tcl command gdb_get_breakpoints
+ * It returns a snapshot of all the breakpoints and tracepoints in one
+ * pass over the breakpoint chain.
+ *
+ * Tcl Arguments:
+ *    -since generation: if nothing changed since GENERATION, only
+ *                       return the current generation
+ *    -file filename:    only report points set in FILENAME
+ *    -range low high:   only report points with a location in
+ *                       [LOW, HIGH)
+ * Tcl Result:
+ *    A list {generation breakpoints tracepoints}.  BREAKPOINTS is a
+ *    flat list of breakpoint numbers, each followed by what
+ *    gdb_get_breakpoint_info returns for it; TRACEPOINTS likewise with
+ *    gdb_get_tracepoint_info.  Both are suitable for "array set".
+ */
+static int
+gdb_get_breakpoints (ClientData clientData, Tcl_Interp *interp,
+		     int objc, Tcl_Obj *CONST objv[])
+{
+  struct breakpoint *b;
+  struct bp_location *loc;
+  Tcl_Obj *bps, *tps, *info;
+  Tcl_WideInt wlow, whigh;
+  CORE_ADDR low = 0, high = 0;
+  const char *file = NULL;
+  long since = 0;
+  int i, index, ranged = 0;
+  static const char *switches[] =
+    {"-since", "-file", "-range", (char *) NULL};
+  enum switches_opts
+    {
+      SWITCH_SINCE, SWITCH_FILE, SWITCH_RANGE
+    };
+
+  for (i = 1; i < objc; i += 2)
+    {
+      if (Tcl_GetIndexFromObj (interp, objv[i], switches, "option", 0,
+			       &index) != TCL_OK)
+	{
+	  result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	  return TCL_ERROR;
+	}
+
+      if (i + 1 + (index == SWITCH_RANGE) >= objc)
+	{
+	  Tcl_WrongNumArgs (interp, 1, objv,
+			    "?-since generation? ?-file filename?"
+			    " ?-range low high?");
+	  result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	  return TCL_ERROR;
+	}
+
+      switch ((enum switches_opts) index)
+	{
+	case SWITCH_SINCE:
+	  if (Tcl_GetLongFromObj (interp, objv[i + 1], &since) != TCL_OK)
+	    {
+	      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	      return TCL_ERROR;
+	    }
+	  break;
+	case SWITCH_FILE:
+	  file = Tcl_GetStringFromObj (objv[i + 1], NULL);
+	  break;
+	case SWITCH_RANGE:
+	  if (Tcl_GetWideIntFromObj (interp, objv[i + 1], &wlow) != TCL_OK
+	      || Tcl_GetWideIntFromObj (interp, objv[i + 2], &whigh) != TCL_OK)
+	    {
+	      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	      return TCL_ERROR;
+	    }
+	  low = wlow;
+	  high = whigh;
+	  ranged = 1;
+	  i++;
+	  break;
+	}
+    }
+
+  Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
+  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+			    Tcl_NewLongObj (breakpoint_generation));
+  if (since == breakpoint_generation)
+    return TCL_OK;
+
+  bps = Tcl_NewObj ();
+  tps = Tcl_NewObj ();
+  ALL_BREAKPOINTS (b)
+    {
+      if (b->type != bp_breakpoint && !is_tracepoint (b))
+	continue;
+
+      if (ranged)
+	{
+	  for (loc = b->loc; loc != NULL; loc = loc->next)
+	    if (loc->address >= low && loc->address < high)
+	      break;
+	  if (loc == NULL)
+	    continue;
+	}
+
+      if (b->type == bp_breakpoint)
+	{
+	  info = breakpoint_info (b, file);
+	  if (info != NULL)
+	    {
+	      Tcl_ListObjAppendElement (NULL, bps, Tcl_NewIntObj (b->number));
+	      Tcl_ListObjAppendElement (NULL, bps, info);
+	    }
+	}
+      else
+	{
+	  info = tracepoint_info ((struct tracepoint *) b, file);
+	  if (info != NULL)
+	    {
+	      Tcl_ListObjAppendElement (NULL, tps, Tcl_NewIntObj (b->number));
+	      Tcl_ListObjAppendElement (NULL, tps, info);
+	    }
+	}
+    }
+
+  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr, bps);
+  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr, tps);
+  return TCL_OK;
+}
+
 /* This implements the tcl command "gdb_set_bp"
  * It sets breakpoints, and notifies the GUI.
  *
@@ -560,6 +1014,7 @@ gdb_set_bp (ClientData clientData, Tcl_Interp *interp,
     }
   END_CATCH
 
+  gdbtk_breakpoint_events_flush ();
   return ret;
 }
 
@@ -576,7 +1031,14 @@ gdb_set_bp (ClientData clientData, Tcl_Interp *interp,
 void
 gdbtk_create_breakpoint (struct breakpoint *b)
 {
-  if (b == NULL || !BREAKPOINT_IS_INTERESTING (b))
+  if (b == NULL)
+    return;
+
+  breakpoint_generation++;
+  breakpoint_forget_disassembly (b);
+  if (bp_index_valid)
+    breakpoint_index_add (b);
+  if (!BREAKPOINT_IS_INTERESTING (b))
     return;
 
   breakpoint_notify (b->number, "create");
@@ -585,27 +1047,52 @@ gdbtk_create_breakpoint (struct breakpoint *b)
 void
 gdbtk_delete_breakpoint (struct breakpoint *b)
 {
+  breakpoint_generation++;
+  breakpoint_forget_disassembly (b);
+  breakpoint_index_remove (b->number);
   breakpoint_notify (b->number, "delete");
 }
 
 void
 gdbtk_modify_breakpoint (struct breakpoint *b)
 {
+  breakpoint_generation++;
+  breakpoint_forget_disassembly (b);
+  if (bp_index_valid)
+    {
+      breakpoint_index_remove (b->number);
+      breakpoint_index_add (b);
+    }
   if (b->number >= 0)
     breakpoint_notify (b->number, "modify");
 }
 
+/* Drop the cached disassembly of the instructions at B's locations,
+ * in case it was decoded while the breakpoint instruction was in
+ * memory.
+ */
+static void
+breakpoint_forget_disassembly (struct breakpoint *b)
+{
+  struct bp_location *loc;
+
+  for (loc = b->loc; loc != NULL; loc = loc->next)
+    gdbtk_disassembly_cache_invalidate (loc->address, 1);
+}
+
 /* This is the generic function for handling changes in
- * a breakpoint.  It routes the information to the Tcl
- * command "gdbtk_tcl_breakpoint" (or "gdbtk_tcl_tracepoint") in the form:
- *   gdbtk_tcl_breakpoint action b_number b_address b_line b_file
- * On error, the error string is written to gdb_stdout.
+ * a breakpoint.  It queues the change for the Tcl command
+ * "gdbtk_tcl_breakpoints", which receives a list of events of the form:
+ *   {kind action number info}
+ * KIND is "breakpoint" or "tracepoint".  INFO is what
+ * gdb_get_breakpoint_info (or gdb_get_tracepoint_info) returned for a
+ * deleted breakpoint, and is empty otherwise.
  */
 static void
 breakpoint_notify (int num, const char *action)
 {
-  char *buf;
   struct breakpoint *b;
+  breakpoint_event event;
 
   b = get_breakpoint (num);
   if (b == NULL)
@@ -625,18 +1112,122 @@ breakpoint_notify (int num, const char *action)
 	  && b->type != bp_fast_tracepoint))
     return;
 
-  /* We ensure that ACTION contains no special Tcl characters, so we
-     can do this.  */
-  if (b->type == bp_breakpoint)
-    buf = xstrprintf ("gdbtk_tcl_breakpoint %s %d", action, b->number);
-  else
-    buf = xstrprintf ("gdbtk_tcl_tracepoint %s %d", action, b->number);
+  event.number = b->number;
+  event.tracepoint = b->type != bp_breakpoint;
+  event.action = action;
+  event.info = NULL;
+
+  auto pending = breakpoint_events_pending.find (b->number);
+  if (pending != breakpoint_events_pending.end ())
+    {
+      breakpoint_event &queued = breakpoint_events[pending->second];
+
+      /* The GUI will see the state of the breakpoint as of delivery,
+	 so a modification adds nothing to an event already queued.  A
+	 deletion cancels a creation the GUI has not seen yet, and
+	 replaces anything else.  */
+      if (strcmp (action, "modify") == 0)
+	return;
+
+      if (strcmp (action, "delete") == 0
+	  && strcmp (queued.action, "create") == 0)
+	{
+	  queued.action = NULL;
+	  breakpoint_events_pending.erase (pending);
+	  return;
+	}
+
+      queued.action = NULL;
+      breakpoint_events_pending.erase (pending);
+    }
+
+  if (strcmp (action, "delete") == 0)
+    {
+      if (event.tracepoint)
+	event.info = tracepoint_info ((struct tracepoint *) b, NULL);
+      else
+	event.info = breakpoint_info (b, NULL);
+      Tcl_IncrRefCount (event.info);
+    }
+
+  breakpoint_events_pending[b->number] = breakpoint_events.size ();
+  breakpoint_events.push_back (event);
+
+  if (!breakpoint_events_scheduled && !breakpoint_events_suspended)
+    {
+      Tcl_DoWhenIdle (breakpoint_events_idle, NULL);
+      breakpoint_events_scheduled = true;
+    }
+}
+
+/* Deliver the queued breakpoint events to the GUI, unless delivery is
+   suspended.  This is called when Tcl is idle, and after the gdb
+   commands that may change breakpoints, so that the GUI is up to date
+   when they return.  */
+void
+gdbtk_breakpoint_events_flush (void)
+{
+  std::vector<breakpoint_event> events;
+  Tcl_Obj *cmd, *list, *event;
+  int count = 0;
+
+  if (breakpoint_events_suspended)
+    return;
+
+  if (breakpoint_events_scheduled)
+    {
+      Tcl_CancelIdleCall (breakpoint_events_idle, NULL);
+      breakpoint_events_scheduled = false;
+    }
+
+  /* Handlers may well change breakpoints themselves: start a new
+     queue for that.  */
+  events.swap (breakpoint_events);
+  breakpoint_events_pending.clear ();
+
+  list = Tcl_NewObj ();
+  for (const breakpoint_event &e : events)
+    {
+      if (e.action != NULL)
+	{
+	  event = Tcl_NewObj ();
+	  Tcl_ListObjAppendElement (NULL, event,
+				    Tcl_NewStringObj (e.tracepoint
+						      ? "tracepoint"
+						      : "breakpoint", -1));
+	  Tcl_ListObjAppendElement (NULL, event,
+				    Tcl_NewStringObj (e.action, -1));
+	  Tcl_ListObjAppendElement (NULL, event, Tcl_NewIntObj (e.number));
+	  Tcl_ListObjAppendElement (NULL, event,
+				    e.info != NULL ? e.info : Tcl_NewObj ());
+	  Tcl_ListObjAppendElement (NULL, list, event);
+	  count++;
+	}
+      if (e.info != NULL)
+	Tcl_DecrRefCount (e.info);
+    }
 
-  if (Tcl_Eval (gdbtk_tcl_interp, buf) != TCL_OK)
+  if (count == 0)
+    {
+      Tcl_DecrRefCount (list);
+      return;
+    }
+
+  cmd = Tcl_NewStringObj ("gdbtk_tcl_breakpoints", -1);
+  Tcl_IncrRefCount (cmd);
+  Tcl_ListObjAppendElement (NULL, cmd, list);
+  if (Tcl_EvalObjEx (gdbtk_tcl_interp, cmd, TCL_EVAL_GLOBAL) != TCL_OK)
     report_error ();
-  xfree(buf);
+  Tcl_DecrRefCount (cmd);
 }
-
+
+static void
+breakpoint_events_idle (ClientData clientData)
+{
+  breakpoint_events_scheduled = false;
+  gdbtk_breakpoint_events_flush ();
+}
+
 /*
  * This section contains the commands that deal with tracepoints:
  */
@@ -733,12 +1324,8 @@ static int
 gdb_get_tracepoint_info (ClientData clientData, Tcl_Interp *interp,
 			 int objc, Tcl_Obj *CONST objv[])
 {
-  struct symtab_and_line sal;
   int tpnum;
   struct tracepoint *tp;
-  struct breakpoint *bp;
-  Tcl_Obj *action_list;
-  const char *filename, *funcname;
 
   if (objc != 2)
     {
@@ -753,47 +1340,86 @@ gdb_get_tracepoint_info (ClientData clientData, Tcl_Interp *interp,
     }
 
   tp = get_tracepoint (tpnum);
-  bp = (struct breakpoint *) tp;
   if (tp == NULL)
     {
       gdbtk_set_result (interp, "Tracepoint #%d does not exist", tpnum);
       return TCL_ERROR;
     }
 
-  Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
-  sal = find_pc_line (bp->loc->address, 0);
-  filename = symtab_to_filename (sal.symtab);
-  if (filename == NULL)
-    filename = "N/A";
-  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr,
-			    Tcl_NewStringObj (filename, -1));
-
-  funcname = pc_function_name (bp->loc->address);
-  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr, Tcl_NewStringObj
-			    (funcname, -1));
-
-  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr,
-			    Tcl_NewIntObj (sal.line));
-  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr,
-			    Tcl_NewStringObj (core_addr_to_string (bp->loc->address), -1));
-  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr,
+  Tcl_SetObjResult (interp, tracepoint_info (tp, NULL));
+  result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+  return TCL_OK;
+}
+
+/* Build the gdb_get_tracepoint_info list describing tracepoint TP.
+   If FILE is not NULL, return NULL instead unless TP is set in the
+   source file named FILE.  */
+
+static Tcl_Obj *
+tracepoint_info (struct tracepoint *tp, const char *file)
+{
+  struct symtab_and_line sal;
+  struct breakpoint *bp;
+  Tcl_Obj *list, *action_list;
+  const char *filename, *funcname;
+
+  bp = (struct breakpoint *) tp;
+  if (bp->loc == NULL)
+    {
+      /* A pending tracepoint: report it the way pending breakpoints
+	 are reported.  */
+      if (file != NULL)
+	return NULL;
+
+      list = Tcl_NewObj ();
+      Tcl_ListObjAppendElement (NULL, list,
+				Tcl_NewStringObj ("<PENDING>", -1));
+      Tcl_ListObjAppendElement (NULL, list, Tcl_NewStringObj
+				(event_location_to_string (bp->location.get ()),
+				 -1));
+      Tcl_ListObjAppendElement (NULL, list, Tcl_NewIntObj (0));
+      Tcl_ListObjAppendElement (NULL, list, Tcl_NewIntObj (0));
+    }
+  else
+    {
+      sal = find_pc_line (bp->loc->address, 0);
+      filename = symtab_to_filename (sal.symtab);
+      if (filename == NULL)
+	filename = "N/A";
+      if (file != NULL && strcmp (filename, file) != 0)
+	return NULL;
+
+      list = Tcl_NewObj ();
+      Tcl_ListObjAppendElement (NULL, list,
+				Tcl_NewStringObj (filename, -1));
+
+      funcname = pc_function_name (bp->loc->address);
+      Tcl_ListObjAppendElement (NULL, list, Tcl_NewStringObj
+				(funcname, -1));
+
+      Tcl_ListObjAppendElement (NULL, list,
+				Tcl_NewIntObj (sal.line));
+      Tcl_ListObjAppendElement (NULL, list,
+				Tcl_NewStringObj (core_addr_to_string (bp->loc->address), -1));
+    }
+  Tcl_ListObjAppendElement (NULL, list,
 			    Tcl_NewIntObj (bp->enable_state == bp_enabled));
-  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr,
+  Tcl_ListObjAppendElement (NULL, list,
 			    Tcl_NewIntObj (tp->pass_count));
-  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr,
+  Tcl_ListObjAppendElement (NULL, list,
 			    Tcl_NewIntObj (tp->step_count));
-  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr,
+  Tcl_ListObjAppendElement (NULL, list,
 			    Tcl_NewIntObj (bp->thread));
-  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr,
+  Tcl_ListObjAppendElement (NULL, list,
 			    Tcl_NewIntObj (bp->hit_count));
 
   /* Append a list of actions */
   action_list = Tcl_NewObj ();
   if (bp->commands)
-    gdb_get_action_list (interp, action_list, breakpoint_commands (bp));
-  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr, action_list);
+    gdb_get_action_list (NULL, action_list, breakpoint_commands (bp));
+  Tcl_ListObjAppendElement (NULL, list, action_list);
 
-  return TCL_OK;
+  return list;
 }
 
 /* return a list of all tracepoint numbers in interpreter */
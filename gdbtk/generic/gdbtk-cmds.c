@@ -46,6 +46,7 @@
 #include "regcache.h"
 #include "arch-utils.h"
 #include "psymtab.h"
+#include "gdb_regex.h"
 #include <ctype.h>
 
 /* tcl header files includes varargs.h unless HAS_STDARG is defined,
@@ -62,6 +63,9 @@
 
 #include <signal.h>
 #include <fcntl.h>
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
 #ifdef HAVE_SYS_IOCTL_H
 #include <sys/ioctl.h>
 #endif
@@ -69,6 +73,11 @@
 #include <sys/stat.h>
 
 #include <string.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 #include "dis-asm.h"
 #include "gdbcmd.h"
 
@@ -122,12 +131,36 @@ struct my_line_entry
   CORE_ADDR end_pc;
 };
 
-/* Use this to pass the Tcl Text widget command and the open file
-   descriptor to the disassembly load command. */
+/* A source file, as loaded into the source windows: read once,
+   converted to UTF-8 and stripped of DOS line endings in one go, with
+   the offset of each line.  See gdbtk_get_source_buffer.  */
+
+struct source_buffer
+{
+  std::string fullname;
+  time_t mtime;
+  off_t file_size;
+  std::string text;		/* The text, as read or converted. */
+  /* LINES[N - 1] is the offset of line N in TEXT, and the last entry is
+     its size, so a file has LINES.size () - 1 lines.  Each line
+     includes its newline, if any.  */
+  std::vector<size_t> lines;
+  /* EXECUTABLE[N] is true when line N has code in EXECUTABLE_SYMTAB,
+     as of objfile modification time EXECUTABLE_MTIME.  Computed by
+     gdb_loadfile the first time it shows the file.  */
+  std::vector<bool> executable;
+  struct symtab *executable_symtab;
+  struct objfile *executable_objfile;
+  long executable_mtime;
+  size_t bytes;			/* Memory accounted to the cache. */
+};
+
+/* Use this to pass the Tcl Text widget command and the source file
+   to the disassembly load command. */
 
 struct disassembly_client_data
 {
-  FILE *fp;
+  std::shared_ptr<source_buffer> source;
   int file_opened_p;
   int widget_line_no;
   Tcl_Interp *interp;
@@ -136,18 +169,65 @@ struct disassembly_client_data
   const char *asm_argv[14];
   const char *source_argv[7];
   const char *map_arr;
+  int map_flags;
   Tcl_DString src_to_line_prefix;
   Tcl_DString pc_to_line_prefix;
   Tcl_DString line_to_pc_prefix;
   Tcl_CmdInfo cmd;
 };
 
+/* gdb_disassemble_driver works from a list of these.  Each one prints
+   the source lines [FIRST_LINE, END_LINE) of SYMTAB (if SYMTAB is not
+   NULL), followed by the instructions in [START_PC, END_PC).  */
+
+struct disassembly_step
+{
+  struct symtab *symtab;
+  int first_line;
+  int end_line;
+  CORE_ADDR start_pc;
+  CORE_ADDR end_pc;
+};
+
+/* How far gdb_disassemble_driver got through its list of steps, so
+   that a large function can be loaded a piece at a time.  */
+
+struct disassembly_position
+{
+  std::vector<disassembly_step> steps;
+  size_t step;
+  int source_done;
+  CORE_ADDR pc;
+};
+
+/* A gdb_load_disassembly request which is being finished from the
+   Tcl event loop.  There is at most one of these per text widget.  */
+
+struct disassembly_stream
+{
+  struct disassembly_stream *next;
+  struct disassembly_client_data client_data;
+  struct disassembly_position position;
+  int chunk;
+  char *map_name;
+  Tcl_Obj *command;
+  Tcl_TimerToken timer;
+};
+
+static struct disassembly_stream *disassembly_streams = NULL;
+
+/* While the target is running, a pending disassembly load is retried
+   this often (in milliseconds).  */
+
+#define DISASSEMBLY_RETRY_INTERVAL 100
+
 /* This variable determines where memory used for disassembly is read
    from.  See note in gdbtk.h for details.  */
 /* NOTE: cagney/2003-09-08: This variable is unused.  */
 int disassemble_from_exec = -1;
 
 extern int gdb_variable_init (Tcl_Interp * interp);
+extern void report_error (void);
 
 /*
  * Declarations for routines exported from this file
@@ -178,6 +258,13 @@ static int gdb_get_function_command (ClientData, Tcl_Interp *, int,
 static int gdb_get_line_command (ClientData, Tcl_Interp *, int,
 				 Tcl_Obj * CONST objv[]);
 static int gdb_update_mem (ClientData, Tcl_Interp *, int, Tcl_Obj * CONST[]);
+static int gdb_fetch_mem (ClientData, Tcl_Interp *, int, Tcl_Obj * CONST[]);
+static int gdb_format_mem (ClientData, Tcl_Interp *, int, Tcl_Obj * CONST[]);
+static int gdb_patch_mem (ClientData, Tcl_Interp *, int, Tcl_Obj * CONST[]);
+static int gdb_compare_mem (ClientData, Tcl_Interp *, int, Tcl_Obj * CONST[]);
+static int gdb_memory_changes (ClientData, Tcl_Interp *, int,
+			       Tcl_Obj * CONST[]);
+static int gdb_mem_cache (ClientData, Tcl_Interp *, int, Tcl_Obj * CONST[]);
 static int gdb_set_mem (ClientData, Tcl_Interp *, int, Tcl_Obj * CONST[]);
 static int gdb_immediate_command (ClientData, Tcl_Interp *, int,
 				  Tcl_Obj * CONST[]);
@@ -201,6 +288,10 @@ static int gdb_loc (ClientData, Tcl_Interp *, int, Tcl_Obj * CONST[]);
 static int gdb_path_conv (ClientData, Tcl_Interp *, int, Tcl_Obj * CONST[]);
 static int gdb_prompt_command (ClientData, Tcl_Interp *, int,
 			       Tcl_Obj * CONST objv[]);
+static int gdb_console_output (ClientData, Tcl_Interp *, int,
+			       Tcl_Obj * CONST[]);
+static int gdb_console_log (ClientData, Tcl_Interp *, int,
+			    Tcl_Obj * CONST[]);
 static int gdb_restore_write (ClientData, Tcl_Interp *, int,
 			      Tcl_Obj * CONST[]);
 static int gdb_search (ClientData, Tcl_Interp *, int, Tcl_Obj * CONST objv[]);
@@ -213,8 +304,11 @@ static void gdbtk_load_source (ClientData clientData,
 			       int start_line, int end_line);
 static CORE_ADDR gdbtk_load_asm (ClientData clientData, CORE_ADDR pc,
 				 struct disassemble_info *di);
-static int gdb_disassemble_driver (CORE_ADDR low, CORE_ADDR high,
-				   int mixed_source_and_assembly,
+static void gdb_disassemble_plan (CORE_ADDR low, CORE_ADDR high,
+				  int mixed_source_and_assembly,
+				  struct disassembly_position *position);
+static int gdb_disassemble_driver (struct disassembly_position *position,
+				   int limit, std::vector<CORE_ADDR> *show,
 				   ClientData clientData,
 				   void (*print_source_fn) (ClientData, struct
 							    symtab *, int,
@@ -224,10 +318,25 @@ static int gdb_disassemble_driver (CORE_ADDR low, CORE_ADDR high,
 							      struct
 							      disassemble_info
 							      *));
-static int perror_with_name_wrapper (PTR args);
+static void gdbtk_free_disassembly_data (struct disassembly_client_data *);
+static std::shared_ptr<source_buffer> gdbtk_get_source_buffer (const char *);
+static void gdbtk_disassembly_stream_proc (ClientData clientData);
+static void gdbtk_finish_disassembly_stream (struct disassembly_stream *,
+					     const char *status,
+					     const char *message);
+static int gdb_cancel_disassembly (ClientData, Tcl_Interp *, int,
+				   Tcl_Obj * CONST[]);
+static int gdb_disassembly_cache (ClientData, Tcl_Interp *, int,
+				  Tcl_Obj * CONST[]);
+static int gdb_source_cache (ClientData, Tcl_Interp *, int,
+			     Tcl_Obj * CONST[]);
+static int gdb_objfile_mtime (ClientData, Tcl_Interp *, int,
+			      Tcl_Obj * CONST[]);
 static int wrapped_call (PTR opaque_args);
 static int hex2bin (const char *hex, char *bin, int count);
 static int fromhex (int a);
+static struct type *gdbtk_mem_cell_type (int size, int *asize);
+static LONGEST gdbtk_read_memory (CORE_ADDR addr, gdb_byte *buf, LONGEST len);
 static int gdb_list_processes (ClientData,
                                Tcl_Interp *,
                                int,
@@ -264,12 +373,28 @@ Gdbtk_Init (Tcl_Interp *interp)
 			(ClientData) gdb_entry_point, NULL);
   Tcl_CreateObjCommand (interp, "gdb_update_mem", gdbtk_call_wrapper,
 			(ClientData) gdb_update_mem, NULL);
+  Tcl_CreateObjCommand (interp, "gdb_fetch_mem", gdbtk_call_wrapper,
+			(ClientData) gdb_fetch_mem, NULL);
+  Tcl_CreateObjCommand (interp, "gdb_format_mem", gdbtk_call_wrapper,
+			(ClientData) gdb_format_mem, NULL);
+  Tcl_CreateObjCommand (interp, "gdb_patch_mem", gdbtk_call_wrapper,
+			(ClientData) gdb_patch_mem, NULL);
+  Tcl_CreateObjCommand (interp, "gdb_compare_mem", gdbtk_call_wrapper,
+			(ClientData) gdb_compare_mem, NULL);
+  Tcl_CreateObjCommand (interp, "gdb_memory_changes", gdbtk_call_wrapper,
+			(ClientData) gdb_memory_changes, NULL);
+  Tcl_CreateObjCommand (interp, "gdb_mem_cache", gdbtk_call_wrapper,
+			(ClientData) gdb_mem_cache, NULL);
   Tcl_CreateObjCommand (interp, "gdb_set_mem", gdbtk_call_wrapper,
 			(ClientData) gdb_set_mem, NULL);
   Tcl_CreateObjCommand (interp, "gdb_stop", gdbtk_call_wrapper,
 			(ClientData) gdb_stop, NULL);
   Tcl_CreateObjCommand (interp, "gdb_restore_write", gdbtk_call_wrapper,
 			(ClientData) gdb_restore_write, NULL);
+  Tcl_CreateObjCommand (interp, "gdb_console_output", gdbtk_call_wrapper,
+			(ClientData) gdb_console_output, NULL);
+  Tcl_CreateObjCommand (interp, "gdb_console_log", gdbtk_call_wrapper,
+			(ClientData) gdb_console_log, NULL);
   Tcl_CreateObjCommand (interp, "gdb_eval", gdbtk_call_wrapper,
 			(ClientData) gdb_eval, NULL);
   Tcl_CreateObjCommand (interp, "gdb_incr_addr", gdbtk_call_wrapper,
@@ -300,6 +425,14 @@ Gdbtk_Init (Tcl_Interp *interp)
 			(ClientData) gdb_loadfile, NULL);
   Tcl_CreateObjCommand (interp, "gdb_load_disassembly", gdbtk_call_wrapper,
 			(ClientData) gdb_load_disassembly,  NULL);
+  Tcl_CreateObjCommand (interp, "gdb_cancel_disassembly", gdbtk_call_wrapper,
+			(ClientData) gdb_cancel_disassembly, NULL);
+  Tcl_CreateObjCommand (interp, "gdb_disassembly_cache", gdbtk_call_wrapper,
+			(ClientData) gdb_disassembly_cache, NULL);
+  Tcl_CreateObjCommand (interp, "gdb_source_cache", gdbtk_call_wrapper,
+			(ClientData) gdb_source_cache, NULL);
+  Tcl_CreateObjCommand (interp, "gdb_objfile_mtime", gdbtk_call_wrapper,
+			(ClientData) gdb_objfile_mtime, NULL);
   Tcl_CreateObjCommand (interp, "gdb_search", gdbtk_call_wrapper,
 			(ClientData) gdb_search, NULL);
   Tcl_CreateObjCommand (interp, "gdb_get_inferior_args", gdbtk_call_wrapper,
@@ -387,6 +520,9 @@ gdbtk_call_wrapper (ClientData clientData, Tcl_Interp *interp,
 
       wrapped_args.val = TCL_ERROR;	/* Flag an error for TCL */
 
+      /* Let the output of the command come before the error.  */
+      gdbtk_output_flush ();
+
       /* Make sure the timer interrupts are turned off.  */
       gdbtk_stop_timer ();
 
@@ -413,6 +549,10 @@ gdbtk_call_wrapper (ClientData clientData, Tcl_Interp *interp,
       /* If the wrapped call returned an error directly, then we don't
 	 want to reset the result.  */
       wrapped_returned_error = wrapped_args.val == TCL_ERROR;
+
+      /* Whoever called the command expects to find its output in the
+	 console.  This leaves the result the command set alone.  */
+      gdbtk_output_flush ();
     }
 
   /* do not suppress any errors -- a remote target could have errored */
@@ -779,6 +919,7 @@ gdb_cmd (ClientData clientData, Tcl_Interp *interp,
     }
 
   bpstat_do_actions ();
+  gdbtk_breakpoint_events_flush ();
 
   return TCL_OK;
 }
@@ -830,6 +971,7 @@ gdb_immediate_command (ClientData clientData, Tcl_Interp *interp,
   execute_command (Tcl_GetStringFromObj (objv[1], NULL), from_tty);
 
   bpstat_do_actions ();
+  gdbtk_breakpoint_events_flush ();
 
   result_ptr->flags |= GDBTK_TO_RESULT;
 
@@ -1306,6 +1448,328 @@ comp_files (const void *file1, const void *file2)
 }
 
 
+/* The symbol index used by gdb_search.  The browser searches as the
+   user types, and search_symbols expands and scans every symtab each
+   time it is called.  Instead, all the symbols of a domain are fetched
+   once, the first time the domain is searched after the objfiles
+   change, and kept sorted by name: looking for a prefix is then a
+   binary search, and the other queries scan the names without going
+   back to the symtabs.  The matches of the last query are kept as
+   well, so the next one, when it narrows it down (the user typed one
+   more character) or just asks for another page, only looks at them.  */
+
+struct symbol_index_entry
+{
+  const char *name;		/* The print name. */
+  const char *filename;		/* The symtab filename, NULL for minsyms. */
+  int block;
+};
+
+/* What gdb_search makes of its regexp.  */
+
+enum symbol_query_kind
+{
+  SYMBOL_QUERY_SUBSTRING,	/* "foo" */
+  SYMBOL_QUERY_PREFIX,		/* "^foo" */
+  SYMBOL_QUERY_SUFFIX,		/* "foo$" */
+  SYMBOL_QUERY_EXACT,		/* "^foo$" */
+  SYMBOL_QUERY_REGEXP		/* Anything else. */
+};
+
+struct symbol_query
+{
+  int valid;
+  int domain;
+  enum symbol_query_kind kind;
+  std::string text;		/* The literal, or the regexp. */
+  int static_only;
+  std::vector<std::string> files;
+  std::vector<size_t> matches;	/* Indexes into the domain's index. */
+};
+
+/* One index per gdb_search option: functions, variables and types.  */
+#define SYMBOL_INDEX_DOMAINS 3
+
+static std::vector<symbol_index_entry> symbol_index[SYMBOL_INDEX_DOMAINS];
+static int symbol_index_valid[SYMBOL_INDEX_DOMAINS];
+static struct symbol_query last_symbol_query;
+
+/* Forget the symbol index; called whenever objfiles come or go.  */
+
+void
+gdbtk_symbol_index_flush (void)
+{
+  int i;
+
+  for (i = 0; i < SYMBOL_INDEX_DOMAINS; i++)
+    {
+      std::vector<symbol_index_entry> ().swap (symbol_index[i]);
+      symbol_index_valid[i] = 0;
+    }
+  last_symbol_query.valid = 0;
+  std::vector<size_t> ().swap (last_symbol_query.matches);
+}
+
+static bool
+symbol_index_less (const symbol_index_entry &a, const symbol_index_entry &b)
+{
+  return strcmp (a.name, b.name) < 0;
+}
+
+/* Fill the index for DOMAIN, the symbols of SPACE.  */
+
+static void
+gdbtk_build_symbol_index (int domain, enum search_domain space)
+{
+  std::vector<symbol_index_entry> &index = symbol_index[domain];
+  struct symbol_search *ss = NULL;
+  struct symbol_search *p;
+  struct cleanup *old_chain;
+
+  index.clear ();
+  search_symbols (NULL, space, 0, NULL, &ss);
+  old_chain = make_cleanup_free_search_symbols (&ss);
+
+  for (p = ss; p != NULL; p = p->next)
+    {
+      symbol_index_entry entry;
+
+      if (p->msymbol.minsym != NULL)
+	{
+	  entry.name = MSYMBOL_PRINT_NAME (p->msymbol.minsym);
+	  entry.filename = NULL;
+	}
+      else
+	{
+	  /* Strip off some C++ special symbols, like RTTI and global
+	     constructors/destructors. */
+	  if (strncmp (SYMBOL_LINKAGE_NAME (p->symbol), "__tf", 4) == 0
+	      || strncmp (SYMBOL_LINKAGE_NAME (p->symbol), "_GLOBAL_", 8) == 0)
+	    continue;
+	  entry.name = SYMBOL_PRINT_NAME (p->symbol);
+	  entry.filename = (symbol_symtab (p->symbol) != NULL
+			    ? symbol_symtab (p->symbol)->filename : NULL);
+	  if (entry.filename == NULL)
+	    entry.filename = "";
+	}
+      entry.block = p->block;
+      index.push_back (entry);
+    }
+
+  do_cleanups (old_chain);
+
+  std::stable_sort (index.begin (), index.end (), symbol_index_less);
+  symbol_index_valid[domain] = 1;
+}
+
+/* Work out what kind of query REGEXP is, and set TEXT to the literal
+   part of it, or to REGEXP itself.  */
+
+static enum symbol_query_kind
+gdbtk_symbol_query_kind (const char *regexp, std::string *text)
+{
+  const char *p = regexp;
+  int anchored_start = 0, anchored_end = 0;
+  size_t len;
+
+  if (*p == '^')
+    {
+      anchored_start = 1;
+      p++;
+    }
+  len = strlen (p);
+  if (len > 0 && p[len - 1] == '$' && (len < 2 || p[len - 2] != '\\'))
+    {
+      anchored_end = 1;
+      len--;
+    }
+
+  /* Names can't be matched without caring about case by comparing
+     bytes: leave that to regexec.  */
+  if (case_sensitivity == case_sensitive_off
+      || strcspn (p, ".[]()*+?{}|\\^$") < len)
+    {
+      text->assign (regexp);
+      return SYMBOL_QUERY_REGEXP;
+    }
+
+  text->assign (p, len);
+  if (anchored_start && anchored_end)
+    return SYMBOL_QUERY_EXACT;
+  else if (anchored_start)
+    return SYMBOL_QUERY_PREFIX;
+  else if (anchored_end)
+    return SYMBOL_QUERY_SUFFIX;
+  return SYMBOL_QUERY_SUBSTRING;
+}
+
+/* Whether the matches of the last query include all those of a query
+   of KIND for TEXT in the same domain, with the same filters.  */
+
+static int
+gdbtk_symbol_query_narrows (enum symbol_query_kind kind,
+			    const std::string &text)
+{
+  const struct symbol_query &last = last_symbol_query;
+
+  if (last.kind == kind && last.text == text)
+    return 1;
+
+  if (kind == SYMBOL_QUERY_REGEXP)
+    return 0;
+
+  switch (last.kind)
+    {
+    case SYMBOL_QUERY_SUBSTRING:
+      return text.find (last.text) != std::string::npos;
+    case SYMBOL_QUERY_PREFIX:
+      return ((kind == SYMBOL_QUERY_PREFIX || kind == SYMBOL_QUERY_EXACT)
+	      && text.compare (0, last.text.size (), last.text) == 0);
+    case SYMBOL_QUERY_SUFFIX:
+      return ((kind == SYMBOL_QUERY_SUFFIX || kind == SYMBOL_QUERY_EXACT)
+	      && text.size () >= last.text.size ()
+	      && text.compare (text.size () - last.text.size (),
+			       last.text.size (), last.text) == 0);
+    default:
+      return 0;
+    }
+}
+
+static int
+gdbtk_symbol_name_matches (const char *name, enum symbol_query_kind kind,
+			   const std::string &text, regex_t *pattern)
+{
+  size_t len;
+
+  switch (kind)
+    {
+    case SYMBOL_QUERY_SUBSTRING:
+      return strstr (name, text.c_str ()) != NULL;
+    case SYMBOL_QUERY_PREFIX:
+      return strncmp (name, text.c_str (), text.size ()) == 0;
+    case SYMBOL_QUERY_SUFFIX:
+      len = strlen (name);
+      return (len >= text.size ()
+	      && strcmp (name + len - text.size (), text.c_str ()) == 0);
+    case SYMBOL_QUERY_EXACT:
+      return strcmp (name, text.c_str ()) == 0;
+    default:
+      return regexec (pattern, name, 0, NULL, 0) == 0;
+    }
+}
+
+/* Run a query of KIND for TEXT over the index for DOMAIN, keeping the
+   symbols defined in FILES (all files if empty), and only static ones
+   if STATIC_ONLY.  The result is left in last_symbol_query.  */
+
+static void
+gdbtk_symbol_query (int domain, enum symbol_query_kind kind,
+		    const std::string &text, int static_only,
+		    const std::vector<std::string> &files)
+{
+  const std::vector<symbol_index_entry> &index = symbol_index[domain];
+  struct symbol_query &last = last_symbol_query;
+  std::vector<size_t> matches;
+  std::unordered_map<const char *, bool> file_ok;
+  regex_t pattern;
+  size_t i, first, last_index;
+  int narrow;
+
+  narrow = (last.valid && last.domain == domain
+	    && last.static_only == static_only && last.files == files
+	    && gdbtk_symbol_query_narrows (kind, text));
+  if (narrow && last.kind == kind && last.text == text)
+    return;
+
+  if (kind == SYMBOL_QUERY_REGEXP)
+    {
+      int cflags = REG_NOSUB;
+      int code;
+
+      if (case_sensitivity == case_sensitive_off)
+	cflags |= REG_ICASE;
+      code = regcomp (&pattern, text.c_str (), cflags);
+      if (code != 0)
+	{
+	  char message[256];
+
+	  regerror (code, &pattern, message, sizeof (message));
+	  error (_("Invalid regexp: %s"), message);
+	}
+    }
+
+  if (narrow)
+    {
+      for (i = 0; i < last.matches.size (); i++)
+	if (gdbtk_symbol_name_matches (index[last.matches[i]].name, kind,
+				       text, &pattern))
+	  matches.push_back (last.matches[i]);
+    }
+  else
+    {
+      /* A prefix only needs to look at the names sorted after it.  */
+      first = 0;
+      last_index = index.size ();
+      if (kind == SYMBOL_QUERY_PREFIX || kind == SYMBOL_QUERY_EXACT)
+	{
+	  symbol_index_entry key;
+
+	  key.name = text.c_str ();
+	  first = std::lower_bound (index.begin (), index.end (), key,
+				    symbol_index_less) - index.begin ();
+	}
+
+      for (i = first; i < last_index; i++)
+	{
+	  const symbol_index_entry &entry = index[i];
+
+	  if (!gdbtk_symbol_name_matches (entry.name, kind, text, &pattern))
+	    {
+	      if (kind == SYMBOL_QUERY_PREFIX || kind == SYMBOL_QUERY_EXACT)
+		break;
+	      continue;
+	    }
+
+	  if (static_only && entry.block != STATIC_BLOCK)
+	    continue;
+
+	  if (!files.empty ())
+	    {
+	      /* search_symbols leaves out minsyms when given files.  */
+	      if (entry.filename == NULL)
+		continue;
+
+	      auto it = file_ok.find (entry.filename);
+	      if (it == file_ok.end ())
+		{
+		  bool ok = false;
+		  size_t f;
+
+		  for (f = 0; f < files.size () && !ok; f++)
+		    ok = compare_filenames_for_search (entry.filename,
+						       files[f].c_str ());
+		  it = file_ok.insert (std::make_pair (entry.filename, ok)).first;
+		}
+	      if (!it->second)
+		continue;
+	    }
+
+	  matches.push_back (i);
+	}
+    }
+
+  if (kind == SYMBOL_QUERY_REGEXP)
+    regfree (&pattern);
+
+  last.valid = 1;
+  last.domain = domain;
+  last.kind = kind;
+  last.text = text;
+  last.static_only = static_only;
+  last.files = files;
+  last.matches.swap (matches);
+}
+
 /* This implements the tcl command "gdb_search"
 
 
@@ -1316,37 +1780,42 @@ comp_files (const void *file1, const void *file2)
 *    -files fileList
 *    -static 1/0
 *    -filename 1/0
+*    -offset n
+*    -limit n
 * Tcl Result:
-*    A list of all the matches found.  Optionally, if -filename is set to 1,
-*    then the output is a list of two element lists, with the symbol first,
-*    and the file in which it is found second.
+*    A list of all the matches found, sorted by name.  Optionally, if
+*    -filename is set to 1, then the output is a list of two element
+*    lists, with the symbol first, and the file in which it is found
+*    second.  With -offset and -limit, only that page of the matches is
+*    returned; asking for the next page of the same search is cheap.
 */
 
 static int
 gdb_search (ClientData clientData, Tcl_Interp *interp,
 	    int objc, Tcl_Obj *CONST objv[])
 {
-  struct symbol_search *ss = NULL;
-  struct symbol_search *p;
-  struct cleanup *old_chain = NULL;
   Tcl_Obj *CONST * switch_objv;
   int index, switch_objc, i, show_files = 0;
   enum search_domain space = ALL_DOMAIN;
   char *regexp;
-  int static_only, nfiles;
+  int static_only, nfiles, domain, offset, limit;
   Tcl_Obj **file_list;
-  const char **files;
+  std::vector<std::string> files;
+  std::string text;
+  enum symbol_query_kind kind;
+  size_t m, end;
   static const char *search_options[] =
     {"functions", "variables", "types", (char *) NULL};
   static const char *switches[] =
-    {"-files", "-filename", "-static", (char *) NULL};
+    {"-files", "-filename", "-static", "-offset", "-limit", (char *) NULL};
   enum search_opts
     {
       SEARCH_FUNCTIONS, SEARCH_VARIABLES, SEARCH_TYPES
     };
   enum switches_opts
     {
-      SWITCH_FILES, SWITCH_FILENAME, SWITCH_STATIC_ONLY
+      SWITCH_FILES, SWITCH_FILENAME, SWITCH_STATIC_ONLY, SWITCH_OFFSET,
+      SWITCH_LIMIT
     };
 
   if (objc < 3)
@@ -1362,9 +1831,7 @@ gdb_search (ClientData clientData, Tcl_Interp *interp,
       return TCL_ERROR;
     }
 
-  /* Unfortunately, we cannot teach search_symbols to search on
-     multiple regexps, so we have to do a two-tier search for
-     any searches which choose to narrow the playing field. */
+  domain = index;
   switch ((enum search_opts) index)
     {
     case SEARCH_FUNCTIONS:
@@ -1384,8 +1851,8 @@ gdb_search (ClientData clientData, Tcl_Interp *interp,
   switch_objv = objv + 3;
 
   static_only = 0;
-  nfiles = 0;
-  files = (const char **) NULL;
+  offset = 0;
+  limit = -1;
   while (switch_objc > 0)
     {
       if (Tcl_GetIndexFromObj (interp, switch_objv[0], switches,
@@ -1395,163 +1862,164 @@ gdb_search (ClientData clientData, Tcl_Interp *interp,
 	  return TCL_ERROR;
 	}
 
+      if (switch_objc < 2)
+	{
+	  Tcl_WrongNumArgs (interp, 3, objv,
+			    "?-files fileList  -filename 1|0 -static 1|0"
+			    " -offset n -limit n?");
+	  result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	  return TCL_ERROR;
+	}
+
       switch ((enum switches_opts) index)
 	{
 	case SWITCH_FILENAME:
-	  {
-	    if (switch_objc < 2)
-	      {
-		Tcl_WrongNumArgs (interp, 3, objv,
-				  "?-files fileList  -filename 1|0 -static 1|0?");
-		result_ptr->flags |= GDBTK_IN_TCL_RESULT;
-		return TCL_ERROR;
-	      }
-	    if (Tcl_GetBooleanFromObj (interp, switch_objv[1], &show_files)
-		!= TCL_OK)
-	      {
-		result_ptr->flags |= GDBTK_IN_TCL_RESULT;
-		return TCL_ERROR;
-	      }
-	    switch_objc--;
-	    switch_objv++;
-	  }
+	  if (Tcl_GetBooleanFromObj (interp, switch_objv[1], &show_files)
+	      != TCL_OK)
+	    {
+	      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	      return TCL_ERROR;
+	    }
 	  break;
 	case SWITCH_FILES:
 	  {
 	    int result;
-	    if (switch_objc < 2)
-	      {
-		Tcl_WrongNumArgs (interp, 3, objv,
-				  "?-files fileList  -filename 1|0 -static 1|0?");
-		result_ptr->flags |= GDBTK_IN_TCL_RESULT;
-		return TCL_ERROR;
-	      }
+
 	    result = Tcl_ListObjGetElements (interp, switch_objv[1],
 					     &nfiles, &file_list);
 	    if (result != TCL_OK)
 	      return result;
 
-	    files = (const char **) xmalloc (nfiles * sizeof (char *));
+	    files.clear ();
 	    for (i = 0; i < nfiles; i++)
-	      files[i] = Tcl_GetStringFromObj (file_list[i], NULL);
-	    switch_objc--;
-	    switch_objv++;
+	      files.push_back (Tcl_GetStringFromObj (file_list[i], NULL));
 	  }
 	  break;
 	case SWITCH_STATIC_ONLY:
-	  if (switch_objc < 2)
+	  if (Tcl_GetBooleanFromObj (interp, switch_objv[1], &static_only)
+	      != TCL_OK)
 	    {
-	      Tcl_WrongNumArgs (interp, 3, objv,
-				"?-files fileList  -filename 1|0 -static 1|0?");
 	      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
 	      return TCL_ERROR;
 	    }
-	  if (Tcl_GetBooleanFromObj (interp, switch_objv[1], &static_only)
-	      != TCL_OK)
+	  break;
+	case SWITCH_OFFSET:
+	  if (Tcl_GetIntFromObj (interp, switch_objv[1], &offset) != TCL_OK)
+	    {
+	      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	      return TCL_ERROR;
+	    }
+	  break;
+	case SWITCH_LIMIT:
+	  if (Tcl_GetIntFromObj (interp, switch_objv[1], &limit) != TCL_OK)
 	    {
 	      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
 	      return TCL_ERROR;
 	    }
-	  switch_objc--;
-	  switch_objv++;
+	  break;
 	}
-      switch_objc--;
-      switch_objv++;
+      switch_objc -= 2;
+      switch_objv += 2;
     }
 
-  search_symbols (regexp, space, nfiles, files, &ss);
-  if (ss != NULL)
-    old_chain = make_cleanup_free_search_symbols (&ss);
+  if (!symbol_index_valid[domain])
+    gdbtk_build_symbol_index (domain, space);
+
+  kind = gdbtk_symbol_query_kind (regexp, &text);
+  gdbtk_symbol_query (domain, kind, text, static_only != 0, files);
 
   Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
 
-  for (p = ss; p != NULL; p = p->next)
+  const std::vector<size_t> &matches = last_symbol_query.matches;
+  m = std::min ((size_t) std::max (offset, 0), matches.size ());
+  end = matches.size ();
+  if (limit >= 0)
+    end = std::min (end, m + limit);
+
+  for (; m < end; m++)
     {
+      const symbol_index_entry &entry = symbol_index[domain][matches[m]];
       Tcl_Obj *elem;
 
-      if (static_only && p->block != STATIC_BLOCK)
-	continue;
-
-      /* Strip off some C++ special symbols, like RTTI and global
-         constructors/destructors. */
-      if ((p->symbol != NULL
-	   && strncmp (SYMBOL_LINKAGE_NAME (p->symbol), "__tf", 4) != 0
-	   && strncmp (SYMBOL_LINKAGE_NAME (p->symbol), "_GLOBAL_", 8) != 0)
-	  || p->msymbol.minsym != NULL)
-	{
-	  elem = Tcl_NewListObj (0, NULL);
+      elem = Tcl_NewListObj (0, NULL);
+      Tcl_ListObjAppendElement (interp, elem,
+				Tcl_NewStringObj (entry.name, -1));
+      if (show_files)
+	Tcl_ListObjAppendElement (interp, elem,
+				  Tcl_NewStringObj (entry.filename != NULL
+						    ? entry.filename : "",
+						    -1));
+      Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr, elem);
+    }
 
-	  if (p->msymbol.minsym == NULL)
-	    Tcl_ListObjAppendElement (interp, elem,
-				      Tcl_NewStringObj (SYMBOL_PRINT_NAME (p->symbol), -1));
-	  else
-	    Tcl_ListObjAppendElement (interp, elem,
-				      Tcl_NewStringObj (MSYMBOL_PRINT_NAME (p->msymbol.minsym), -1));
+  return TCL_OK;
+}
 
-	  if (show_files)
-	    {
-	      if (p->symbol != NULL &&
-                  symbol_symtab(p->symbol) != NULL &&
-                  symbol_symtab(p->symbol)->filename != NULL)
-		{
-		  Tcl_ListObjAppendElement (interp, elem, Tcl_NewStringObj
-					    (symbol_symtab(p->symbol)->filename,
-                                            -1));
-		}
-	      else
-		{
-		  Tcl_ListObjAppendElement (interp, elem,
-					    Tcl_NewStringObj ("", 0));
-		}
-	    }
+/* Function tables.  The functions of a compunit, as gdb_listfuncs
+   returns them, are computed the first time they are asked for after
+   the objfiles change, and kept: the list itself, shared with every
+   caller, and the address range of each function, sorted, which
+   pc_function_name searches before asking the symbol tables.  */
 
-	  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr, elem);
-	}
-    }
+struct function_range
+{
+  CORE_ADDR low;
+  CORE_ADDR high;
+  const char *name;		/* The source name. */
+  int nested;			/* Whether another function, such as a
+				   nested one, has code in the range. */
+};
 
-  if (ss != NULL)
-    do_cleanups (old_chain);
+struct function_table
+{
+  Tcl_Obj *list;
+  std::vector<function_range> ranges;
+};
 
-  return TCL_OK;
+static std::unordered_map<const struct blockvector *, function_table>
+  function_tables;
+/* The blockvector gdb_listfuncs found for each file name it was given. */
+static std::unordered_map<std::string, const struct blockvector *>
+  function_table_files;
+/* The ranges of all the tables, sorted; rebuilt when tables are added.  */
+static std::vector<function_range> function_ranges;
+static int function_ranges_valid;
+
+static bool
+function_range_less (const function_range &a, const function_range &b)
+{
+  return a.low < b.low;
 }
 
-/* This implements the tcl command gdb_listfuncs
+/* Forget the function tables; called whenever objfiles come or go.  */
 
-* It lists all the functions defined in a given file
-*
-* Arguments:
-*    file - the file to look in
-* Tcl Result:
-*    A list of two element lists, the first element is
-*    the symbol name, and the second is a boolean indicating
-*    whether the symbol is demangled (1 for yes).
-*/
+void
+gdbtk_function_tables_flush (void)
+{
+  for (auto &it : function_tables)
+    Tcl_DecrRefCount (it.second.list);
+  function_tables.clear ();
+  function_table_files.clear ();
+  std::vector<function_range> ().swap (function_ranges);
+  function_ranges_valid = 0;
+}
 
-static int
-gdb_listfuncs (ClientData clientData, Tcl_Interp *interp,
-	       int objc, Tcl_Obj *CONST objv[])
+/* Return the function table for the compunit of SYMTAB.  */
+
+static struct function_table *
+gdbtk_function_table (struct symtab *symtab)
 {
-  struct symtab *symtab;
-  const struct blockvector *bv;
+  const struct blockvector *bv = SYMTAB_BLOCKVECTOR (symtab);
+  struct function_table *table;
   struct block *b;
   struct symbol *sym;
   int i;
   struct block_iterator iter;
   Tcl_Obj *funcVals[2];
 
-  if (objc != 2)
-    {
-      Tcl_WrongNumArgs (interp, 1, objv, "file");
-      return TCL_ERROR;
-    }
-
-  symtab = lookup_symtab (Tcl_GetStringFromObj (objv[1], NULL));
-  if (!symtab)
-    {
-      gdbtk_set_result (interp, "No such file (%s)",
-			Tcl_GetStringFromObj (objv[1], NULL));
-      return TCL_ERROR;
-    }
+  auto it = function_tables.find (bv);
+  if (it != function_tables.end ())
+    return &it->second;
 
   if (mangled == NULL)
     {
@@ -1561,9 +2029,10 @@ gdb_listfuncs (ClientData clientData, Tcl_Interp *interp,
       Tcl_IncrRefCount (not_mangled);
     }
 
-  Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
+  table = &function_tables[bv];
+  table->list = Tcl_NewListObj (0, NULL);
+  Tcl_IncrRefCount (table->list);
 
-  bv = SYMTAB_BLOCKVECTOR (symtab);
   for (i = GLOBAL_BLOCK; i <= STATIC_BLOCK; i++)
     {
       b = BLOCKVECTOR_BLOCK (bv, i);
@@ -1571,8 +2040,15 @@ gdb_listfuncs (ClientData clientData, Tcl_Interp *interp,
 	{
 	  if (SYMBOL_CLASS (sym) == LOC_BLOCK)
 	    {
-
 	      const char *name = SYMBOL_DEMANGLED_NAME (sym);
+	      const struct block *fb = SYMBOL_BLOCK_VALUE (sym);
+	      function_range range;
+
+	      range.low = BLOCK_START (fb);
+	      range.high = BLOCK_END (fb);
+	      range.name = GDBTK_SYMBOL_SOURCE_NAME (sym);
+	      range.nested = 0;
+	      table->ranges.push_back (range);
 
 	      if (name)
 		{
@@ -1598,24 +2074,130 @@ gdb_listfuncs (ClientData clientData, Tcl_Interp *interp,
 		  funcVals[0] = Tcl_NewStringObj (SYMBOL_PRINT_NAME (sym), -1);
 		  funcVals[1] = not_mangled;
 		}
-	      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+	      Tcl_ListObjAppendElement (NULL, table->list,
 					Tcl_NewListObj (2, funcVals));
 	    }
 	}
     }
-  return TCL_OK;
-}
-
-/* This implements the TCL command `gdb_restore_write'
-   It sets the puts hook back to gdbtk_file::puts.
-   Its sole reason for being is that sometimes we move the
-   write hook out of the way to specially trap output, and if
-   we get an error which we weren't expecting, it won't get put
-   back, so we run this at idle time as insurance.
-*/
 
-static int
-gdb_restore_write (ClientData clientData, Tcl_Interp *interp,
+  /* Only the functions of the global and static blocks are listed.  A
+     function whose block lies inside another one, such as a GNU C
+     nested function, is not; mark the ranges its code overlaps, so that
+     pc_function_name asks the symbol tables about their addresses.  */
+  for (i = FIRST_LOCAL_BLOCK; i < BLOCKVECTOR_NBLOCKS (bv); i++)
+    {
+      b = BLOCKVECTOR_BLOCK (bv, i);
+      if (BLOCK_FUNCTION (b) == NULL || block_inlined_p (b)
+	  || BLOCK_SUPERBLOCK (b) == BLOCKVECTOR_BLOCK (bv, STATIC_BLOCK))
+	continue;
+
+      for (auto &range : table->ranges)
+	if (range.low < BLOCK_END (b) && BLOCK_START (b) < range.high)
+	  range.nested = 1;
+    }
+
+  std::sort (table->ranges.begin (), table->ranges.end (),
+	     function_range_less);
+  function_ranges_valid = 0;
+  return table;
+}
+
+/* Return the source name of the function containing PC, if it is in
+   one of the function tables computed so far, or NULL.  NULL is also
+   returned for an address in a function which contains the code of
+   another; the block of that one may be the one PC is in.  */
+
+static const char *
+gdbtk_function_table_lookup (CORE_ADDR pc)
+{
+  function_range key;
+
+  if (function_tables.empty ())
+    return NULL;
+
+  if (!function_ranges_valid)
+    {
+      function_ranges.clear ();
+      for (auto &it : function_tables)
+	function_ranges.insert (function_ranges.end (),
+				it.second.ranges.begin (),
+				it.second.ranges.end ());
+      std::sort (function_ranges.begin (), function_ranges.end (),
+		 function_range_less);
+      function_ranges_valid = 1;
+    }
+
+  /* The last function starting at or before PC.  */
+  key.low = pc;
+  auto it = std::upper_bound (function_ranges.begin (), function_ranges.end (),
+			      key, function_range_less);
+  if (it == function_ranges.begin ())
+    return NULL;
+  --it;
+  if (pc >= it->high || it->nested)
+    return NULL;
+  return it->name;
+}
+
+/* This implements the tcl command gdb_listfuncs
+
+* It lists all the functions defined in a given file
+*
+* Arguments:
+*    file - the file to look in
+* Tcl Result:
+*    A list of two element lists, the first element is
+*    the symbol name, and the second is a boolean indicating
+*    whether the symbol is demangled (1 for yes).  The list is
+*    computed once, and shared by the callers, until the objfiles
+*    change.
+*/
+
+static int
+gdb_listfuncs (ClientData clientData, Tcl_Interp *interp,
+	       int objc, Tcl_Obj *CONST objv[])
+{
+  struct symtab *symtab;
+  struct function_table *table;
+  const char *file;
+
+  if (objc != 2)
+    {
+      Tcl_WrongNumArgs (interp, 1, objv, "file");
+      return TCL_ERROR;
+    }
+
+  file = Tcl_GetStringFromObj (objv[1], NULL);
+  auto it = function_table_files.find (file);
+  if (it != function_table_files.end ())
+    table = &function_tables[it->second];
+  else
+    {
+      symtab = lookup_symtab (file);
+      if (!symtab)
+	{
+	  gdbtk_set_result (interp, "No such file (%s)", file);
+	  return TCL_ERROR;
+	}
+      table = gdbtk_function_table (symtab);
+      function_table_files[file] = SYMTAB_BLOCKVECTOR (symtab);
+    }
+
+  Tcl_SetObjResult (interp, table->list);
+  result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+  return TCL_OK;
+}
+
+/* This implements the TCL command `gdb_restore_write'
+   It sets the puts hook back to gdbtk_file::puts.
+   Its sole reason for being is that sometimes we move the
+   write hook out of the way to specially trap output, and if
+   we get an error which we weren't expecting, it won't get put
+   back, so we run this at idle time as insurance.
+*/
+
+static int
+gdb_restore_write (ClientData clientData, Tcl_Interp *interp,
 		   int objc, Tcl_Obj *CONST objv[])
 {
   gdbtk_disable_write = false;
@@ -1623,696 +2205,1903 @@ gdb_restore_write (ClientData clientData, Tcl_Interp *interp,
 }
 
 
-/* This implements the tcl command gdb_load_disassembly
+/* This implements the Tcl command 'gdb_console_output', which controls
+ * the buffer collecting the output bound for the console.
  *
  * Arguments:
- *    widget - the name of a text widget into which to load the data
- *    source_with_assm - must be "source" or "nosource"
- *    low_address - the CORE_ADDR from which to start disassembly
- *    ?hi_address? - the CORE_ADDR to which to disassemble, defaults
- *                   to the end of the function containing low_address.
- * Tcl Result:
- *    The text widget is loaded with the data, and a list is returned.
- *    The first element of the list is a two element list containing the
- *    real low & high elements, the rest is a mapping between line number
- *    in the text widget, and either the source line number of that line,
- *    if it is a source line, or the assembly address.  You can distinguish
- *    between the two, because the address will start with 0x...
+ *   gdb_console_output flush
+ *     Hands the pending output over to the console now.
+ *   gdb_console_output limit ?lines?
+ *     Returns, or sets, how many lines of output may be handed over at
+ *     once; the older ones are dropped.  0 means no limit.
+ *   gdb_console_output stats ?-reset?
+ *     Returns a list of name/value pairs: "writes" counts the writes
+ *     gdb made, "flushes" the times the output was handed over,
+ *     "bytes" how much was, and "dropped" the lines dropped to honor
+ *     the limit.  With -reset, the counters are cleared after being
+ *     returned.
  */
 
 static int
-gdb_load_disassembly (ClientData clientData, Tcl_Interp *interp,
-		      int objc, Tcl_Obj *CONST objv[])
+gdb_console_output (ClientData clientData, Tcl_Interp *interp,
+		    int objc, Tcl_Obj *CONST objv[])
 {
-  CORE_ADDR low, high, orig;
-  struct disassembly_client_data client_data;
-  int mixed_source_and_assembly, ret_val, i;
-  char *arg_ptr;
-  char *map_name;
-  Tcl_WideInt waddr;
+  int index;
+  static const char *commands[] = {"flush", "limit", "stats", NULL};
+  enum commands_enum { OUTPUT_FLUSH, OUTPUT_LIMIT, OUTPUT_STATS };
 
-  if (objc != 6 && objc != 7)
+  if (objc < 2)
     {
-      Tcl_WrongNumArgs (interp, 1, objv, "[source|nosource] map_arr index_prefix low_address ?hi_address");
+      Tcl_WrongNumArgs (interp, 1, objv, "flush|limit|stats ?arg?");
       return TCL_ERROR;
     }
 
-  client_data.widget = Tcl_GetStringFromObj (objv[1], NULL);
-  if ( Tk_NameToWindow (interp, client_data.widget,
-			Tk_MainWindow (interp)) == NULL)
+  if (Tcl_GetIndexFromObj (interp, objv[1], commands, "option", 0,
+			   &index) != TCL_OK)
     {
-      gdbtk_set_result (interp, "Invalid widget name.");
+      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
       return TCL_ERROR;
     }
 
-  if (!Tcl_GetCommandInfo (interp, client_data.widget, &client_data.cmd))
+  switch ((enum commands_enum) index)
     {
-      gdbtk_set_result (interp, "Can't get widget command info");
-      return TCL_ERROR;
-    }
+    case OUTPUT_FLUSH:
+      gdbtk_output_flush ();
+      break;
 
-  arg_ptr = Tcl_GetStringFromObj (objv[2], NULL);
-  if (*arg_ptr == 's' && strcmp (arg_ptr, "source") == 0)
-    mixed_source_and_assembly = 1;
-  else if (*arg_ptr == 'n' && strcmp (arg_ptr, "nosource") == 0)
-    mixed_source_and_assembly = 0;
-  else
-    {
-      gdbtk_set_result (interp, "Second arg must be 'source' or 'nosource'");
-      return TCL_ERROR;
+    case OUTPUT_LIMIT:
+      if (objc > 3)
+	{
+	  Tcl_WrongNumArgs (interp, 2, objv, "?lines?");
+	  return TCL_ERROR;
+	}
+      if (objc == 3)
+	{
+	  int limit;
+
+	  if (Tcl_GetIntFromObj (interp, objv[2], &limit) != TCL_OK)
+	    {
+	      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	      return TCL_ERROR;
+	    }
+	  gdbtk_output_line_limit = limit > 0 ? limit : 0;
+	}
+      Tcl_SetIntObj (result_ptr->obj_ptr, gdbtk_output_line_limit);
+      break;
+
+    case OUTPUT_STATS:
+      if (objc > 3 || (objc == 3
+		       && strcmp (Tcl_GetString (objv[2]), "-reset") != 0))
+	{
+	  Tcl_WrongNumArgs (interp, 2, objv, "?-reset?");
+	  return TCL_ERROR;
+	}
+      Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("writes", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (gdbtk_output_stats.writes));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("flushes", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (gdbtk_output_stats.flushes));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("bytes", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (gdbtk_output_stats.bytes));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("dropped", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (gdbtk_output_stats.dropped));
+      if (objc == 3)
+	memset (&gdbtk_output_stats, 0, sizeof (gdbtk_output_stats));
+      break;
     }
 
-  /* As we populate the text widget, we will also create an array in the
-     caller's scope.  The name is given by objv[3].
-     Each source line gets an entry or the form:
-     array($prefix,srcline=$src_line_no) = $widget_line_no
+  return TCL_OK;
+}
 
-     Each assembly line gets two entries of the form:
-     array($prefix,pc=$pc) = $widget_line_no
-     array($prefix,line=$widget_line_no) = $src_line_no
+/* The console log holds the scrollback the console window no longer
+   displays.  Its text is kept in chunks of CONSOLE_LOG_CHUNK bytes;
+   once more than LIMIT bytes are held in memory, the oldest chunks are
+   written out to a temporary file and read back from there when
+   needed.  */
 
-     Where prefix is objv[4].
-  */
+#define CONSOLE_LOG_CHUNK (64 * 1024)
 
-  map_name = Tcl_GetStringFromObj (objv[3], NULL);
+struct console_log_store
+{
+  /* The text.  A chunk that was spilled is left empty; its text is in
+     SPILL, at the chunk's own offset.  */
+  std::vector<std::string> chunks;
+  size_t spilled = 0;
+  FILE *spill = NULL;
+
+  /* The number of bytes logged, and how many of them are in memory.  */
+  size_t size = 0;
+  size_t memory = 0;
+  size_t limit = 4 * 1024 * 1024;
+
+  /* The offset at which each line starts, and whether the next byte
+     starts a new one.  */
+  std::vector<size_t> lines;
+  bool at_bol = true;
+
+  /* Where each run of text with the same tag starts, with the index of
+     that tag in TAGS.  */
+  std::vector<std::pair<size_t, int>> runs;
+  std::vector<std::string> tags;
+
+  /* The spilled chunk last read back.  */
+  size_t cached = (size_t) -1;
+  std::string cache;
+};
 
-  if (*map_name != '\0')
+static struct console_log_store console_log;
+
+/* Write the oldest chunks out until the log fits in its memory limit.
+   The chunk being filled is never spilled.  */
+
+static void
+console_log_spill (void)
+{
+  while (console_log.limit > 0 && console_log.memory > console_log.limit
+	 && console_log.spilled + 1 < console_log.chunks.size ())
     {
-      char *prefix;
-      int prefix_len;
+      std::string &chunk = console_log.chunks[console_log.spilled];
 
-      client_data.map_arr = "map_array";
-      if (Tcl_UpVar (interp, "1", map_name, client_data.map_arr, 0) != TCL_OK)
+      if (console_log.spill == NULL)
 	{
-	  gdbtk_set_result (interp, "Can't link map array.");
-	  return TCL_ERROR;
+	  console_log.spill = tmpfile ();
+	  if (console_log.spill == NULL)
+	    return;
 	}
 
-      prefix = Tcl_GetStringFromObj (objv[4], &prefix_len);
-
-      Tcl_DStringInit(&client_data.src_to_line_prefix);
-      Tcl_DStringAppend (&client_data.src_to_line_prefix,
-			 prefix, prefix_len);
-      Tcl_DStringAppend (&client_data.src_to_line_prefix, ",srcline=",
-			 sizeof (",srcline=") - 1);
+      if (fseeko (console_log.spill,
+		  (off_t) console_log.spilled * CONSOLE_LOG_CHUNK,
+		  SEEK_SET) != 0
+	  || fwrite (chunk.data (), 1, chunk.size (), console_log.spill)
+	     != chunk.size ())
+	return;
 
-      Tcl_DStringInit(&client_data.pc_to_line_prefix);
-      Tcl_DStringAppend (&client_data.pc_to_line_prefix,
-			 prefix, prefix_len);
-      Tcl_DStringAppend (&client_data.pc_to_line_prefix, ",pc=",
-			 sizeof (",pc=") - 1);
+      console_log.memory -= chunk.size ();
+      std::string ().swap (chunk);
+      console_log.spilled++;
+    }
+}
 
-      Tcl_DStringInit(&client_data.line_to_pc_prefix);
-      Tcl_DStringAppend (&client_data.line_to_pc_prefix,
-			 prefix, prefix_len);
-      Tcl_DStringAppend (&client_data.line_to_pc_prefix, ",line=",
-			 sizeof (",line=") - 1);
+/* Append LEN bytes of TEXT, displayed with TAG, to the log.  */
 
-    }
-  else
-    {
-      client_data.map_arr = "";
-    }
+static void
+console_log_append (const char *text, size_t len, const char *tag)
+{
+  const char *p, *end = text + len;
+  int tagno;
 
-  /* Now parse the addresses */
-  if (Tcl_GetWideIntFromObj (interp, objv[5], &waddr) != TCL_OK)
-    return TCL_ERROR;
-  low = waddr;
+  if (len == 0)
+    return;
 
-  orig = low;
+  for (tagno = 0; tagno < (int) console_log.tags.size (); tagno++)
+    if (console_log.tags[tagno] == tag)
+      break;
+  if (tagno == (int) console_log.tags.size ())
+    console_log.tags.push_back (tag);
+  if (console_log.runs.empty () || console_log.runs.back ().second != tagno)
+    console_log.runs.emplace_back (console_log.size, tagno);
 
-  if (objc == 6)
-    {
-      if (find_pc_partial_function (low, NULL, &low, &high) == 0)
-	error ("No function contains address 0x%s", core_addr_to_string (orig));
-    }
-  else
+  for (p = text; p < end; )
     {
-      if (Tcl_GetWideIntFromObj (interp, objv[6], &waddr) != TCL_OK)
-	return TCL_ERROR;
-      high = waddr;
-    }
+      const char *nl;
 
-  /* Setup the client_data structure, and call the driver function. */
+      if (console_log.at_bol)
+	{
+	  console_log.lines.push_back (console_log.size + (p - text));
+	  console_log.at_bol = false;
+	}
+      nl = (const char *) memchr (p, '\n', end - p);
+      if (nl == NULL)
+	break;
+      p = nl + 1;
+      console_log.at_bol = true;
+    }
 
-  client_data.file_opened_p = 0;
-  client_data.widget_line_no = 0;
-  client_data.interp = interp;
-  for (i = 0; i < 3; i++)
+  while (len > 0)
     {
-      client_data.result_obj[i] = Tcl_NewObj();
-      Tcl_IncrRefCount (client_data.result_obj[i]);
-    }
+      size_t n;
 
-  /* Fill up the constant parts of the argv structures */
-  client_data.asm_argv[0] = client_data.widget;
-  client_data.asm_argv[1] = "insert";
-  client_data.asm_argv[2] = "end";
-  client_data.asm_argv[3] = "-\t";
-  client_data.asm_argv[4] = "break_rgn_tag";
-  /* client_data.asm_argv[5] = address; */
-  client_data.asm_argv[6] = "break_rgn_tag";
-  /* client_data.asm_argv[7] = offset; */
-  client_data.asm_argv[8] = "break_rgn_tag";
-  client_data.asm_argv[9] = ":\t\t";
-  client_data.asm_argv[10] = "source_tag";
-  /* client_data.asm_argv[11] = code; */
-  client_data.asm_argv[12] = "source_tag";
-  client_data.asm_argv[13] = "\n";
+      if (console_log.chunks.empty ()
+	  || console_log.chunks.back ().size () == CONSOLE_LOG_CHUNK)
+	{
+	  console_log.chunks.emplace_back ();
+	  console_log.chunks.back ().reserve (CONSOLE_LOG_CHUNK);
+	}
 
-  if (mixed_source_and_assembly)
-    {
-      client_data.source_argv[0] = client_data.widget;
-      client_data.source_argv[1] = "insert";
-      client_data.source_argv[2] = "end";
-      /* client_data.source_argv[3] = line_number; */
-      client_data.source_argv[4] = "";
-      /* client_data.source_argv[5] = line; */
-      client_data.source_argv[6] = "source_tag2";
+      std::string &chunk = console_log.chunks.back ();
+      n = std::min (len, (size_t) CONSOLE_LOG_CHUNK - chunk.size ());
+      chunk.append (text, n);
+      text += n;
+      len -= n;
+      console_log.size += n;
+      console_log.memory += n;
     }
 
-  ret_val = gdb_disassemble_driver (low, high, mixed_source_and_assembly,
-				    (ClientData) &client_data,
-				    gdbtk_load_source, gdbtk_load_asm);
+  console_log_spill ();
+}
 
-  /* Now clean up the opened file, and the Tcl data structures */
+/* Return chunk I of the log, reading it back if it was spilled.  */
 
-  if (client_data.file_opened_p == 1)
-    fclose(client_data.fp);
+static const std::string &
+console_log_chunk (size_t i)
+{
+  if (i >= console_log.spilled)
+    return console_log.chunks[i];
 
-  if (*client_data.map_arr != '\0')
+  if (console_log.cached != i)
     {
-      Tcl_DStringFree(&client_data.src_to_line_prefix);
-      Tcl_DStringFree(&client_data.pc_to_line_prefix);
-      Tcl_DStringFree(&client_data.line_to_pc_prefix);
+      size_t n = 0;
+
+      console_log.cache.resize (CONSOLE_LOG_CHUNK);
+      if (fseeko (console_log.spill, (off_t) i * CONSOLE_LOG_CHUNK,
+		  SEEK_SET) == 0)
+	n = fread (&console_log.cache[0], 1, CONSOLE_LOG_CHUNK,
+		   console_log.spill);
+      console_log.cache.resize (n);
+      console_log.cached = i;
     }
 
-  for (i = 0; i < 3; i++)
-    {
-      Tcl_DecrRefCount (client_data.result_obj[i]);
-    }
+  return console_log.cache;
+}
 
-  /* Finally, if we were successful, stick the low & high addresses
-     into the Tcl result. */
+/* Store the bytes of the log from START up to END in TEXT.  */
 
-  if (ret_val == TCL_OK)
+static void
+console_log_read (size_t start, size_t end, std::string &text)
+{
+  text.clear ();
+  while (start < end)
     {
-      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
-				Tcl_NewStringObj (core_addr_to_string (low), -1));
-      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
-				Tcl_NewStringObj (core_addr_to_string (high), -1));
+      const std::string &chunk
+	= console_log_chunk (start / CONSOLE_LOG_CHUNK);
+      size_t off = start % CONSOLE_LOG_CHUNK;
+      size_t n;
+
+      if (off >= chunk.size ())
+	break;
+      n = std::min (end - start, chunk.size () - off);
+      text.append (chunk, off, n);
+      start += n;
     }
-  return ret_val;
+}
+
+/* Return the offset at which line LINE of the log ends.  */
+
+static size_t
+console_log_line_end (size_t line)
+{
+  if (line + 1 < console_log.lines.size ())
+    return console_log.lines[line + 1];
+  return console_log.size;
 }
 
 static void
-gdbtk_load_source (ClientData clientData, struct symtab *symtab,
-		   int start_line, int end_line)
+console_log_clear (void)
 {
-  struct disassembly_client_data *client_data =
-    (struct disassembly_client_data *) clientData;
-  char *buffer;
-  int index_len;
+  if (console_log.spill != NULL)
+    fclose (console_log.spill);
+  console_log = console_log_store ();
+}
 
-  index_len = Tcl_DStringLength (&client_data->src_to_line_prefix);
+/* This implements the Tcl command 'gdb_console_log', which manages the
+ * scrollback the console window no longer displays.  Lines are numbered
+ * from 0, oldest first.
+ *
+ * Arguments:
+ *   gdb_console_log append text ?tag?
+ *     Logs TEXT, displayed with TAG.  Returns the number of lines.
+ *   gdb_console_log lines
+ *     Returns the number of lines.
+ *   gdb_console_log get first last
+ *     Returns lines FIRST through LAST, newlines included, as a list
+ *     of text and tag pairs suitable for a text widget's insert.
+ *   gdb_console_log search pattern ?-nocase? ?-regexp? ?-backwards?
+ *                   ?-start line?
+ *     Returns the number of the first line at or past LINE (before,
+ *     with -backwards) matching PATTERN, or -1.
+ *   gdb_console_log clear
+ *     Forgets the whole log.
+ *   gdb_console_log limit ?bytes?
+ *     Returns, or sets, how much text is kept in memory; the older
+ *     text goes to a temporary file.  0 means no limit.
+ *   gdb_console_log stats
+ *     Returns a list of name/value pairs: "lines", "bytes", and how
+ *     many of those are in "memory" and "spilled" to the file.
+ */
 
-  if (client_data->file_opened_p == 1)
+static int
+gdb_console_log (ClientData clientData, Tcl_Interp *interp,
+		 int objc, Tcl_Obj *CONST objv[])
+{
+  int index;
+  static const char *commands[] = {"append", "lines", "get", "search",
+				   "clear", "limit", "stats", NULL};
+  enum commands_enum
     {
-      const char **text_argv;
-      char line[10000], line_number[18];
-      int found_carriage_return = 1;
-
-      /* First do some sanity checks on the requested lines */
+      LOG_APPEND, LOG_LINES, LOG_GET, LOG_SEARCH, LOG_CLEAR, LOG_LIMIT,
+      LOG_STATS
+    };
 
-      if (start_line < 1
-	  || end_line < start_line || end_line > symtab->nlines)
-	{
-	  return;
-	}
+  if (objc < 2)
+    {
+      Tcl_WrongNumArgs (interp, 1, objv, "option ?arg ...?");
+      return TCL_ERROR;
+    }
 
-      line_number[0] = '\t';
-      line[0] = '\t';
+  if (Tcl_GetIndexFromObj (interp, objv[1], commands, "option", 0,
+			   &index) != TCL_OK)
+    {
+      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+      return TCL_ERROR;
+    }
 
-      text_argv = client_data->source_argv;
+  switch ((enum commands_enum) index)
+    {
+    case LOG_APPEND:
+      {
+	const char *text;
+	int len;
 
-      text_argv[3] = line_number;
-      text_argv[5] = line;
+	if (objc < 3 || objc > 4)
+	  {
+	    Tcl_WrongNumArgs (interp, 2, objv, "text ?tag?");
+	    return TCL_ERROR;
+	  }
+	text = Tcl_GetStringFromObj (objv[2], &len);
+	console_log_append (text, len,
+			    objc == 4 ? Tcl_GetString (objv[3]) : "");
+      }
+      /* FALLTHROUGH */
 
-      if (fseek (client_data->fp, symtab->line_charpos[start_line - 1],
-		 SEEK_SET) < 0)
-	{
-	  fclose(client_data->fp);
-	  client_data->file_opened_p = -1;
-	  return;
-	}
+    case LOG_LINES:
+      Tcl_SetWideIntObj (result_ptr->obj_ptr,
+			 (Tcl_WideInt) console_log.lines.size ());
+      break;
 
-      for (; start_line < end_line; start_line++)
-	{
-	  if (!fgets (line + 1, 9980, client_data->fp))
-	    {
-	      fclose(client_data->fp);
-	      client_data->file_opened_p = -1;
-	      return;
-	    }
+    case LOG_GET:
+      {
+	Tcl_WideInt first, last;
+	size_t base, start, end;
+	const char *tag;
+	std::vector<std::pair<size_t, int>>::iterator run;
+	std::string text;
 
-	  client_data->widget_line_no++;
+	if (objc != 4)
+	  {
+	    Tcl_WrongNumArgs (interp, 2, objv, "first last");
+	    return TCL_ERROR;
+	  }
+	if (Tcl_GetWideIntFromObj (interp, objv[2], &first) != TCL_OK
+	    || Tcl_GetWideIntFromObj (interp, objv[3], &last) != TCL_OK)
+	  {
+	    result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	    return TCL_ERROR;
+	  }
 
-	  sprintf (line_number + 1, "%d", start_line);
+	Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
+	if (first < 0)
+	  first = 0;
+	if (last >= (Tcl_WideInt) console_log.lines.size ())
+	  last = console_log.lines.size () - 1;
+	if (first > last)
+	  break;
 
-	  if (found_carriage_return)
-	    {
-	      char *p = strrchr(line, '\0') - 2;
-	      if (*p == '\r')
-		{
-		  *p = '\n';
-		  *(p + 1) = '\0';
-		}
-	      else
-		found_carriage_return = 0;
-	    }
+	base = start = console_log.lines[first];
+	end = console_log_line_end (last);
+	console_log_read (start, end, text);
 
-	  /* Run the command, then add an entry to the map array in
-	     the caller's scope, if requested. */
+	/* Cut the text where the tags change.  */
+	run = std::upper_bound (console_log.runs.begin (),
+				console_log.runs.end (),
+				std::make_pair (start, INT_MAX)) - 1;
+	while (start < end)
+	  {
+	    size_t stop = end;
+
+	    if (run + 1 != console_log.runs.end ())
+	      stop = std::min (stop, (run + 1)->first);
+	    tag = console_log.tags[run->second].c_str ();
+	    Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				      Tcl_NewStringObj (text.data ()
+							+ (start - base),
+							stop - start));
+	    Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				      Tcl_NewStringObj (tag, -1));
+	    start = stop;
+	    ++run;
+	  }
+      }
+      break;
 
-	  client_data->cmd.proc (client_data->cmd.clientData,
-				 client_data->interp, 7, text_argv);
+    case LOG_SEARCH:
+      {
+	static const char *switches[] =
+	  {"-nocase", "-regexp", "-backwards", "-start", NULL};
+	enum switches_opts
+	  {
+	    SWITCH_NOCASE, SWITCH_REGEXP, SWITCH_BACKWARDS, SWITCH_START
+	  };
+	int nocase = 0, regexp = 0, backwards = 0, i;
+	Tcl_WideInt line = -1, found = -1, nlines;
+	std::string pattern, text;
+	Tcl_RegExp re = NULL;
+
+	if (objc < 3)
+	  {
+	    Tcl_WrongNumArgs (interp, 2, objv,
+			      "pattern ?-nocase? ?-regexp? ?-backwards?"
+			      " ?-start line?");
+	    return TCL_ERROR;
+	  }
 
-	  if (*client_data->map_arr != '\0')
-	    {
+	for (i = 3; i < objc; i++)
+	  {
+	    int sw;
 
-	      Tcl_DStringAppend (&client_data->src_to_line_prefix,
-				 line_number + 1, -1);
+	    if (Tcl_GetIndexFromObj (interp, objv[i], switches, "option", 0,
+				     &sw) != TCL_OK)
+	      {
+		result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+		return TCL_ERROR;
+	      }
 
-	      /* FIXME: Convert to Tcl_SetVar2Ex when we move to 8.2.  This
-		 will allow us avoid converting widget_line_no into a string. */
+	    switch ((enum switches_opts) sw)
+	      {
+	      case SWITCH_NOCASE:
+		nocase = 1;
+		break;
+	      case SWITCH_REGEXP:
+		regexp = 1;
+		break;
+	      case SWITCH_BACKWARDS:
+		backwards = 1;
+		break;
+	      case SWITCH_START:
+		if (++i == objc)
+		  {
+		    gdbtk_set_result (interp, "-start requires a line");
+		    return TCL_ERROR;
+		  }
+		if (Tcl_GetWideIntFromObj (interp, objv[i], &line) != TCL_OK)
+		  {
+		    result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+		    return TCL_ERROR;
+		  }
+		break;
+	      }
+	  }
 
-	      buffer = xstrprintf ("%d", client_data->widget_line_no);
+	if (regexp)
+	  {
+	    re = Tcl_GetRegExpFromObj (interp, objv[2],
+				       TCL_REG_ADVANCED
+				       | (nocase ? TCL_REG_NOCASE : 0));
+	    if (re == NULL)
+	      {
+		result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+		return TCL_ERROR;
+	      }
+	  }
+	else
+	  {
+	    pattern = Tcl_GetString (objv[2]);
+	    if (nocase)
+	      std::transform (pattern.begin (), pattern.end (),
+			      pattern.begin (), ::tolower);
+	  }
+
+	nlines = console_log.lines.size ();
+	if (line < 0 || line >= nlines)
+	  line = backwards ? nlines - 1 : (line < 0 ? 0 : nlines);
+
+	for (; line >= 0 && line < nlines; line += backwards ? -1 : 1)
+	  {
+	    int match;
+
+	    console_log_read (console_log.lines[line],
+			      console_log_line_end (line), text);
+	    if (!text.empty () && text[text.size () - 1] == '\n')
+	      text.resize (text.size () - 1);
+
+	    if (re != NULL)
+	      {
+		match = Tcl_RegExpExec (interp, re, text.c_str (),
+					text.c_str ());
+		if (match < 0)
+		  {
+		    result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+		    return TCL_ERROR;
+		  }
+	      }
+	    else
+	      {
+		if (nocase)
+		  std::transform (text.begin (), text.end (), text.begin (),
+				  ::tolower);
+		match = text.find (pattern) != std::string::npos;
+	      }
+
+	    if (match)
+	      {
+		found = line;
+		break;
+	      }
+	  }
+
+	Tcl_SetWideIntObj (result_ptr->obj_ptr, found);
+      }
+      break;
 
-	      Tcl_SetVar2 (client_data->interp, client_data->map_arr,
-			   Tcl_DStringValue (&client_data->src_to_line_prefix),
-			   buffer, 0);
-	      free(buffer);
+    case LOG_CLEAR:
+      console_log_clear ();
+      break;
+
+    case LOG_LIMIT:
+      if (objc > 3)
+	{
+	  Tcl_WrongNumArgs (interp, 2, objv, "?bytes?");
+	  return TCL_ERROR;
+	}
+      if (objc == 3)
+	{
+	  Tcl_WideInt limit;
 
-	      Tcl_DStringSetLength (&client_data->src_to_line_prefix, index_len);
+	  if (Tcl_GetWideIntFromObj (interp, objv[2], &limit) != TCL_OK)
+	    {
+	      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	      return TCL_ERROR;
 	    }
+	  console_log.limit = limit > 0 ? (size_t) limit : 0;
+	  console_log_spill ();
 	}
+      Tcl_SetWideIntObj (result_ptr->obj_ptr,
+			 (Tcl_WideInt) console_log.limit);
+      break;
 
+    case LOG_STATS:
+      if (objc != 2)
+	{
+	  Tcl_WrongNumArgs (interp, 2, objv, NULL);
+	  return TCL_ERROR;
+	}
+      Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("lines", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (console_log.lines.size ()));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("bytes", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (console_log.size));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("memory", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (console_log.memory));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("spilled", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (console_log.size
+						   - console_log.memory));
+      break;
     }
-  else if (!client_data->file_opened_p)
+
+  return TCL_OK;
+}
+
+/* This implements the tcl command gdb_load_disassembly
+ *
+ * Arguments:
+ *    ?-chunk lines? - load the widget a piece at a time, see below
+ *    ?-show addr_list? - with -chunk, the addresses which must be
+ *                   loaded before returning.  Defaults to low_address.
+ *    ?-command script? - with -chunk, run when the load ends
+ *    widget - the name of a text widget into which to load the data
+ *    source_with_assm - must be "source" or "nosource"
+ *    map_arr - the name of the line map array, or ""
+ *    index_prefix - the prefix for the elements of map_arr
+ *    low_address - the CORE_ADDR from which to start disassembly
+ *    ?hi_address? - the CORE_ADDR to which to disassemble, defaults
+ *                   to the end of the function containing low_address.
+ * Tcl Result:
+ *    The text widget is loaded with the data, and a list is returned
+ *    holding the real low & high addresses, followed by 1 if the rest
+ *    of the range is still being loaded, or 0 if it is complete.
+ *
+ *    Without -chunk the whole range is loaded before returning.  With
+ *    -chunk, only the first LINES lines, and whatever it takes to reach
+ *    the -show addresses, are loaded; the rest are appended LINES at a
+ *    time from idle callbacks, so the GUI stays responsive.  map_arr
+ *    must then be a name which can be used from the global scope, like
+ *    the ones returned by itcl's "scope".  When the load ends, SCRIPT is
+ *    called with the widget, "done", "cancelled" or "error" and, for
+ *    errors, the message appended.  Nothing is called if the widget is
+ *    destroyed first.  Starting another load into the same widget, or
+ *    gdb_cancel_disassembly, cancels a pending load.
+ */
+
+static int
+gdb_load_disassembly (ClientData clientData, Tcl_Interp *interp,
+		      int objc, Tcl_Obj *CONST objv[])
+{
+  static const char *options[] = {
+    "-chunk", "-command", "-show", NULL
+  };
+  enum option_opts
+    {
+      OPT_CHUNK, OPT_COMMAND, OPT_SHOW
+    };
+  CORE_ADDR low, high, orig;
+  struct disassembly_stream *stream;
+  struct disassembly_client_data *client_data;
+  std::vector<CORE_ADDR> show;
+  Tcl_Obj *command = NULL, *show_obj = NULL;
+  Tcl_CmdInfo cmd;
+  int mixed_source_and_assembly, chunk = 0, done = 1, arg, index, i;
+  char *widget;
+  char *arg_ptr;
+  char *map_name;
+  Tcl_WideInt waddr;
+
+  for (arg = 1; arg < objc; arg += 2)
     {
-      int fdes;
-      /* The file is not yet open, try to open it, then print the
-	 first line.  If we fail, set FILE_OPEN_P to -1. */
+      arg_ptr = Tcl_GetStringFromObj (objv[arg], NULL);
+      if (*arg_ptr != '-')
+	break;
 
-      fdes = open_source_file (symtab);
-      if (fdes < 0)
+      if (Tcl_GetIndexFromObj (interp, objv[arg], options, "option", 0,
+			       &index) != TCL_OK)
 	{
-	  client_data->file_opened_p = -1;
+	  result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	  return TCL_ERROR;
 	}
-      else
+
+      if (arg + 1 >= objc)
 	{
-          /* FIXME: Convert to a Tcl File Channel and read from there.
-	     This will allow us to get the line endings and conversion
-	     to UTF8 right automatically when we move to 8.2.
-	     Need a Cygwin call to convert a file descriptor to the native
-	     Windows handler to do this. */
+	  gdbtk_set_result (interp, "Missing value for %s", arg_ptr);
+	  return TCL_ERROR;
+	}
 
-	  client_data->file_opened_p = 1;
-	  client_data->fp = fdopen (fdes, FOPEN_RB);
-	  clearerr (client_data->fp);
+      switch ((enum option_opts) index)
+	{
+	case OPT_CHUNK:
+	  if (Tcl_GetIntFromObj (interp, objv[arg + 1], &chunk) != TCL_OK)
+	    {
+	      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	      return TCL_ERROR;
+	    }
+	  break;
+	case OPT_COMMAND:
+	  command = objv[arg + 1];
+	  break;
+	case OPT_SHOW:
+	  show_obj = objv[arg + 1];
+	  break;
+	}
+    }
 
-          if (symtab->line_charpos == 0)
-            find_source_lines (symtab, fdes);
+  if (objc - arg != 5 && objc - arg != 6)
+    {
+      Tcl_WrongNumArgs (interp, 1, objv, "?-chunk lines? ?-show addr_list? ?-command script? widget [source|nosource] map_arr index_prefix low_address ?hi_address");
+      return TCL_ERROR;
+    }
 
-	  /* We are called with an actual load request, so call ourselves
-	     to load the first line. */
+  widget = Tcl_GetStringFromObj (objv[arg], NULL);
+  if ( Tk_NameToWindow (interp, widget,
+			Tk_MainWindow (interp)) == NULL)
+    {
+      gdbtk_set_result (interp, "Invalid widget name.");
+      return TCL_ERROR;
+    }
 
-	  gdbtk_load_source (clientData, symtab, start_line, end_line);
-	}
+  if (!Tcl_GetCommandInfo (interp, widget, &cmd))
+    {
+      gdbtk_set_result (interp, "Can't get widget command info");
+      return TCL_ERROR;
     }
+
+  arg_ptr = Tcl_GetStringFromObj (objv[arg + 1], NULL);
+  if (*arg_ptr == 's' && strcmp (arg_ptr, "source") == 0)
+    mixed_source_and_assembly = 1;
+  else if (*arg_ptr == 'n' && strcmp (arg_ptr, "nosource") == 0)
+    mixed_source_and_assembly = 0;
   else
     {
-      /* If we couldn't open the file, or got some prior error, just exit. */
-      return;
+      gdbtk_set_result (interp, "Second arg must be 'source' or 'nosource'");
+      return TCL_ERROR;
     }
-}
 
+  /* As we populate the text widget, we will also create an array in the
+     caller's scope.  The name is given by map_arr.
+     Each source line gets an entry or the form:
+     array($prefix,srcline=$src_line_no) = $widget_line_no
 
-/* FIXME: cagney/2003-09-08: "di" is not used and unneeded.  */
-static CORE_ADDR
-gdbtk_load_asm (ClientData clientData, CORE_ADDR pc,
-		struct disassemble_info *di)
-{
-  struct disassembly_client_data * client_data
-    = (struct disassembly_client_data *) clientData;
-  const char **text_argv;
-  int i, pc_to_line_len, line_to_pc_len;
-  gdbtk_result new_result;
-  int insn;
-  struct cleanup *old_chain = NULL;
+     Each assembly line gets two entries of the form:
+     array($prefix,pc=$pc) = $widget_line_no
+     array($prefix,line=$widget_line_no) = $src_line_no
 
-  pc_to_line_len = Tcl_DStringLength (&client_data->pc_to_line_prefix);
-  line_to_pc_len = Tcl_DStringLength (&client_data->line_to_pc_prefix);
+     Where prefix is index_prefix.
+  */
 
-  text_argv = client_data->asm_argv;
+  map_name = Tcl_GetStringFromObj (objv[arg + 2], NULL);
 
-  /* Preserve the current Tcl result object, print out what we need, and then
-     suck it out of the result, and replace... */
+  if (*map_name != '\0'
+      && Tcl_UpVar (interp, "1", map_name, "map_array", 0) != TCL_OK)
+    {
+      gdbtk_set_result (interp, "Can't link map array.");
+      return TCL_ERROR;
+    }
 
-  old_chain = make_cleanup (gdbtk_restore_result_ptr, (void *) result_ptr);
-  result_ptr = &new_result;
-  result_ptr->obj_ptr = client_data->result_obj[0];
-  result_ptr->flags = GDBTK_TO_RESULT;
+  /* Now parse the addresses */
+  if (Tcl_GetWideIntFromObj (interp, objv[arg + 4], &waddr) != TCL_OK)
+    return TCL_ERROR;
+  low = waddr;
 
-  /* Null out the three return objects we will use. */
+  orig = low;
 
-  for (i = 0; i < 3; i++)
-    Tcl_SetObjLength (client_data->result_obj[i], 0);
+  if (objc - arg == 5)
+    {
+      if (find_pc_partial_function (low, NULL, &low, &high) == 0)
+	error ("No function contains address 0x%s", core_addr_to_string (orig));
+    }
+  else
+    {
+      if (Tcl_GetWideIntFromObj (interp, objv[arg + 5], &waddr) != TCL_OK)
+	return TCL_ERROR;
+      high = waddr;
+    }
 
-  fputs_filtered (paddress (get_current_arch (), pc), gdb_stdout);
-  gdb_flush (gdb_stdout);
+  if (show_obj != NULL)
+    {
+      Tcl_Obj **show_objv;
+      int show_objc;
 
-  result_ptr->obj_ptr = client_data->result_obj[1];
-  print_address_symbolic (get_current_arch (), pc, gdb_stdout, 1, "\t");
-  gdb_flush (gdb_stdout);
+      if (Tcl_ListObjGetElements (interp, show_obj, &show_objc, &show_objv)
+	  != TCL_OK)
+	return TCL_ERROR;
 
-  result_ptr->obj_ptr = client_data->result_obj[2];
-  /* FIXME: cagney/2003-09-08: This should use gdb_disassembly.  */
-  insn = gdb_print_insn (get_current_arch (), pc, gdb_stdout, NULL);
-  gdb_flush (gdb_stdout);
+      for (i = 0; i < show_objc; i++)
+	{
+	  if (Tcl_GetWideIntFromObj (interp, show_objv[i], &waddr) != TCL_OK)
+	    return TCL_ERROR;
+	  show.push_back (waddr);
+	}
+    }
+  else
+    show.push_back (orig);
 
-  client_data->widget_line_no++;
+  /* Only one load into a widget at a time.  */
+  for (stream = disassembly_streams; stream != NULL; stream = stream->next)
+    if (strcmp (stream->client_data.widget, widget) == 0)
+      {
+	gdbtk_finish_disassembly_stream (stream, "cancelled", NULL);
+	break;
+      }
 
-  text_argv[5] = Tcl_GetStringFromObj (client_data->result_obj[0], NULL);
-  text_argv[7] = Tcl_GetStringFromObj (client_data->result_obj[1], NULL);
-  text_argv[11] = Tcl_GetStringFromObj (client_data->result_obj[2], NULL);
+  /* Setup the client_data structure, and call the driver function. */
 
-  client_data->cmd.proc (client_data->cmd.clientData,
-			 client_data->interp, 14, text_argv);
+  stream = new disassembly_stream ();
+  client_data = &stream->client_data;
 
-  if (*client_data->map_arr != '\0')
+  client_data->widget = widget;
+  client_data->cmd = cmd;
+  client_data->file_opened_p = 0;
+  client_data->widget_line_no = 0;
+  client_data->interp = interp;
+  for (i = 0; i < 3; i++)
     {
-      char *buffer;
+      client_data->result_obj[i] = Tcl_NewObj();
+      Tcl_IncrRefCount (client_data->result_obj[i]);
+    }
 
-      /* Run the command, then add an entry to the map array in
-	 the caller's scope. */
+  if (*map_name != '\0')
+    {
+      char *prefix;
+      int prefix_len;
 
-      Tcl_DStringAppend (&client_data->pc_to_line_prefix, core_addr_to_string (pc), -1);
+      client_data->map_arr = "map_array";
+      client_data->map_flags = 0;
 
-      /* FIXME: Convert to Tcl_SetVar2Ex when we move to 8.2.  This
-	 will allow us avoid converting widget_line_no into a string. */
+      prefix = Tcl_GetStringFromObj (objv[arg + 3], &prefix_len);
 
-      buffer = xstrprintf ("%d", client_data->widget_line_no);
+      Tcl_DStringInit(&client_data->src_to_line_prefix);
+      Tcl_DStringAppend (&client_data->src_to_line_prefix,
+			 prefix, prefix_len);
+      Tcl_DStringAppend (&client_data->src_to_line_prefix, ",srcline=",
+			 sizeof (",srcline=") - 1);
 
-      Tcl_SetVar2 (client_data->interp, client_data->map_arr,
-		   Tcl_DStringValue (&client_data->pc_to_line_prefix),
-		   buffer, 0);
+      Tcl_DStringInit(&client_data->pc_to_line_prefix);
+      Tcl_DStringAppend (&client_data->pc_to_line_prefix,
+			 prefix, prefix_len);
+      Tcl_DStringAppend (&client_data->pc_to_line_prefix, ",pc=",
+			 sizeof (",pc=") - 1);
 
-      Tcl_DStringAppend (&client_data->line_to_pc_prefix, buffer, -1);
+      Tcl_DStringInit(&client_data->line_to_pc_prefix);
+      Tcl_DStringAppend (&client_data->line_to_pc_prefix,
+			 prefix, prefix_len);
+      Tcl_DStringAppend (&client_data->line_to_pc_prefix, ",line=",
+			 sizeof (",line=") - 1);
+    }
+  else
+    {
+      client_data->map_arr = "";
+    }
 
+  /* Fill up the constant parts of the argv structures */
+  client_data->asm_argv[0] = client_data->widget;
+  client_data->asm_argv[1] = "insert";
+  client_data->asm_argv[2] = "end";
+  client_data->asm_argv[3] = "-\t";
+  client_data->asm_argv[4] = "break_rgn_tag";
+  /* client_data->asm_argv[5] = address; */
+  client_data->asm_argv[6] = "break_rgn_tag";
+  /* client_data->asm_argv[7] = offset; */
+  client_data->asm_argv[8] = "break_rgn_tag";
+  client_data->asm_argv[9] = ":\t\t";
+  client_data->asm_argv[10] = "source_tag";
+  /* client_data->asm_argv[11] = code; */
+  client_data->asm_argv[12] = "source_tag";
+  client_data->asm_argv[13] = "\n";
 
-      Tcl_SetVar2 (client_data->interp, client_data->map_arr,
-		   Tcl_DStringValue (&client_data->line_to_pc_prefix),
-		   core_addr_to_string (pc), 0);
+  if (mixed_source_and_assembly)
+    {
+      client_data->source_argv[0] = client_data->widget;
+      client_data->source_argv[1] = "insert";
+      client_data->source_argv[2] = "end";
+      /* client_data->source_argv[3] = line_number; */
+      client_data->source_argv[4] = "";
+      /* client_data->source_argv[5] = line; */
+      client_data->source_argv[6] = "source_tag2";
+    }
 
-      /* Restore the prefixes to their initial state. */
+  TRY
+    {
+      gdb_disassemble_plan (low, high, mixed_source_and_assembly,
+			    &stream->position);
+      done = gdb_disassemble_driver (&stream->position, chunk, &show,
+				     (ClientData) client_data,
+				     gdbtk_load_source, gdbtk_load_asm);
+    }
+  CATCH (e, RETURN_MASK_ALL)
+    {
+      gdbtk_free_disassembly_data (client_data);
+      delete stream;
+      throw_exception (e);
+    }
+  END_CATCH
 
-      Tcl_DStringSetLength (&client_data->pc_to_line_prefix, pc_to_line_len);
-      Tcl_DStringSetLength (&client_data->line_to_pc_prefix, line_to_pc_len);
+  if (done)
+    {
+      /* Now clean up the opened file, and the Tcl data structures */
+      gdbtk_free_disassembly_data (client_data);
+      delete stream;
+    }
+  else
+    {
+      /* The rest is loaded from the event loop, after the caller's
+	 frame (and the map_array link into it) is gone, so keep our
+	 own copies of the names.  */
+      client_data->widget = xstrdup (widget);
+      client_data->asm_argv[0] = client_data->widget;
+      client_data->source_argv[0] = client_data->widget;
+      if (*map_name != '\0')
+	{
+	  stream->map_name = xstrdup (map_name);
+	  client_data->map_arr = stream->map_name;
+	  client_data->map_flags = TCL_GLOBAL_ONLY;
+	}
 
-      xfree (buffer);
+      stream->chunk = chunk;
+      stream->command = command;
+      if (command != NULL)
+	Tcl_IncrRefCount (command);
+
+      stream->next = disassembly_streams;
+      disassembly_streams = stream;
+      Tcl_DoWhenIdle (gdbtk_disassembly_stream_proc, (ClientData) stream);
     }
 
-  do_cleanups (old_chain);
+  /* Finally, stick the low & high addresses into the Tcl result. */
 
-  return pc + insn;
+  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+			    Tcl_NewStringObj (core_addr_to_string (low), -1));
+  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+			    Tcl_NewStringObj (core_addr_to_string (high), -1));
+  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+			    Tcl_NewIntObj (!done));
+  return TCL_OK;
 }
 
+/* This implements the tcl command gdb_cancel_disassembly, which stops
+ * loads started by "gdb_load_disassembly -chunk".
+ *
+ * Arguments:
+ *    ?widget? - the text widget whose load is cancelled.  All pending
+ *               loads are cancelled if this is omitted.
+ * Tcl Result:
+ *    The number of loads cancelled.
+ */
+
 static int
-gdb_disassemble_driver (CORE_ADDR low, CORE_ADDR high,
-			int mixed_source_and_assembly,
-			ClientData clientData,
-			void (*print_source_fn) (ClientData, struct symtab *, int, int),
-			CORE_ADDR (*print_asm_fn) (ClientData, CORE_ADDR, struct disassemble_info *))
+gdb_cancel_disassembly (ClientData clientData, Tcl_Interp *interp,
+			int objc, Tcl_Obj *CONST objv[])
 {
-  CORE_ADDR pc;
+  struct disassembly_stream *stream, *next;
+  char *widget = NULL;
+  int count = 0;
 
-  /* If just doing straight assembly, all we need to do is disassemble
-     everything between low and high.  If doing mixed source/assembly, we've
-     got a totally different path to follow.  */
+  if (objc > 2)
+    {
+      Tcl_WrongNumArgs (interp, 1, objv, "?widget?");
+      return TCL_ERROR;
+    }
 
-  if (mixed_source_and_assembly)
-    {				/* Come here for mixed source/assembly */
-      /* The idea here is to present a source-O-centric view of a function to
-         the user.  This means that things are presented in source order, with
-         (possibly) out of order assembly immediately following.  */
-      struct compunit_symtab *cu;
-      struct symtab *symtab;
-      struct linetable_entry *le;
-      int nlines;
-      int newlines;
-      struct my_line_entry *mle;
-      struct symtab_and_line sal;
-      int i;
-      int out_of_order;
-      int next_line;
+  if (objc == 2)
+    widget = Tcl_GetStringFromObj (objv[1], NULL);
 
-      /* Assume compunit_symtab is valid for whole PC range */
-      cu = find_pc_compunit_symtab (low);
+  for (stream = disassembly_streams; stream != NULL; stream = next)
+    {
+      next = stream->next;
+      if (widget == NULL || strcmp (stream->client_data.widget, widget) == 0)
+	{
+	  gdbtk_finish_disassembly_stream (stream, "cancelled", NULL);
+	  count++;
+	  if (widget != NULL)
+	    break;
+	  /* The script may have started or cancelled other loads.  */
+	  next = disassembly_streams;
+	}
+    }
 
-      if (!cu)
-        goto assembly_only;
+  Tcl_SetIntObj (result_ptr->obj_ptr, count);
+  return TCL_OK;
+}
 
-      /* Use main file */
-      symtab = COMPUNIT_FILETABS (cu);
+/* Cancel all the pending disassembly loads.  This is used when the
+   symbol tables they refer to go away.  */
 
-      if (!symtab || !SYMTAB_LINETABLE (symtab))
-        goto assembly_only;
+void
+gdbtk_disassembly_cancel_all (void)
+{
+  while (disassembly_streams != NULL)
+    gdbtk_finish_disassembly_stream (disassembly_streams, "cancelled", NULL);
+}
 
-      /* First, convert the linetable to a bunch of my_line_entry's.  */
+/* Release the file and Tcl objects held by CLIENT_DATA.  */
 
-      le = SYMTAB_LINETABLE (symtab)->item;
-      nlines = SYMTAB_LINETABLE (symtab)->nitems;
+static void
+gdbtk_free_disassembly_data (struct disassembly_client_data *client_data)
+{
+  int i;
 
-      if (nlines <= 0)
-        goto assembly_only;
+  client_data->source.reset ();
+  client_data->file_opened_p = -1;
 
-      mle = (struct my_line_entry *) alloca (nlines *
-					     sizeof (struct my_line_entry));
+  if (*client_data->map_arr != '\0')
+    {
+      Tcl_DStringFree (&client_data->src_to_line_prefix);
+      Tcl_DStringFree (&client_data->pc_to_line_prefix);
+      Tcl_DStringFree (&client_data->line_to_pc_prefix);
+    }
 
-      out_of_order = 0;
+  for (i = 0; i < 3; i++)
+    {
+      Tcl_DecrRefCount (client_data->result_obj[i]);
+    }
+}
 
-      /* Copy linetable entries for this function into our data structure,
-	 creating end_pc's and setting out_of_order as appropriate.  */
+/* Idle callback which loads the next piece of a pending disassembly
+   load, and reschedules itself until the load is done.  */
 
-      /* First, skip all the preceding functions.  */
+static void
+gdbtk_disassembly_stream_proc (ClientData clientData)
+{
+  struct disassembly_stream *stream = (struct disassembly_stream *) clientData;
+  struct disassembly_client_data *client_data = &stream->client_data;
+  std::string message;
+  int done = 0, failed = 0;
 
-      for (i = 0; i < nlines - 1 && le[i].pc < low; i++) ;
+  stream->timer = NULL;
 
-      /* Now, copy all entries before the end of this function.  */
+  /* If the widget has been destroyed, nobody wants the rest.  */
+  if (!Tcl_GetCommandInfo (client_data->interp, client_data->widget,
+			   &client_data->cmd))
+    {
+      gdbtk_finish_disassembly_stream (stream, NULL, NULL);
+      return;
+    }
 
-      newlines = 0;
-      for (; i < nlines - 1 && le[i].pc < high; i++)
-        {
-          if (le[i].line == le[i + 1].line
-              && le[i].pc == le[i + 1].pc)
-            continue;		/* Ignore duplicates */
+  /* Don't read the target's memory while it is running.  */
+  if (running_now || load_in_progress)
+    {
+      stream->timer = Tcl_CreateTimerHandler (DISASSEMBLY_RETRY_INTERVAL,
+					      gdbtk_disassembly_stream_proc,
+					      clientData);
+      return;
+    }
 
-	  /* Skip any end-of-function markers.  */
-	  if (le[i].line == 0)
-	    continue;
+  TRY
+    {
+      done = gdb_disassemble_driver (&stream->position, stream->chunk, NULL,
+				     (ClientData) client_data,
+				     gdbtk_load_source, gdbtk_load_asm);
+    }
+  CATCH (e, RETURN_MASK_ALL)
+    {
+      failed = 1;
+      if (e.message != NULL)
+	message = e.message;
+    }
+  END_CATCH
 
-	  mle[newlines].line = le[i].line;
-          if (le[i].line > le[i + 1].line)
-            out_of_order = 1;
-          mle[newlines].start_pc = le[i].pc;
-          mle[newlines].end_pc = le[i + 1].pc;
-          newlines++;
-        }
+  if (failed)
+    gdbtk_finish_disassembly_stream (stream, "error", message.c_str ());
+  else if (done)
+    gdbtk_finish_disassembly_stream (stream, "done", NULL);
+  else
+    Tcl_DoWhenIdle (gdbtk_disassembly_stream_proc, clientData);
+}
 
-      /* If we're on the last line, and it's part of the function, then we
-         need to get the end pc in a special way.  */
+/* Remove STREAM from the list of pending loads and free it.  If STATUS
+   is not NULL, the load's -command script is called with the widget,
+   STATUS and MESSAGE (if not NULL) appended.  */
 
-      if (i == nlines - 1
-          && le[i].pc < high)
-        {
-          mle[newlines].line = le[i].line;
-          mle[newlines].start_pc = le[i].pc;
-          sal = find_pc_line (le[i].pc, 0);
-          mle[newlines].end_pc = sal.end;
-          newlines++;
-        }
+static void
+gdbtk_finish_disassembly_stream (struct disassembly_stream *stream,
+				 const char *status, const char *message)
+{
+  struct disassembly_stream **p;
 
-      /* Now, sort mle by line #s (and, then by addresses within lines). */
+  for (p = &disassembly_streams; *p != NULL; p = &(*p)->next)
+    {
+      if (*p == stream)
+	{
+	  *p = stream->next;
+	  break;
+	}
+    }
 
-      if (out_of_order)
-        qsort (mle, newlines, sizeof (struct my_line_entry), compare_lines);
+  Tcl_CancelIdleCall (gdbtk_disassembly_stream_proc, (ClientData) stream);
+  if (stream->timer != NULL)
+    Tcl_DeleteTimerHandler (stream->timer);
 
-      /* Now, for each line entry, emit the specified lines (unless they have
-	 been emitted before), followed by the assembly code for that line.  */
+  gdbtk_free_disassembly_data (&stream->client_data);
 
-      next_line = 0;		/* Force out first line */
-      for (i = 0; i < newlines; i++)
-        {
-          /* Print out everything from next_line to the current line.  */
+  if (stream->command != NULL)
+    {
+      if (status != NULL)
+	{
+	  Tcl_Interp *interp = stream->client_data.interp;
+	  Tcl_Obj *cmd = Tcl_DuplicateObj (stream->command);
+
+	  Tcl_IncrRefCount (cmd);
+	  Tcl_ListObjAppendElement (NULL, cmd,
+				    Tcl_NewStringObj (stream->client_data.widget,
+						      -1));
+	  Tcl_ListObjAppendElement (NULL, cmd, Tcl_NewStringObj (status, -1));
+	  if (message != NULL)
+	    Tcl_ListObjAppendElement (NULL, cmd,
+				      Tcl_NewStringObj (message, -1));
+	  if (Tcl_EvalObjEx (interp, cmd, TCL_EVAL_GLOBAL) != TCL_OK)
+	    report_error ();
+	  Tcl_DecrRefCount (cmd);
+	}
+      Tcl_DecrRefCount (stream->command);
+    }
 
-          if (mle[i].line >= next_line)
-            {
-              if (next_line != 0)
-                print_source_fn (clientData, symtab, next_line,
-				 mle[i].line + 1);
-              else
-                print_source_fn (clientData, symtab, mle[i].line,
-				 mle[i].line + 1);
+  xfree (stream->client_data.widget);
+  xfree (stream->map_name);
+  delete stream;
+}
 
-              next_line = mle[i].line + 1;
-            }
+static void
+gdbtk_load_source (ClientData clientData, struct symtab *symtab,
+		   int start_line, int end_line)
+{
+  struct disassembly_client_data *client_data =
+    (struct disassembly_client_data *) clientData;
+  source_buffer *source;
+  std::string scratch;
+  std::vector<size_t> offsets;
+  std::vector<const char *> text_argv;
+  char *buffer;
+  int index_len, ln;
+  size_t i;
 
-          for (pc = mle[i].start_pc; pc < mle[i].end_pc; )
-            {
-              QUIT;
-	      /* FIXME: cagney/2003-09-08: This entire function should
-                 be replaced by gdb_disassembly.  */
-	      pc = print_asm_fn (clientData, pc, NULL);
-            }
-        }
+  if (!client_data->file_opened_p)
+    {
+      /* The file is not yet open, try to get it.  If we fail, set
+	 FILE_OPENED_P to -1. */
+      const char *fullname = symtab_to_filename (symtab);
+
+      if (fullname != NULL)
+	client_data->source = gdbtk_get_source_buffer (fullname);
+      client_data->file_opened_p = client_data->source ? 1 : -1;
     }
-  else
+
+  /* If we couldn't open the file, or got some prior error, just exit. */
+  if (client_data->file_opened_p != 1)
+    return;
+
+  source = client_data->source.get ();
+
+  /* First do some sanity checks on the requested lines */
+
+  if (start_line < 1 || end_line < start_line
+      || (size_t) end_line > source->lines.size ())
+    return;
+
+  if (start_line == end_line)
+    return;
+
+  /* Insert all the lines with one widget command: each one is the line
+     number, without a tag, and the text.  Build the strings first,
+     SCRATCH may move as it grows.  */
+
+  for (ln = start_line; ln < end_line; ln++)
     {
-    assembly_only:
-      for (pc = low; pc < high; )
-        {
-          QUIT;
-	  /* FIXME: cagney/2003-09-08: This entire function should be
-	     replaced by gdb_disassembly.  */
-	  pc = print_asm_fn (clientData, pc, NULL);
-        }
+      size_t start = source->lines[ln - 1];
+
+      offsets.push_back (scratch.size ());
+      scratch.push_back ('\t');
+      scratch.append (std::to_string (ln));
+      scratch.push_back ('\0');
+
+      offsets.push_back (scratch.size ());
+      scratch.push_back ('\t');
+      scratch.append (source->text, start, source->lines[ln] - start);
+      scratch.push_back ('\0');
     }
 
-  return TCL_OK;
+  text_argv.push_back (client_data->source_argv[0]);
+  text_argv.push_back (client_data->source_argv[1]);
+  text_argv.push_back (client_data->source_argv[2]);
+  for (i = 0; i < offsets.size (); i += 2)
+    {
+      text_argv.push_back (scratch.c_str () + offsets[i]);
+      text_argv.push_back (client_data->source_argv[4]);
+      text_argv.push_back (scratch.c_str () + offsets[i + 1]);
+      text_argv.push_back (client_data->source_argv[6]);
+    }
+  text_argv.push_back (NULL);
+
+  client_data->cmd.proc (client_data->cmd.clientData, client_data->interp,
+			 text_argv.size () - 1, text_argv.data ());
+
+  /* Add an entry to the map array in the caller's scope for each line,
+     if requested. */
+
+  index_len = Tcl_DStringLength (&client_data->src_to_line_prefix);
+
+  for (ln = start_line; ln < end_line; ln++)
+    {
+      client_data->widget_line_no++;
+
+      if (*client_data->map_arr != '\0')
+	{
+	  std::string line_number = std::to_string (ln);
+
+	  Tcl_DStringAppend (&client_data->src_to_line_prefix,
+			     line_number.c_str (), -1);
+
+	  /* FIXME: Convert to Tcl_SetVar2Ex when we move to 8.2.  This
+	     will allow us avoid converting widget_line_no into a string. */
+
+	  buffer = xstrprintf ("%d", client_data->widget_line_no);
+
+	  Tcl_SetVar2 (client_data->interp, client_data->map_arr,
+		       Tcl_DStringValue (&client_data->src_to_line_prefix),
+		       buffer, client_data->map_flags);
+	  free(buffer);
+
+	  Tcl_DStringSetLength (&client_data->src_to_line_prefix, index_len);
+	}
+    }
 }
 
-/* This will be passed to qsort to sort the results of the disassembly */
 
-static int
-compare_lines (const PTR mle1p, const PTR mle2p)
+/* The disassembly cache.  gdbtk_load_asm keeps what it printed for
+   each instruction it decoded in a read-only section, so that loading
+   the same code again (another pane, a function we stepped back into,
+   a disassembly flavor we used before) doesn't decode it again.  The
+   instructions are kept per objfile and per disassembly settings;
+   they are dropped when the objfile is freed, when gdb writes to
+   their bytes (which also covers breakpoint insertion artifacts, see
+   gdbtk-bp.c) and when the architecture changes.  */
+
+#define DISASSEMBLY_CACHE_MAX_INSNS	100000
+
+struct disassembly_cache_insn
 {
-  struct my_line_entry *mle1, *mle2;
-  int val;
+  std::string address;
+  std::string symbolic;
+  std::string code;
+  int length;
+};
 
-  mle1 = (struct my_line_entry *) mle1p;
-  mle2 = (struct my_line_entry *) mle2p;
+typedef std::map<CORE_ADDR, disassembly_cache_insn> disassembly_cache_insns;
 
-  val = mle1->line - mle2->line;
+static std::map<std::pair<struct objfile *, std::string>,
+		disassembly_cache_insns> disassembly_cache;
+static size_t disassembly_cache_size = 0;
+static int disassembly_cache_enabled = 1;
 
-  if (val != 0)
-    return val;
+/* The settings which change the way instructions are printed, as
+   "name=value" strings, and their concatenation: the second half of
+   the cache key.  */
+static std::map<std::string, std::string> disassembly_settings;
+static std::string disassembly_settings_key;
 
-  return mle1->start_pc - mle2->start_pc;
-}
+/* Statistics, since the last "gdb_disassembly_cache stats -reset". */
+static ULONGEST disassembly_cache_hits = 0;
+static ULONGEST disassembly_cache_misses = 0;
 
-/* This implements the TCL command `gdb_loc',
+void
+gdbtk_disassembly_cache_flush (void)
+{
+  disassembly_cache.clear ();
+  disassembly_cache_size = 0;
+}
 
-* Arguments:
-*    ?symbol? The symbol or address to locate - defaults to pc
-* Tcl Return:
-*    a list consisting of the following:
-*       basename, function name, filename, line number, address, current pc
-*/
+/* Forget the instructions decoded from OBJFILE, which is going away.  */
 
-static int
-gdb_loc (ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+void
+gdbtk_disassembly_cache_forget (struct objfile *objfile)
 {
-  const char *filename;
-  struct symtab_and_line sal;
-  const char *fname;
-  CORE_ADDR pc;
+  auto it = disassembly_cache.lower_bound (std::make_pair (objfile,
+							   std::string ()));
 
-  if (objc == 1)
+  while (it != disassembly_cache.end () && it->first.first == objfile)
     {
-      /* This function can be called, before the target is properly
-         set-up, the following prevents an error, by trying to
-         read_pc when there is no pc to read. It defaults pc,
-         before the target is connected to the entry point of the
-         program */
-      if (!target_has_registers)
-        {
-          pc = entry_point_address ();
-          sal = find_pc_line (pc, 0);
-        }
-      else
-	{
-	  struct frame_info *frame;
-	  CORE_ADDR frame_pc, current_pc;
+      disassembly_cache_size -= it->second.size ();
+      it = disassembly_cache.erase (it);
+    }
+}
 
-	  frame = get_selected_frame (NULL);
-	  current_pc = regcache_read_pc (get_current_regcache ());
-	  frame_pc = get_frame_pc (frame);
+/* Forget any cached instruction overlapping [ADDR, ADDR + LEN).  */
 
-	  if (frame_pc != current_pc)
+void
+gdbtk_disassembly_cache_invalidate (CORE_ADDR addr, ULONGEST len)
+{
+  for (auto &objfile_insns : disassembly_cache)
+    {
+      disassembly_cache_insns &insns = objfile_insns.second;
+      auto it = insns.upper_bound (addr);
+
+      if (it != insns.begin ())
+	--it;
+      while (it != insns.end () && it->first < addr + len)
+	{
+	  if (it->first + it->second.length > addr)
 	    {
-	      /* Note - this next line is not correct on all architectures.
-		 For a graphical debugger we really want to highlight the
-		 assembly line that called the next function on the stack.
-		 Many architectures have the next instruction saved as the
-		 pc on the stack, so what happens is the next instruction
-		 is highlighted. FIXME */
-	      pc = frame_pc;
-	      find_frame_sal (frame, &sal);
+	      it = insns.erase (it);
+	      disassembly_cache_size--;
 	    }
 	  else
-	    {
-	      pc = current_pc;
-	      sal = find_pc_line (pc, 0);
-	    }
+	    ++it;
 	}
     }
-  else if (objc == 2)
-    {
-      struct symtabs_and_lines sals;
+}
 
-      sals = decode_line_with_current_source (Tcl_GetStringFromObj (objv[1], NULL), 1);
+/* Called when the gdb setting PARAM changes to VALUE.  The ones which
+   affect the disassembly select another set of cached instructions.  */
 
-      sal = sals.sals[0];
-      free (sals.sals);
+void
+gdbtk_disassembly_cache_param (const char *param, const char *value)
+{
+  if (strstr (param, "disassembl") == NULL
+      && strncmp (param, "print ", sizeof ("print ") - 1) != 0)
+    return;
 
-      if (sals.nelts != 1)
-	{
-	  gdbtk_set_result (interp, "Ambiguous line spec", -1);
-	  return TCL_ERROR;
-	}
-      resolve_sal_pc (&sal);
-      pc = sal.pc;
-    }
-  else
+  disassembly_settings[param] = value != NULL ? value : "";
+
+  disassembly_settings_key.clear ();
+  for (const auto &setting : disassembly_settings)
     {
-      Tcl_WrongNumArgs (interp, 1, objv, "?symbol?");
-      return TCL_ERROR;
+      disassembly_settings_key += setting.first;
+      disassembly_settings_key += '=';
+      disassembly_settings_key += setting.second;
+      disassembly_settings_key += '\n';
     }
+}
 
-  if (sal.symtab)
-    Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
-			      Tcl_NewStringObj (sal.symtab->filename, -1));
-  else
-    Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
-			      Tcl_NewStringObj ("", 0));
+/* Return the cached instructions for the code at PC, or NULL if code
+   at PC is not cached.  */
 
-  fname = pc_function_name (pc);
-  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
-			    Tcl_NewStringObj (fname, -1));
+static disassembly_cache_insns *
+gdbtk_disassembly_cache_find (CORE_ADDR pc)
+{
+  struct obj_section *osect;
 
-  filename = symtab_to_filename (sal.symtab);
-  if (filename == NULL)
-    filename = "";
+  if (!disassembly_cache_enabled)
+    return NULL;
 
-  /* file name */
-  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr, Tcl_NewStringObj (filename, -1));
-  /* line number */
-  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr, Tcl_NewIntObj (sal.line));
-  /* PC in current frame */
-  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
-			    Tcl_NewStringObj (core_addr_to_string (pc), -1));
-  /* Real PC */
+  osect = find_pc_section (pc);
+  if (osect == NULL || osect->objfile == NULL
+      || !(bfd_get_section_flags (osect->objfile->obfd,
+				  osect->the_bfd_section) & SEC_READONLY))
+    return NULL;
+
+  if (disassembly_cache_size >= DISASSEMBLY_CACHE_MAX_INSNS)
+    gdbtk_disassembly_cache_flush ();
+
+  return &disassembly_cache[std::make_pair (osect->objfile,
+					    disassembly_settings_key)];
+}
+
+/* This implements the Tcl command 'gdb_disassembly_cache', which
+ * controls the cache of decoded instructions used by
+ * gdb_load_disassembly.
+ *
+ * Arguments:
+ *   gdb_disassembly_cache stats ?-reset?
+ *     Returns a list of name/value pairs: "hits" and "misses" count
+ *     instructions and "insns" is the number of instructions currently
+ *     cached.  With -reset, the counters are cleared after being
+ *     returned.
+ *   gdb_disassembly_cache flush
+ *     Empties the cache.
+ *   gdb_disassembly_cache enable ?boolean?
+ *     Returns, or sets, whether the cache is used.
+ */
+
+static int
+gdb_disassembly_cache (ClientData clientData, Tcl_Interp *interp,
+		       int objc, Tcl_Obj *CONST objv[])
+{
+  int index;
+  static const char *commands[] = {"stats", "flush", "enable", NULL};
+  enum commands_enum { DISCACHE_STATS, DISCACHE_FLUSH, DISCACHE_ENABLE };
+
+  if (objc < 2)
+    {
+      Tcl_WrongNumArgs (interp, 1, objv, "stats|flush|enable ?arg?");
+      return TCL_ERROR;
+    }
+
+  if (Tcl_GetIndexFromObj (interp, objv[1], commands, "option", 0,
+			   &index) != TCL_OK)
+    {
+      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+      return TCL_ERROR;
+    }
+
+  switch ((enum commands_enum) index)
+    {
+    case DISCACHE_STATS:
+      if (objc > 3 || (objc == 3
+		       && strcmp (Tcl_GetString (objv[2]), "-reset") != 0))
+	{
+	  Tcl_WrongNumArgs (interp, 2, objv, "?-reset?");
+	  return TCL_ERROR;
+	}
+      Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("hits", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (disassembly_cache_hits));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("misses", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (disassembly_cache_misses));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("insns", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (disassembly_cache_size));
+      if (objc == 3)
+	disassembly_cache_hits = disassembly_cache_misses = 0;
+      break;
+
+    case DISCACHE_FLUSH:
+      gdbtk_disassembly_cache_flush ();
+      break;
+
+    case DISCACHE_ENABLE:
+      if (objc > 3)
+	{
+	  Tcl_WrongNumArgs (interp, 2, objv, "?boolean?");
+	  return TCL_ERROR;
+	}
+      if (objc == 3)
+	{
+	  if (Tcl_GetBooleanFromObj (interp, objv[2],
+				     &disassembly_cache_enabled) != TCL_OK)
+	    {
+	      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	      return TCL_ERROR;
+	    }
+	  if (!disassembly_cache_enabled)
+	    gdbtk_disassembly_cache_flush ();
+	}
+      Tcl_SetBooleanObj (result_ptr->obj_ptr, disassembly_cache_enabled);
+      break;
+    }
+
+  return TCL_OK;
+}
+
+/* FIXME: cagney/2003-09-08: "di" is not used and unneeded.  */
+static CORE_ADDR
+gdbtk_load_asm (ClientData clientData, CORE_ADDR pc,
+		struct disassemble_info *di)
+{
+  struct disassembly_client_data * client_data
+    = (struct disassembly_client_data *) clientData;
+  const char **text_argv;
+  int i, pc_to_line_len, line_to_pc_len;
+  gdbtk_result new_result;
+  int insn;
+  struct cleanup *old_chain = NULL;
+  disassembly_cache_insns *insns;
+  const struct disassembly_cache_insn *cached = NULL;
+
+  pc_to_line_len = Tcl_DStringLength (&client_data->pc_to_line_prefix);
+  line_to_pc_len = Tcl_DStringLength (&client_data->line_to_pc_prefix);
+
+  text_argv = client_data->asm_argv;
+
+  insns = gdbtk_disassembly_cache_find (pc);
+  if (insns != NULL)
+    {
+      disassembly_cache_insns::const_iterator it = insns->find (pc);
+
+      if (it != insns->end ())
+	{
+	  cached = &it->second;
+	  disassembly_cache_hits++;
+	}
+    }
+
+  if (cached == NULL)
+    {
+      /* Preserve the current Tcl result object, print out what we need,
+	 and then suck it out of the result, and replace... */
+
+      old_chain = make_cleanup (gdbtk_restore_result_ptr,
+				(void *) result_ptr);
+      result_ptr = &new_result;
+      result_ptr->obj_ptr = client_data->result_obj[0];
+      result_ptr->flags = GDBTK_TO_RESULT;
+
+      /* Null out the three return objects we will use. */
+
+      for (i = 0; i < 3; i++)
+	Tcl_SetObjLength (client_data->result_obj[i], 0);
+
+      fputs_filtered (paddress (get_current_arch (), pc), gdb_stdout);
+      gdb_flush (gdb_stdout);
+
+      result_ptr->obj_ptr = client_data->result_obj[1];
+      print_address_symbolic (get_current_arch (), pc, gdb_stdout, 1, "\t");
+      gdb_flush (gdb_stdout);
+
+      result_ptr->obj_ptr = client_data->result_obj[2];
+      /* FIXME: cagney/2003-09-08: This should use gdb_disassembly.  */
+      insn = gdb_print_insn (get_current_arch (), pc, gdb_stdout, NULL);
+      gdb_flush (gdb_stdout);
+
+      do_cleanups (old_chain);
+
+      text_argv[5] = Tcl_GetStringFromObj (client_data->result_obj[0], NULL);
+      text_argv[7] = Tcl_GetStringFromObj (client_data->result_obj[1], NULL);
+      text_argv[11] = Tcl_GetStringFromObj (client_data->result_obj[2], NULL);
+
+      if (insns != NULL)
+	{
+	  disassembly_cache_insn &entry = (*insns)[pc];
+
+	  entry.address = text_argv[5];
+	  entry.symbolic = text_argv[7];
+	  entry.code = text_argv[11];
+	  entry.length = insn;
+	  disassembly_cache_size++;
+	  disassembly_cache_misses++;
+	}
+    }
+  else
+    {
+      text_argv[5] = cached->address.c_str ();
+      text_argv[7] = cached->symbolic.c_str ();
+      text_argv[11] = cached->code.c_str ();
+      insn = cached->length;
+    }
+
+  client_data->widget_line_no++;
+
+  client_data->cmd.proc (client_data->cmd.clientData,
+			 client_data->interp, 14, text_argv);
+
+  if (*client_data->map_arr != '\0')
+    {
+      char *buffer;
+
+      /* Run the command, then add an entry to the map array in
+	 the caller's scope. */
+
+      Tcl_DStringAppend (&client_data->pc_to_line_prefix, core_addr_to_string (pc), -1);
+
+      /* FIXME: Convert to Tcl_SetVar2Ex when we move to 8.2.  This
+	 will allow us avoid converting widget_line_no into a string. */
+
+      buffer = xstrprintf ("%d", client_data->widget_line_no);
+
+      Tcl_SetVar2 (client_data->interp, client_data->map_arr,
+		   Tcl_DStringValue (&client_data->pc_to_line_prefix),
+		   buffer, client_data->map_flags);
+
+      Tcl_DStringAppend (&client_data->line_to_pc_prefix, buffer, -1);
+
+
+      Tcl_SetVar2 (client_data->interp, client_data->map_arr,
+		   Tcl_DStringValue (&client_data->line_to_pc_prefix),
+		   core_addr_to_string (pc), client_data->map_flags);
+
+      /* Restore the prefixes to their initial state. */
+
+      Tcl_DStringSetLength (&client_data->pc_to_line_prefix, pc_to_line_len);
+      Tcl_DStringSetLength (&client_data->line_to_pc_prefix, line_to_pc_len);
+
+      xfree (buffer);
+    }
+
+  return pc + insn;
+}
+
+/* Fill in POSITION with the steps needed to disassemble [LOW, HIGH),
+   and rewind it to the first one.  */
+
+static void
+gdb_disassemble_plan (CORE_ADDR low, CORE_ADDR high,
+		      int mixed_source_and_assembly,
+		      struct disassembly_position *position)
+{
+  struct disassembly_step step;
+
+  position->steps.clear ();
+  position->step = 0;
+  position->source_done = 0;
+  position->pc = low;
+
+  /* If just doing straight assembly, all we need to do is disassemble
+     everything between low and high.  If doing mixed source/assembly, we've
+     got a totally different path to follow.  */
+
+  if (mixed_source_and_assembly)
+    {				/* Come here for mixed source/assembly */
+      /* The idea here is to present a source-O-centric view of a function to
+         the user.  This means that things are presented in source order, with
+         (possibly) out of order assembly immediately following.  */
+      struct compunit_symtab *cu;
+      struct symtab *symtab;
+      struct linetable_entry *le;
+      int nlines;
+      int newlines;
+      std::vector<my_line_entry> mle;
+      struct symtab_and_line sal;
+      int i;
+      int out_of_order;
+      int next_line;
+
+      /* Assume compunit_symtab is valid for whole PC range */
+      cu = find_pc_compunit_symtab (low);
+
+      if (!cu)
+        goto assembly_only;
+
+      /* Use main file */
+      symtab = COMPUNIT_FILETABS (cu);
+
+      if (!symtab || !SYMTAB_LINETABLE (symtab))
+        goto assembly_only;
+
+      /* First, convert the linetable to a bunch of my_line_entry's.  */
+
+      le = SYMTAB_LINETABLE (symtab)->item;
+      nlines = SYMTAB_LINETABLE (symtab)->nitems;
+
+      if (nlines <= 0)
+        goto assembly_only;
+
+      mle.resize (nlines);
+
+      out_of_order = 0;
+
+      /* Copy linetable entries for this function into our data structure,
+	 creating end_pc's and setting out_of_order as appropriate.  */
+
+      /* First, skip all the preceding functions.  */
+
+      for (i = 0; i < nlines - 1 && le[i].pc < low; i++) ;
+
+      /* Now, copy all entries before the end of this function.  */
+
+      newlines = 0;
+      for (; i < nlines - 1 && le[i].pc < high; i++)
+        {
+          if (le[i].line == le[i + 1].line
+              && le[i].pc == le[i + 1].pc)
+            continue;		/* Ignore duplicates */
+
+	  /* Skip any end-of-function markers.  */
+	  if (le[i].line == 0)
+	    continue;
+
+	  mle[newlines].line = le[i].line;
+          if (le[i].line > le[i + 1].line)
+            out_of_order = 1;
+          mle[newlines].start_pc = le[i].pc;
+          mle[newlines].end_pc = le[i + 1].pc;
+          newlines++;
+        }
+
+      /* If we're on the last line, and it's part of the function, then we
+         need to get the end pc in a special way.  */
+
+      if (i == nlines - 1
+          && le[i].pc < high)
+        {
+          mle[newlines].line = le[i].line;
+          mle[newlines].start_pc = le[i].pc;
+          sal = find_pc_line (le[i].pc, 0);
+          mle[newlines].end_pc = sal.end;
+          newlines++;
+        }
+
+      /* Now, sort mle by line #s (and, then by addresses within lines). */
+
+      if (out_of_order)
+        qsort (mle.data (), newlines, sizeof (struct my_line_entry),
+	       compare_lines);
+
+      /* Now, for each line entry, emit the specified lines (unless they have
+	 been emitted before), followed by the assembly code for that line.  */
+
+      next_line = 0;		/* Force out first line */
+      for (i = 0; i < newlines; i++)
+        {
+          /* Print out everything from next_line to the current line.  */
+
+          if (mle[i].line >= next_line)
+            {
+	      step.symtab = symtab;
+	      step.first_line = next_line != 0 ? next_line : mle[i].line;
+	      step.end_line = mle[i].line + 1;
+              next_line = mle[i].line + 1;
+            }
+	  else
+	    step.symtab = NULL;
+
+	  step.start_pc = mle[i].start_pc;
+	  step.end_pc = mle[i].end_pc;
+	  position->steps.push_back (step);
+        }
+      return;
+    }
+
+ assembly_only:
+  step.symtab = NULL;
+  step.start_pc = low;
+  step.end_pc = high;
+  position->steps.push_back (step);
+}
+
+/* Run the steps in POSITION from where it was left, calling
+   PRINT_SOURCE_FN and PRINT_ASM_FN with CLIENTDATA to do the printing.
+   If LIMIT is greater than zero, stop once LIMIT lines have been
+   printed and none of the addresses in SHOW (if not NULL) remain to be
+   printed.  Returns 1 when all the steps are done, 0 if there are more
+   to do.  */
+
+static int
+gdb_disassemble_driver (struct disassembly_position *position,
+			int limit, std::vector<CORE_ADDR> *show,
+			ClientData clientData,
+			void (*print_source_fn) (ClientData, struct symtab *, int, int),
+			CORE_ADDR (*print_asm_fn) (ClientData, CORE_ADDR, struct disassemble_info *))
+{
+  int count = 0;
+
+  /* Addresses outside the steps will never be printed, so don't wait
+     for them.  */
+  if (show != NULL)
+    {
+      size_t i;
+
+      for (i = 0; i < show->size (); )
+	{
+	  const struct disassembly_step *step;
+	  CORE_ADDR addr = (*show)[i];
+
+	  for (step = position->steps.data ();
+	       step < position->steps.data () + position->steps.size ();
+	       step++)
+	    if (addr >= step->start_pc && addr < step->end_pc)
+	      break;
+
+	  if (step == position->steps.data () + position->steps.size ())
+	    show->erase (show->begin () + i);
+	  else
+	    i++;
+	}
+    }
+
+  while (position->step < position->steps.size ())
+    {
+      struct disassembly_step *step = &position->steps[position->step];
+
+      if (limit > 0 && count >= limit && (show == NULL || show->empty ()))
+	return 0;
+
+      if (!position->source_done)
+	{
+	  if (step->symtab != NULL)
+	    {
+	      print_source_fn (clientData, step->symtab, step->first_line,
+			       step->end_line);
+	      count += step->end_line - step->first_line;
+	    }
+	  position->source_done = 1;
+	  position->pc = step->start_pc;
+	}
+
+      while (position->pc < step->end_pc)
+        {
+	  CORE_ADDR pc = position->pc;
+
+	  if (limit > 0 && count >= limit && (show == NULL || show->empty ()))
+	    return 0;
+
+          QUIT;
+	  /* FIXME: cagney/2003-09-08: This entire function should be
+	     replaced by gdb_disassembly.  */
+	  position->pc = print_asm_fn (clientData, pc, NULL);
+	  count++;
+
+	  if (show != NULL)
+	    show->erase (std::remove_if (show->begin (), show->end (),
+					 [=] (CORE_ADDR addr)
+					 {
+					   return (addr >= pc
+						   && addr < position->pc);
+					 }),
+			 show->end ());
+        }
+
+      position->step++;
+      position->source_done = 0;
+    }
+
+  return 1;
+}
+
+/* This will be passed to qsort to sort the results of the disassembly */
+
+static int
+compare_lines (const PTR mle1p, const PTR mle2p)
+{
+  struct my_line_entry *mle1, *mle2;
+  int val;
+
+  mle1 = (struct my_line_entry *) mle1p;
+  mle2 = (struct my_line_entry *) mle2p;
+
+  val = mle1->line - mle2->line;
+
+  if (val != 0)
+    return val;
+
+  return mle1->start_pc - mle2->start_pc;
+}
+
+/* This implements the TCL command `gdb_loc',
+
+* Arguments:
+*    ?symbol? The symbol or address to locate - defaults to pc
+* Tcl Return:
+*    a list consisting of the following:
+*       basename, function name, filename, line number, address, current pc
+*/
+
+static int
+gdb_loc (ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+{
+  const char *filename;
+  struct symtab_and_line sal;
+  const char *fname;
+  CORE_ADDR pc;
+
+  if (objc == 1)
+    {
+      /* This function can be called, before the target is properly
+         set-up, the following prevents an error, by trying to
+         read_pc when there is no pc to read. It defaults pc,
+         before the target is connected to the entry point of the
+         program */
+      if (!target_has_registers)
+        {
+          pc = entry_point_address ();
+          sal = find_pc_line (pc, 0);
+        }
+      else
+	{
+	  struct frame_info *frame;
+	  CORE_ADDR frame_pc, current_pc;
+
+	  frame = get_selected_frame (NULL);
+	  current_pc = regcache_read_pc (get_current_regcache ());
+	  frame_pc = get_frame_pc (frame);
+
+	  if (frame_pc != current_pc)
+	    {
+	      /* Note - this next line is not correct on all architectures.
+		 For a graphical debugger we really want to highlight the
+		 assembly line that called the next function on the stack.
+		 Many architectures have the next instruction saved as the
+		 pc on the stack, so what happens is the next instruction
+		 is highlighted. FIXME */
+	      pc = frame_pc;
+	      find_frame_sal (frame, &sal);
+	    }
+	  else
+	    {
+	      pc = current_pc;
+	      sal = find_pc_line (pc, 0);
+	    }
+	}
+    }
+  else if (objc == 2)
+    {
+      struct symtabs_and_lines sals;
+
+      sals = decode_line_with_current_source (Tcl_GetStringFromObj (objv[1], NULL), 1);
+
+      sal = sals.sals[0];
+      free (sals.sals);
+
+      if (sals.nelts != 1)
+	{
+	  gdbtk_set_result (interp, "Ambiguous line spec", -1);
+	  return TCL_ERROR;
+	}
+      resolve_sal_pc (&sal);
+      pc = sal.pc;
+    }
+  else
+    {
+      Tcl_WrongNumArgs (interp, 1, objv, "?symbol?");
+      return TCL_ERROR;
+    }
+
+  if (sal.symtab)
+    Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+			      Tcl_NewStringObj (sal.symtab->filename, -1));
+  else
+    Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+			      Tcl_NewStringObj ("", 0));
+
+  fname = pc_function_name (pc);
+  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+			    Tcl_NewStringObj (fname, -1));
+
+  filename = symtab_to_filename (sal.symtab);
+  if (filename == NULL)
+    filename = "";
+
+  /* file name */
+  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr, Tcl_NewStringObj (filename, -1));
+  /* line number */
+  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr, Tcl_NewIntObj (sal.line));
+  /* PC in current frame */
+  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+			    Tcl_NewStringObj (core_addr_to_string (pc), -1));
+  /* Real PC */
   Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
 			    Tcl_NewStringObj (core_addr_to_string (stop_pc), -1));
   /* shared library */
@@ -2326,370 +4115,1533 @@ gdb_loc (ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST obj
   return TCL_OK;
 }
 
-/* This implements the TCL command gdb_entry_point.  It returns the current
-   entry point address.  */
+/* This implements the TCL command gdb_entry_point.  It returns the current
+   entry point address.  */
+
+static int
+gdb_entry_point (ClientData clientData, Tcl_Interp *interp,
+		 int objc, Tcl_Obj *CONST objv[])
+{
+  char *addrstr;
+
+  /* If we have not yet loaded an exec file, then we have no
+     entry point, so return an empty string.*/
+  if ((int) current_target.to_stratum > (int) dummy_stratum)
+    {
+      addrstr = (char *)core_addr_to_string (entry_point_address ());
+      Tcl_SetStringObj (result_ptr->obj_ptr, addrstr, -1);
+    }
+  else
+    Tcl_SetStringObj (result_ptr->obj_ptr, "", -1);
+
+  return TCL_OK;
+}
+
+/* Covert hex to binary. Stolen from remote.c,
+   but added error handling */
+static int
+fromhex (int a)
+{
+  if (a >= '0' && a <= '9')
+    return a - '0';
+  else if (a >= 'a' && a <= 'f')
+    return a - 'a' + 10;
+  else if (a >= 'A' && a <= 'F')
+    return a - 'A' + 10;
+
+  return -1;
+}
+
+static int
+hex2bin (const char *hex, char *bin, int count)
+{
+  int i, m, n;
+  int incr = 2;
+
+
+  if (gdbarch_byte_order (get_current_arch ()) == BFD_ENDIAN_LITTLE)
+    {
+      /* need to read string in reverse */
+      hex += count - 2;
+      incr = -2;
+    }
+
+  for (i = 0; i < count; i += 2)
+    {
+      if (hex[0] == 0 || hex[1] == 0)
+	{
+	  /* Hex string is short, or of uneven length.
+	     Return the count that has been converted so far. */
+	  return i;
+	}
+      m = fromhex (hex[0]);
+      n = fromhex (hex[1]);
+      if (m == -1 || n == -1)
+	return -1;
+      *bin++ = m * 16 + n;
+      hex += incr;
+    }
+
+  return i;
+}
+
+/* This implements the Tcl command 'gdb_set_mem', which
+ * sets some chunk of memory.
+ *
+ * Arguments:
+ *   gdb_set_mem addr hexstr len
+ *
+ *   addr:   address of data to set
+ *   hexstr: ascii string of data to set
+ *   len:    number of bytes of data to set
+ */
+static int
+gdb_set_mem (ClientData clientData, Tcl_Interp *interp,
+	     int objc, Tcl_Obj *CONST objv[])
+{
+  CORE_ADDR addr;
+  gdb_byte buf[128];
+  char *hexstr;
+  int len, size;
+
+  if (objc != 4)
+    {
+      Tcl_WrongNumArgs (interp, 1, objv, "addr hex_data len");
+      return TCL_ERROR;
+    }
+
+  /* Address to write */
+  addr = string_to_core_addr (Tcl_GetStringFromObj (objv[1], NULL));
+
+  /* String value to write: it's in hex */
+  hexstr = Tcl_GetStringFromObj (objv[2], NULL);
+  if (hexstr == NULL)
+    return TCL_ERROR;
+
+  /* Length of buf */
+  if (Tcl_GetIntFromObj (interp, objv[3], &len) != TCL_OK)
+    return TCL_ERROR;
+
+  /* Convert hexstr to binary and write */
+  if (hexstr[0] == '0' && hexstr[1] == 'x')
+    hexstr += 2;
+  size = hex2bin (hexstr, (char *) buf, strlen (hexstr));
+  if (size < 0)
+    {
+      /* Error in input */
+      gdbtk_set_result (interp, "Invalid hexadecimal input: \"0x%s\"", hexstr);
+      return TCL_ERROR;
+    }
+
+  target_write_memory (addr, buf, len);
+  gdbtk_memory_journal_add (addr, len);
+  return TCL_OK;
+}
+
+/* This implements the Tcl command 'gdb_update_mem', which
+ * updates a block of memory in the memory window
+ *
+ * Arguments:
+ *   gdb_update_mem data addr form size nbytes bpr aschar
+ *
+ *   1 data: variable that holds table's data
+ *   2 addr: address of data to dump
+ *   3 mform: a char indicating format
+ *   4 size: size of each element; 1,2,4, or 8 bytes
+ *   5 nbytes: the number of bytes to read
+ *   6 bpr: bytes per row
+ *   7 aschar: if present, an ASCII dump of the row is included.  ASCHAR
+ *              used for unprintable characters.
+ *
+ * Return:
+ * a list of three integers: {border_col_width data_col_width ascii_col_width}
+ * which can be used to set the table's column widths. */
+
+static int
+gdb_update_mem (ClientData clientData, Tcl_Interp *interp,
+		int objc, Tcl_Obj *CONST objv[])
+{
+  long dummy;
+  char index[20];
+  CORE_ADDR addr;
+  int nbytes, rnum, bpr;
+  int size, asize, i, j, bc;
+  int max_ascii_len, max_val_len, max_label_len;
+  char format, aschar;
+  char *data, *tmp;
+  char buff[128], *bptr;
+  gdb_byte *mbuf, *mptr, *cptr;
+  string_file stb;
+  struct type *val_type;
+
+  if (objc < 7 || objc > 8)
+    {
+      Tcl_WrongNumArgs (interp, 1, objv, "data addr format size bytes bytes_per_row ?ascii_char?");
+      return TCL_ERROR;
+    }
+
+  /* Get table data and link to a local variable */
+  data = Tcl_GetStringFromObj (objv[1], NULL);
+  if (data == NULL)
+    {
+      gdbtk_set_result (interp, "could not get data variable");
+      return TCL_ERROR;
+    }
+
+  if (Tcl_UpVar (interp, "1", data, "data", 0) != TCL_OK)
+    {
+      gdbtk_set_result (interp, "could not link table data");
+      return TCL_ERROR;
+    }
+
+  if (Tcl_GetIntFromObj (interp, objv[4], &size) != TCL_OK)
+    return TCL_ERROR;
+  else if (size <= 0)
+    {
+      gdbtk_set_result (interp, "Invalid size, must be > 0");
+      return TCL_ERROR;
+    }
+
+  if (Tcl_GetIntFromObj (interp, objv[5], &nbytes) != TCL_OK)
+    return TCL_ERROR;
+  else if (nbytes <= 0)
+    {
+      gdbtk_set_result (interp, "Invalid number of bytes, must be > 0");
+      return TCL_ERROR;
+    }
+
+  if (Tcl_GetIntFromObj (interp, objv[6], &bpr) != TCL_OK)
+    return TCL_ERROR;
+  else if (bpr <= 0)
+    {
+      gdbtk_set_result (interp, "Invalid bytes per row, must be > 0");
+      return TCL_ERROR;
+    }
+
+  tmp = Tcl_GetStringFromObj (objv[2], NULL);
+  if (tmp == NULL)
+    {
+      gdbtk_set_result (interp, "could not get address");
+      return TCL_ERROR;
+    }
+  addr = string_to_core_addr (tmp);
+
+  format = *(Tcl_GetStringFromObj (objv[3], NULL));
+  mbuf = (gdb_byte *) xmalloc (nbytes + 32);
+  if (!mbuf)
+    {
+      gdbtk_set_result (interp, "Out of memory.");
+      return TCL_ERROR;
+    }
+
+  memset (mbuf, 0, nbytes + 32);
+  mptr = cptr = mbuf;
+
+  rnum = gdbtk_read_memory (addr, mbuf, nbytes);
+  if (rnum <= 0)
+    {
+      gdbtk_set_result (interp, "Unable to read memory.");
+      return TCL_ERROR;
+    }
+
+  if (objc == 8)
+    aschar = *(Tcl_GetStringFromObj (objv[7], NULL));
+  else
+    aschar = 0;
+
+  val_type = gdbtk_mem_cell_type (size, &asize);
+
+  bc = 0;			/* count of bytes in a row */
+  bptr = &buff[0];		/* pointer for ascii dump */
+
+  /* A little macro to do column indices. As a rule, given the current
+     byte, i, of a total nbytes and the bytes per row, bpr, and the size of
+     each cell, size, the row and column will be given by:
+
+     row = i/bpr
+     col = (i%bpr)/size
+  */
+#define INDEX(row,col) sprintf (index, "%d,%d",(row),(col))
+
+  /* Fill in address labels */
+  max_label_len = 0;
+  for (i = 0; i < nbytes; i += bpr)
+    {
+      char s[130];
+      sprintf (s, "%s", core_addr_to_string (addr + i));
+      INDEX ((int) i/bpr, -1);
+      Tcl_SetVar2 (interp, "data", index, s, 0);
+
+      /* The tcl code in MemWin::update_addr used to track the size
+	 of each cell. I don't see how these could change for any given
+	 update, so we don't loop over all cells. We just note the first
+	 size. */
+      if (max_label_len == 0)
+	max_label_len = strlen (s);
+    }
+
+  /* Fill in memory */
+  max_val_len   = 0;		/* Ditto the above comments about max_label_len */
+  max_ascii_len = 0;
+  for (i = 0; i < nbytes; i += size)
+    {
+      stb.clear ();
+      INDEX ((int) i/bpr, (int) (i%bpr)/size);
+
+      if (i >= rnum)
+	{
+	  /* Read fewer bytes than requested */
+	  stb.puts ("N/A");
+
+	  if (aschar)
+	    {
+	      for (j = 0; j < size; j++)
+		*bptr++ = 'X';
+	    }
+	}
+      else
+	{
+	  struct value_print_options opts;
+
+	  get_formatted_print_options (&opts, format);
+
+	  /* print memory to our uiout file and set the table's variable */
+	  print_scalar_formatted (mptr, val_type, &opts, asize, &stb);
+
+	  /* See comments above on max_*_len */
+	  if (max_val_len == 0)
+	    max_val_len = stb.size ();
+
+	  if (aschar)
+	    {
+	      for (j = 0; j < size; j++)
+		{
+		  if (isprint (*cptr))
+		    *bptr++ = *cptr++;
+		  else
+		    {
+		      *bptr++ = aschar;
+		      cptr++;;
+		    }
+		}
+	    }
+	}
+      Tcl_SetVar2 (interp, "data", index, stb.data (), 0);
+
+      mptr += size;
+      bc += size;
+
+      if (aschar && (bc >= bpr))
+	{
+	  /* end of row. Add it to the result and reset variables */
+	  *bptr = '\000';
+	  INDEX (i/bpr, bpr/size);
+	  Tcl_SetVar2 (interp, "data", index, buff, 0);
+
+	  /* See comments above on max_*_len */
+	  if (max_ascii_len == 0)
+	    max_ascii_len = strlen (buff);
+
+	  bc = 0;
+	  bptr = &buff[0];
+	}
+    }
+
+  /* return max_*_len so that column widths can be set */
+  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr, Tcl_NewIntObj (max_label_len + 1));
+  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr, Tcl_NewIntObj (max_val_len + 1));
+  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr, Tcl_NewIntObj (max_ascii_len + 1));
+  xfree (mbuf);
+  return TCL_OK;
+#undef INDEX
+}
+
+/* Return the integer type used to print a memory cell of SIZE bytes,
+   and store the matching print_scalar_formatted size letter in ASIZE. */
+
+static struct type *
+gdbtk_mem_cell_type (int size, int *asize)
+{
+  struct gdbarch *gdbarch = get_current_arch ();
+
+  switch (size)
+    {
+    case 2:
+      *asize = 'h';
+      return builtin_type (gdbarch)->builtin_int16;
+    case 4:
+      *asize = 'w';
+      return builtin_type (gdbarch)->builtin_int32;
+    case 8:
+      *asize = 'g';
+      return builtin_type (gdbarch)->builtin_int64;
+    case 1:
+    default:
+      *asize = 'b';
+      return builtin_type (gdbarch)->builtin_int8;
+    }
+}
+
+/* The memory cache.  All the memory the windows display is read
+   through here, so that the reads they issue during an update share
+   target round trips: memory is cached in MEM_CACHE_BLOCK sized
+   aligned blocks and consecutive missing blocks are fetched with a
+   single target read.  Reads spanning more than MEM_CACHE_MAX_BLOCKS
+   blocks bypass the cache.  The cache only lives until the inferior
+   resumes (see gdbtk_target_resumed in gdbtk-hooks.c); memory written
+   by gdb is dropped from it as the write is journaled.  */
+
+#define MEM_CACHE_BLOCK		64	/* Must be a power of 2. */
+#define MEM_CACHE_MAX_BLOCKS	16384
+
+struct mem_cache_block
+{
+  int len;			/* Number of readable bytes. */
+  gdb_byte data[MEM_CACHE_BLOCK];
+};
+
+static std::unordered_map<CORE_ADDR, mem_cache_block> mem_cache;
+static int mem_cache_enabled = 1;
+
+/* Statistics, since the last "gdb_mem_cache stats -reset". */
+static ULONGEST mem_cache_hits = 0;	/* Blocks found in the cache. */
+static ULONGEST mem_cache_misses = 0;	/* Blocks read from the target. */
+static ULONGEST mem_cache_reads = 0;	/* Target reads (round trips). */
+static ULONGEST mem_cache_bytes = 0;	/* Bytes read from the target. */
+
+void
+gdbtk_memory_cache_flush (void)
+{
+  mem_cache.clear ();
+}
+
+static void
+gdbtk_memory_cache_invalidate (CORE_ADDR addr, ULONGEST len)
+{
+  CORE_ADDR block;
+
+  if (mem_cache.empty ())
+    return;
+
+  for (block = addr & ~(CORE_ADDR) (MEM_CACHE_BLOCK - 1);
+       block < addr + len; block += MEM_CACHE_BLOCK)
+    {
+      mem_cache.erase (block);
+      if (block + MEM_CACHE_BLOCK < block)
+	break;			/* Wrapped around. */
+    }
+}
+
+/* Read the blocks from FIRST up to LAST, which are missing from the
+   cache, with a single target read and add them to the cache. */
+
+static void
+gdbtk_memory_cache_fill (CORE_ADDR first, CORE_ADDR last)
+{
+  ULONGEST size = last - first;
+  gdb_byte *buf = (gdb_byte *) xmalloc (size);
+  LONGEST rnum;
+  CORE_ADDR block;
+
+  /* Dispatch memory reads to the topmost target, not the flattened
+     current_target.  */
+  rnum = target_read (current_target.beneath, TARGET_OBJECT_MEMORY, NULL,
+		      buf, first, size);
+  mem_cache_reads++;
+  if (rnum < 0)
+    rnum = 0;
+  mem_cache_bytes += rnum;
+
+  if (mem_cache.size () + size / MEM_CACHE_BLOCK > MEM_CACHE_MAX_BLOCKS)
+    mem_cache.clear ();
+
+  for (block = first; block < last; block += MEM_CACHE_BLOCK)
+    {
+      mem_cache_block &b = mem_cache[block];
+      LONGEST avail = rnum - (LONGEST) (block - first);
+
+      b.len = (int) std::max ((LONGEST) 0,
+			      std::min (avail, (LONGEST) MEM_CACHE_BLOCK));
+      if (b.len > 0)
+	memcpy (b.data, buf + (block - first), b.len);
+      mem_cache_misses++;
+    }
+
+  xfree (buf);
+}
+
+/* Read LEN bytes of target memory at ADDR into BUF, through the
+   memory cache.  Like target_read, return the number of bytes read,
+   stopping at the first unreadable one, or -1 if none could be.  */
+
+static LONGEST
+gdbtk_read_memory (CORE_ADDR addr, gdb_byte *buf, LONGEST len)
+{
+  CORE_ADDR first, last, block, run;
+  LONGEST done, rnum;
+
+  if (!mem_cache_enabled || len <= 0
+      || addr + len < addr	/* Wraps around: don't bother. */
+      || len > (LONGEST) (MEM_CACHE_MAX_BLOCKS - 1) * MEM_CACHE_BLOCK)
+    {
+      mem_cache_reads++;
+      rnum = target_read (current_target.beneath, TARGET_OBJECT_MEMORY,
+			  NULL, buf, addr, len);
+      if (rnum > 0)
+	mem_cache_bytes += rnum;
+      return rnum;
+    }
+
+  first = addr & ~(CORE_ADDR) (MEM_CACHE_BLOCK - 1);
+  last = (addr + len + MEM_CACHE_BLOCK - 1) & ~(CORE_ADDR) (MEM_CACHE_BLOCK - 1);
+
+  /* Fetch each run of consecutive missing blocks in one go. */
+  for (block = first; block < last; )
+    {
+      if (mem_cache.count (block))
+	{
+	  mem_cache_hits++;
+	  block += MEM_CACHE_BLOCK;
+	  continue;
+	}
+      for (run = block; run < last && !mem_cache.count (run);
+	   run += MEM_CACHE_BLOCK)
+	;
+      gdbtk_memory_cache_fill (block, run);
+      block = run;
+    }
+
+  /* Now copy out of the cache. */
+  for (done = 0; done < len; )
+    {
+      CORE_ADDR a = addr + done;
+      auto it = mem_cache.find (a & ~(CORE_ADDR) (MEM_CACHE_BLOCK - 1));
+      int off = a & (MEM_CACHE_BLOCK - 1);
+      int n;
+
+      if (it == mem_cache.end () || it->second.len <= off)
+	break;
+      n = (int) std::min ((LONGEST) (it->second.len - off), len - done);
+      memcpy (buf + done, it->second.data + off, n);
+      done += n;
+      if (it->second.len < MEM_CACHE_BLOCK)
+	break;
+    }
+
+  if (done < len)
+    {
+      /* The aligned read may have failed for reasons that do not apply
+	 to the exact range (e.g. an unreadable page just before ADDR):
+	 ask the target for the rest directly. */
+      mem_cache_reads++;
+      rnum = target_read (current_target.beneath, TARGET_OBJECT_MEMORY,
+			  NULL, buf + done, addr + done, len - done);
+      if (rnum > 0)
+	{
+	  mem_cache_bytes += rnum;
+	  done += rnum;
+	}
+    }
+
+  return done > 0 ? done : -1;
+}
+
+/* This implements the Tcl command 'gdb_mem_cache', which controls the
+ * memory cache shared by the memory windows.
+ *
+ * Arguments:
+ *   gdb_mem_cache stats ?-reset?
+ *     Returns a list of name/value pairs: "hits" and "misses" count
+ *     cache blocks, "reads" counts target reads (round trips), "bytes"
+ *     counts bytes read from the target and "blocks" is the number of
+ *     blocks currently cached.  With -reset, the counters are cleared
+ *     after being returned.
+ *   gdb_mem_cache flush
+ *     Empties the cache.
+ *   gdb_mem_cache enable ?boolean?
+ *     Returns, or sets, whether the cache is used.
+ */
+
+static int
+gdb_mem_cache (ClientData clientData, Tcl_Interp *interp,
+	       int objc, Tcl_Obj *CONST objv[])
+{
+  int index;
+  static const char *commands[] = {"stats", "flush", "enable", NULL};
+  enum commands_enum { MEMCACHE_STATS, MEMCACHE_FLUSH, MEMCACHE_ENABLE };
+
+  if (objc < 2)
+    {
+      Tcl_WrongNumArgs (interp, 1, objv, "stats|flush|enable ?arg?");
+      return TCL_ERROR;
+    }
+
+  if (Tcl_GetIndexFromObj (interp, objv[1], commands, "option", 0,
+			   &index) != TCL_OK)
+    {
+      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+      return TCL_ERROR;
+    }
+
+  switch ((enum commands_enum) index)
+    {
+    case MEMCACHE_STATS:
+      if (objc > 3 || (objc == 3
+		       && strcmp (Tcl_GetString (objv[2]), "-reset") != 0))
+	{
+	  Tcl_WrongNumArgs (interp, 2, objv, "?-reset?");
+	  return TCL_ERROR;
+	}
+      Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("hits", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (mem_cache_hits));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("misses", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (mem_cache_misses));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("reads", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (mem_cache_reads));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("bytes", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (mem_cache_bytes));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("blocks", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (mem_cache.size ()));
+      if (objc == 3)
+	mem_cache_hits = mem_cache_misses = mem_cache_reads
+	  = mem_cache_bytes = 0;
+      break;
+
+    case MEMCACHE_FLUSH:
+      gdbtk_memory_cache_flush ();
+      break;
+
+    case MEMCACHE_ENABLE:
+      if (objc > 3)
+	{
+	  Tcl_WrongNumArgs (interp, 2, objv, "?boolean?");
+	  return TCL_ERROR;
+	}
+      if (objc == 3)
+	{
+	  if (Tcl_GetBooleanFromObj (interp, objv[2], &mem_cache_enabled)
+	      != TCL_OK)
+	    {
+	      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	      return TCL_ERROR;
+	    }
+	  if (!mem_cache_enabled)
+	    gdbtk_memory_cache_flush ();
+	}
+      Tcl_SetBooleanObj (result_ptr->obj_ptr, mem_cache_enabled);
+      break;
+    }
+
+  return TCL_OK;
+}
+
+/* This implements the Tcl command 'gdb_fetch_mem', which reads
+ * a block of memory for the memory window in raw form.
+ *
+ * Unlike gdb_update_mem, nothing is formatted here: the bytes are
+ * handed back in a single byte array and the table renders its
+ * visible cells on demand through gdb_format_mem.
+ *
+ * Arguments:
+ *   gdb_fetch_mem addr nbytes
+ *
+ *   addr:   address of data to read
+ *   nbytes: the number of bytes to read
+ *
+ * Return:
+ *   A byte array holding the bytes actually read. It is shorter than
+ *   nbytes if the target could only read part of the block.
+ */
+
+static int
+gdb_fetch_mem (ClientData clientData, Tcl_Interp *interp,
+	       int objc, Tcl_Obj *CONST objv[])
+{
+  CORE_ADDR addr;
+  int nbytes;
+  LONGEST rnum;
+  gdb_byte *mbuf;
+
+  if (objc != 3)
+    {
+      Tcl_WrongNumArgs (interp, 1, objv, "addr nbytes");
+      return TCL_ERROR;
+    }
+
+  addr = string_to_core_addr (Tcl_GetStringFromObj (objv[1], NULL));
+
+  if (Tcl_GetIntFromObj (interp, objv[2], &nbytes) != TCL_OK)
+    return TCL_ERROR;
+  else if (nbytes <= 0)
+    {
+      gdbtk_set_result (interp, "Invalid number of bytes, must be > 0");
+      return TCL_ERROR;
+    }
+
+  /* Read straight into the result object: no intermediate copy. */
+  mbuf = Tcl_SetByteArrayLength (result_ptr->obj_ptr, nbytes);
+
+  rnum = gdbtk_read_memory (addr, mbuf, nbytes);
+  if (rnum <= 0)
+    {
+      gdbtk_set_result (interp, "Unable to read memory.");
+      return TCL_ERROR;
+    }
+
+  Tcl_SetByteArrayLength (result_ptr->obj_ptr, (int) rnum);
+  return TCL_OK;
+}
+
+/* This implements the Tcl command 'gdb_format_mem', which renders
+ * a single memory window cell out of a byte array returned by
+ * gdb_fetch_mem.  It is meant to be called from the table's -command
+ * so that only visible cells are ever formatted.
+ *
+ * Arguments:
+ *   gdb_format_mem data addr descriptor row col
+ *
+ *   data:       byte array holding the memory, as read by gdb_fetch_mem
+ *   addr:       address of the first byte of data
+ *   descriptor: a list {format size bytes_per_row ?ascii_char?}, with
+ *               the same meaning as the gdb_update_mem arguments
+ *   row, col:   the cell to render.  Column -1 is the address label
+ *               and column bytes_per_row/size is the ASCII dump (only
+ *               when ascii_char is given).
+ *
+ * Return:
+ *   The text of the cell.  Cells past the end of the data read are
+ *   shown as "N/A", and as 'X' in the ASCII dump, like gdb_update_mem
+ *   does.
+ */
+
+static int
+gdb_format_mem (ClientData clientData, Tcl_Interp *interp,
+		int objc, Tcl_Obj *CONST objv[])
+{
+  CORE_ADDR addr;
+  int len, desc_objc, size, asize, bpr, row, col, offset, i;
+  char format, aschar;
+  gdb_byte *mbuf;
+  Tcl_Obj **desc_objv;
+  string_file stb;
+
+  if (objc != 6)
+    {
+      Tcl_WrongNumArgs (interp, 1, objv, "data addr descriptor row col");
+      return TCL_ERROR;
+    }
+
+  mbuf = Tcl_GetByteArrayFromObj (objv[1], &len);
+  addr = string_to_core_addr (Tcl_GetStringFromObj (objv[2], NULL));
+
+  if (Tcl_ListObjGetElements (interp, objv[3], &desc_objc, &desc_objv)
+      != TCL_OK)
+    return TCL_ERROR;
+  if (desc_objc < 3 || desc_objc > 4)
+    {
+      gdbtk_set_result (interp,
+			"descriptor must be {format size bytes_per_row ?ascii_char?}");
+      return TCL_ERROR;
+    }
+
+  format = *(Tcl_GetStringFromObj (desc_objv[0], NULL));
+  if (Tcl_GetIntFromObj (interp, desc_objv[1], &size) != TCL_OK
+      || Tcl_GetIntFromObj (interp, desc_objv[2], &bpr) != TCL_OK)
+    return TCL_ERROR;
+  if (size <= 0 || bpr <= 0)
+    {
+      gdbtk_set_result (interp, "Invalid size or bytes per row, must be > 0");
+      return TCL_ERROR;
+    }
+  aschar = desc_objc == 4 ? *(Tcl_GetStringFromObj (desc_objv[3], NULL)) : 0;
+
+  if (Tcl_GetIntFromObj (interp, objv[4], &row) != TCL_OK
+      || Tcl_GetIntFromObj (interp, objv[5], &col) != TCL_OK)
+    return TCL_ERROR;
+  if (row < 0 || col < -1)
+    return TCL_OK;
+
+  offset = row * bpr;
+
+  if (col == -1)
+    {
+      /* Address label */
+      Tcl_SetStringObj (result_ptr->obj_ptr,
+			core_addr_to_string (addr + offset), -1);
+    }
+  else if (col < bpr / size)
+    {
+      offset += col * size;
+      if (offset + size > len)
+	stb.puts ("N/A");
+      else
+	{
+	  struct value_print_options opts;
+	  struct type *val_type = gdbtk_mem_cell_type (size, &asize);
+
+	  get_formatted_print_options (&opts, format);
+	  print_scalar_formatted (mbuf + offset, val_type, &opts, asize, &stb);
+	}
+      Tcl_SetStringObj (result_ptr->obj_ptr, stb.data (), stb.size ());
+    }
+  else if (col == bpr / size && aschar)
+    {
+      /* ASCII dump of the row */
+      for (i = offset; i < offset + bpr; i++)
+	{
+	  if (i >= len)
+	    stb.putc ('X');
+	  else if (isprint (mbuf[i]))
+	    stb.putc (mbuf[i]);
+	  else
+	    stb.putc (aschar);
+	}
+      Tcl_SetStringObj (result_ptr->obj_ptr, stb.data (), stb.size ());
+    }
+
+  return TCL_OK;
+}
+
+
+/* This implements the Tcl command 'gdb_patch_mem', which re-reads
+ * part of a block of memory previously fetched by gdb_fetch_mem.
+ *
+ * Arguments:
+ *   gdb_patch_mem data addr offset nbytes
+ *
+ *   data:   byte array holding the memory at addr
+ *   addr:   address of the first byte of data
+ *   offset: offset in data of the bytes to re-read
+ *   nbytes: the number of bytes to re-read
+ *
+ * Return:
+ *   A copy of data with the re-read bytes replaced.  If the target
+ *   read fails or is partial, the copy is truncated at the first byte
+ *   that could not be read, as gdb_fetch_mem would do.
+ */
 
 static int
-gdb_entry_point (ClientData clientData, Tcl_Interp *interp,
-		 int objc, Tcl_Obj *CONST objv[])
+gdb_patch_mem (ClientData clientData, Tcl_Interp *interp,
+	       int objc, Tcl_Obj *CONST objv[])
 {
-  char *addrstr;
+  CORE_ADDR addr;
+  int len, offset, nbytes;
+  LONGEST rnum;
+  gdb_byte *old, *mbuf;
 
-  /* If we have not yet loaded an exec file, then we have no
-     entry point, so return an empty string.*/
-  if ((int) current_target.to_stratum > (int) dummy_stratum)
+  if (objc != 5)
     {
-      addrstr = (char *)core_addr_to_string (entry_point_address ());
-      Tcl_SetStringObj (result_ptr->obj_ptr, addrstr, -1);
+      Tcl_WrongNumArgs (interp, 1, objv, "data addr offset nbytes");
+      return TCL_ERROR;
     }
-  else
-    Tcl_SetStringObj (result_ptr->obj_ptr, "", -1);
 
-  return TCL_OK;
-}
+  old = Tcl_GetByteArrayFromObj (objv[1], &len);
+  addr = string_to_core_addr (Tcl_GetStringFromObj (objv[2], NULL));
+  if (Tcl_GetIntFromObj (interp, objv[3], &offset) != TCL_OK
+      || Tcl_GetIntFromObj (interp, objv[4], &nbytes) != TCL_OK)
+    return TCL_ERROR;
+  if (offset < 0 || nbytes <= 0)
+    {
+      gdbtk_set_result (interp, "Invalid offset or number of bytes");
+      return TCL_ERROR;
+    }
 
-/* Covert hex to binary. Stolen from remote.c,
-   but added error handling */
-static int
-fromhex (int a)
-{
-  if (a >= '0' && a <= '9')
-    return a - '0';
-  else if (a >= 'a' && a <= 'f')
-    return a - 'a' + 10;
-  else if (a >= 'A' && a <= 'F')
-    return a - 'A' + 10;
+  /* A hole before OFFSET cannot be filled: read from the end of the
+     data we have instead. */
+  if (offset > len)
+    {
+      nbytes += offset - len;
+      offset = len;
+    }
 
-  return -1;
+  mbuf = Tcl_SetByteArrayLength (result_ptr->obj_ptr,
+				 std::max (len, offset + nbytes));
+  memcpy (mbuf, old, len);
+  rnum = gdbtk_read_memory (addr + offset, mbuf + offset, nbytes);
+  if (rnum < nbytes)
+    Tcl_SetByteArrayLength (result_ptr->obj_ptr,
+			    offset + (int) std::max (rnum, (LONGEST) 0));
+  return TCL_OK;
 }
 
+/* This implements the Tcl command 'gdb_compare_mem', which tells the
+ * memory window which of its cells changed between two snapshots.
+ *
+ * Arguments:
+ *   gdb_compare_mem old new size bytes_per_row ?offset length?
+ *
+ *   old, new: byte arrays holding the memory at the same address
+ *   size:     size of each cell: 1, 2, 4 or 8 bytes
+ *   bytes_per_row: bytes per row
+ *   offset, length: compare only the cells holding these bytes
+ *
+ * Return:
+ *   A flat list of {row col} pairs, one for each data cell whose bytes
+ *   differ.  A cell that is present in only one of the snapshots is
+ *   considered changed.
+ */
+
 static int
-hex2bin (const char *hex, char *bin, int count)
+gdb_compare_mem (ClientData clientData, Tcl_Interp *interp,
+		 int objc, Tcl_Obj *CONST objv[])
 {
-  int i, m, n;
-  int incr = 2;
+  gdb_byte *old, *cur;
+  int old_len, cur_len, size, bpr, i, j, common, end;
+  int offset = 0, length = -1;
 
+  if (objc != 5 && objc != 7)
+    {
+      Tcl_WrongNumArgs (interp, 1, objv,
+			"old new size bytes_per_row ?offset length?");
+      return TCL_ERROR;
+    }
 
-  if (gdbarch_byte_order (get_current_arch ()) == BFD_ENDIAN_LITTLE)
+  old = Tcl_GetByteArrayFromObj (objv[1], &old_len);
+  cur = Tcl_GetByteArrayFromObj (objv[2], &cur_len);
+  if (Tcl_GetIntFromObj (interp, objv[3], &size) != TCL_OK
+      || Tcl_GetIntFromObj (interp, objv[4], &bpr) != TCL_OK)
+    return TCL_ERROR;
+  if (size <= 0 || bpr <= 0)
     {
-      /* need to read string in reverse */
-      hex += count - 2;
-      incr = -2;
+      gdbtk_set_result (interp, "Invalid size or bytes per row, must be > 0");
+      return TCL_ERROR;
+    }
+  if (objc == 7)
+    {
+      if (Tcl_GetIntFromObj (interp, objv[5], &offset) != TCL_OK
+	  || Tcl_GetIntFromObj (interp, objv[6], &length) != TCL_OK)
+	return TCL_ERROR;
+      if (offset < 0 || length < 0)
+	{
+	  gdbtk_set_result (interp, "Invalid offset or length, must be >= 0");
+	  return TCL_ERROR;
+	}
     }
 
-  for (i = 0; i < count; i += 2)
+  Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
+
+  end = std::max (old_len, cur_len);
+  if (length >= 0 && length < end - offset)
+    end = offset + length;
+  common = std::min (std::min (old_len, cur_len), end);
+  i = offset - offset % size;
+  while (i < end)
     {
-      if (hex[0] == 0 || hex[1] == 0)
+      if (i < common)
 	{
-	  /* Hex string is short, or of uneven length.
-	     Return the count that has been converted so far. */
-	  return i;
+	  /* Skip identical bytes quickly, then back up to the start of
+	     the cell holding the first difference. */
+	  j = i;
+	  while (j < common && old[j] == cur[j])
+	    j++;
+	  if (j == end)
+	    break;
+	  i = j - j % size;
 	}
-      m = fromhex (hex[0]);
-      n = fromhex (hex[1]);
-      if (m == -1 || n == -1)
-	return -1;
-      *bin++ = m * 16 + n;
-      hex += incr;
+
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewIntObj (i / bpr));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewIntObj ((i % bpr) / size));
+      i += size;
     }
 
-  return i;
+  return TCL_OK;
 }
 
-/* This implements the Tcl command 'gdb_set_mem', which
- * sets some chunk of memory.
+/* The memory change journal.  The memory_changed observer (see
+   gdbtk_memory_changed in gdbtk-hooks.c) and gdb_set_mem record here
+   every range of target memory that gdb writes, so that the memory
+   windows can re-read only what changed.  Entries are numbered by a
+   generation count and only the last MEM_JOURNAL_SIZE ones are kept:
+   a window that fell further behind is told that everything changed.  */
+
+#define MEM_JOURNAL_SIZE 256
+
+struct mem_journal_entry
+{
+  CORE_ADDR addr;
+  ULONGEST len;
+};
+
+static struct mem_journal_entry mem_journal[MEM_JOURNAL_SIZE];
+static ULONGEST mem_journal_generation = 0;
+
+void
+gdbtk_memory_journal_add (CORE_ADDR addr, ULONGEST len)
+{
+  struct mem_journal_entry *e;
+
+  if (len == 0)
+    return;
+
+  gdbtk_memory_cache_invalidate (addr, len);
+  gdbtk_disassembly_cache_invalidate (addr, len);
+
+  e = &mem_journal[mem_journal_generation % MEM_JOURNAL_SIZE];
+  e->addr = addr;
+  e->len = len;
+  mem_journal_generation++;
+}
+
+/* Return the end of the LEN bytes at ADDR, or the highest address if
+   they reach the top of the address space.  */
+
+static CORE_ADDR
+mem_journal_end (CORE_ADDR addr, ULONGEST len)
+{
+  CORE_ADDR end = addr + len;
+
+  return end < addr ? ~(CORE_ADDR) 0 : end;
+}
+
+/* This implements the Tcl command 'gdb_memory_changes', which
+ * returns the parts of a block of memory written by gdb since a given
+ * journal generation.
  *
  * Arguments:
- *   gdb_set_mem addr hexstr len
+ *   gdb_memory_changes generation addr nbytes
  *
- *   addr:   address of data to set
- *   hexstr: ascii string of data to set
- *   len:    number of bytes of data to set
+ *   generation: the journal generation returned by the previous call,
+ *               or -1 to just get the current generation
+ *   addr:       address of the block of memory
+ *   nbytes:     size of the block of memory
+ *
+ * Return:
+ *   A two element list: the current journal generation and a sorted
+ *   flat list of non-overlapping {offset length} pairs, relative to
+ *   addr, covering the bytes that may have changed.
  */
+
 static int
-gdb_set_mem (ClientData clientData, Tcl_Interp *interp,
-	     int objc, Tcl_Obj *CONST objv[])
+gdb_memory_changes (ClientData clientData, Tcl_Interp *interp,
+		    int objc, Tcl_Obj *CONST objv[])
 {
+  Tcl_WideInt wgen;
   CORE_ADDR addr;
-  gdb_byte buf[128];
-  char *hexstr;
-  int len, size;
+  int nbytes;
+  ULONGEST gen;
+  std::vector<std::pair<ULONGEST, ULONGEST>> ranges;
+  Tcl_Obj *list;
 
   if (objc != 4)
     {
-      Tcl_WrongNumArgs (interp, 1, objv, "addr hex_data len");
+      Tcl_WrongNumArgs (interp, 1, objv, "generation addr nbytes");
       return TCL_ERROR;
     }
 
-  /* Address to write */
-  addr = string_to_core_addr (Tcl_GetStringFromObj (objv[1], NULL));
-
-  /* String value to write: it's in hex */
-  hexstr = Tcl_GetStringFromObj (objv[2], NULL);
-  if (hexstr == NULL)
+  if (Tcl_GetWideIntFromObj (interp, objv[1], &wgen) != TCL_OK)
     return TCL_ERROR;
-
-  /* Length of buf */
-  if (Tcl_GetIntFromObj (interp, objv[3], &len) != TCL_OK)
+  addr = string_to_core_addr (Tcl_GetStringFromObj (objv[2], NULL));
+  if (Tcl_GetIntFromObj (interp, objv[3], &nbytes) != TCL_OK)
     return TCL_ERROR;
 
-  /* Convert hexstr to binary and write */
-  if (hexstr[0] == '0' && hexstr[1] == 'x')
-    hexstr += 2;
-  size = hex2bin (hexstr, (char *) buf, strlen (hexstr));
-  if (size < 0)
+  list = Tcl_NewListObj (0, NULL);
+
+  if (wgen >= 0 && nbytes > 0)
     {
-      /* Error in input */
-      gdbtk_set_result (interp, "Invalid hexadecimal input: \"0x%s\"", hexstr);
-      return TCL_ERROR;
+      gen = (ULONGEST) wgen;
+      if (gen > mem_journal_generation
+	  || mem_journal_generation - gen > MEM_JOURNAL_SIZE)
+	{
+	  /* Lost track: everything may have changed. */
+	  ranges.emplace_back (0, nbytes);
+	}
+      else
+	{
+	  for (; gen < mem_journal_generation; gen++)
+	    {
+	      struct mem_journal_entry *e
+		= &mem_journal[gen % MEM_JOURNAL_SIZE];
+	      CORE_ADDR start = std::max (e->addr, addr);
+	      CORE_ADDR end = std::min (mem_journal_end (e->addr, e->len),
+					mem_journal_end (addr, nbytes));
+
+	      if (start < end)
+		ranges.emplace_back (start - addr, end - addr);
+	    }
+	}
+
+      /* Sort and merge overlapping or adjacent ranges. */
+      std::sort (ranges.begin (), ranges.end ());
+      for (size_t i = 0; i < ranges.size (); )
+	{
+	  ULONGEST start = ranges[i].first;
+	  ULONGEST end = ranges[i].second;
+
+	  for (i++; i < ranges.size () && ranges[i].first <= end; i++)
+	    end = std::max (end, ranges[i].second);
+	  Tcl_ListObjAppendElement (NULL, list, Tcl_NewWideIntObj (start));
+	  Tcl_ListObjAppendElement (NULL, list,
+				    Tcl_NewWideIntObj (end - start));
+	}
     }
 
-  target_write_memory (addr, buf, len);
+  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+			    Tcl_NewWideIntObj (mem_journal_generation));
+  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr, list);
   return TCL_OK;
 }
 
-/* This implements the Tcl command 'gdb_update_mem', which
- * updates a block of memory in the memory window
- *
- * Arguments:
- *   gdb_update_mem data addr form size nbytes bpr aschar
- *
- *   1 data: variable that holds table's data
- *   2 addr: address of data to dump
- *   3 mform: a char indicating format
- *   4 size: size of each element; 1,2,4, or 8 bytes
- *   5 nbytes: the number of bytes to read
- *   6 bpr: bytes per row
- *   7 aschar: if present, an ASCII dump of the row is included.  ASCHAR
- *              used for unprintable characters.
- *
- * Return:
- * a list of three integers: {border_col_width data_col_width ascii_col_width}
- * which can be used to set the table's column widths. */
+/* Source buffers.  The source windows (gdb_loadfile) and the mixed
+   source/assembly views (gdbtk_load_source) get the text of a source
+   file from here.  A file is read in one go, converted from the system
+   encoding to UTF-8 only if it contains non-ASCII bytes, and indexed by
+   a single scan for newlines.  The most recently used buffers, together
+   with the executable lines gdb_loadfile computed for them, are kept as
+   long as their file doesn't change and they fit in SOURCE_CACHE_LIMIT
+   bytes, so showing a file again neither reads it nor walks its
+   linetable.  */
 
-static int
-gdb_update_mem (ClientData clientData, Tcl_Interp *interp,
-		int objc, Tcl_Obj *CONST objv[])
+#define SOURCE_CACHE_LIMIT (16 * 1024 * 1024)
+
+/* The number of lines gdb_loadfile inserts with each widget command. */
+#define SOURCE_INSERT_LINES 1000
+
+/* Most recently used first.  */
+static std::vector<std::shared_ptr<source_buffer> > source_buffers;
+static size_t source_cache_limit = SOURCE_CACHE_LIMIT;
+
+/* Statistics, since the last "gdb_source_cache stats -reset". */
+static LONGEST source_cache_hits;
+static LONGEST source_cache_misses;
+static LONGEST source_cache_walks;
+
+/* Copy LEN bytes of SRC to DEST, turning "\r\n" into "\n".  */
+
+static void
+gdbtk_append_without_cr (std::string *dest, const char *src, size_t len)
 {
-  long dummy;
-  char index[20];
-  CORE_ADDR addr;
-  int nbytes, rnum, bpr;
-  int size, asize, i, j, bc;
-  int max_ascii_len, max_val_len, max_label_len;
-  char format, aschar;
-  char *data, *tmp;
-  char buff[128], *bptr;
-  gdb_byte *mbuf, *mptr, *cptr;
-  string_file stb;
-  struct type *val_type;
+  const char *end = src + len;
+  const char *cr;
 
-  if (objc < 7 || objc > 8)
+  dest->reserve (dest->size () + len);
+  while ((cr = (const char *) memchr (src, '\r', end - src)) != NULL)
     {
-      Tcl_WrongNumArgs (interp, 1, objv, "data addr format size bytes bytes_per_row ?ascii_char?");
-      return TCL_ERROR;
+      if (cr + 1 < end && cr[1] == '\n')
+	{
+	  dest->append (src, cr - src);
+	  src = cr + 1;
+	}
+      else
+	{
+	  dest->append (src, cr + 1 - src);
+	  src = cr + 1;
+	}
     }
+  dest->append (src, end - src);
+}
 
-  /* Get table data and link to a local variable */
-  data = Tcl_GetStringFromObj (objv[1], NULL);
-  if (data == NULL)
+/* Read FULLNAME into a new source buffer.  Returns NULL, with errno
+   set, if the file can't be read.  */
+
+static source_buffer *
+gdbtk_read_source_buffer (const char *fullname, int fd, struct stat *st)
+{
+  source_buffer *buffer = new source_buffer ();
+  const char *data, *p, *end;
+  size_t size = st->st_size;
+  int non_ascii = 0, crlf = 0;
+
+  buffer->fullname = fullname;
+  buffer->mtime = st->st_mtime;
+  buffer->file_size = st->st_size;
+
+  if (size > 0)
     {
-      gdbtk_set_result (interp, "could not get data variable");
-      return TCL_ERROR;
+      size_t done = 0;
+
+      buffer->text.resize (size);
+      while (done < size)
+	{
+	  ssize_t n = read (fd, &buffer->text[done], size - done);
+
+	  if (n < 0)
+	    {
+	      delete buffer;
+	      return NULL;
+	    }
+	  if (n == 0)
+	    break;
+	  done += n;
+	}
+      buffer->text.resize (done);
+      size = done;
     }
+  data = buffer->text.data ();
+  end = data + size;
 
-  if (Tcl_UpVar (interp, "1", data, "data", 0) != TCL_OK)
+  /* Like the old line by line reader, assume that either all the lines
+     of the file have DOS endings or none do, and look at the first.  */
+  p = size > 0 ? (const char *) memchr (data, '\n', size) : NULL;
+  if (p != NULL && p > data && p[-1] == '\r')
+    crlf = 1;
+
+  for (p = data; p < end; p++)
+    if (*p & 0x80)
+      {
+	non_ascii = 1;
+	break;
+      }
+
+  if (non_ascii)
     {
-      gdbtk_set_result (interp, "could not link table data");
-      return TCL_ERROR;
+      /* Convert from system encoding to utf-8. This has the side effect
+	 to map invalid characters in source encoding to a default value. */
+      Tcl_DString ds;
+      std::string text;
+
+      Tcl_ExternalToUtfDString (NULL, data, size, &ds);
+      if (crlf)
+	gdbtk_append_without_cr (&text, Tcl_DStringValue (&ds),
+				 Tcl_DStringLength (&ds));
+      else
+	text.assign (Tcl_DStringValue (&ds), Tcl_DStringLength (&ds));
+      Tcl_DStringFree (&ds);
+      buffer->text.swap (text);
     }
+  else if (crlf)
+    {
+      std::string text;
 
-  if (Tcl_GetIntFromObj (interp, objv[4], &size) != TCL_OK)
-    return TCL_ERROR;
-  else if (size <= 0)
+      gdbtk_append_without_cr (&text, data, size);
+      buffer->text.swap (text);
+    }
+
+  /* Index the lines.  */
+  size = buffer->text.size ();
+  buffer->lines.reserve (size / 32 + 2);
+  buffer->lines.push_back (0);
+  data = buffer->text.data ();
+  p = data;
+  end = data + size;
+  while (p < end)
+    {
+      const char *nl = (const char *) memchr (p, '\n', end - p);
+
+      p = nl != NULL ? nl + 1 : end;
+      buffer->lines.push_back (p - data);
+    }
+
+  buffer->bytes = sizeof (*buffer) + buffer->fullname.size () + size
+    + buffer->lines.size () * sizeof (size_t);
+  return buffer;
+}
+
+/* Return the memory used by the cached source buffers.  */
+
+static size_t
+gdbtk_source_cache_bytes (void)
+{
+  size_t bytes = 0;
+  size_t i;
+
+  for (i = 0; i < source_buffers.size (); i++)
+    bytes += source_buffers[i]->bytes;
+  return bytes;
+}
+
+/* Drop least recently used buffers until the cache fits its limit.
+   The most recently used one is always kept.  Buffers still in use
+   elsewhere go away when their last user lets go of them.  */
+
+static void
+gdbtk_source_cache_trim (void)
+{
+  size_t bytes = gdbtk_source_cache_bytes ();
+
+  while (source_buffers.size () > 1 && bytes > source_cache_limit)
+    {
+      bytes -= source_buffers.back ()->bytes;
+      source_buffers.pop_back ();
+    }
+}
+
+/* Forget the executable lines computed from the symtabs of OBJFILE,
+   which is going away.  */
+
+void
+gdbtk_source_cache_forget (struct objfile *objfile)
+{
+  size_t i;
+
+  for (i = 0; i < source_buffers.size (); i++)
     {
-      gdbtk_set_result (interp, "Invalid size, must be > 0");
-      return TCL_ERROR;
+      source_buffer *buffer = source_buffers[i].get ();
+
+      if (buffer->executable_objfile == objfile)
+	{
+	  buffer->bytes -= buffer->executable.size () / 8;
+	  std::vector<bool> ().swap (buffer->executable);
+	  buffer->executable_symtab = NULL;
+	  buffer->executable_objfile = NULL;
+	}
     }
+}
 
-  if (Tcl_GetIntFromObj (interp, objv[5], &nbytes) != TCL_OK)
-    return TCL_ERROR;
-  else if (nbytes <= 0)
+/* Return the source buffer for the file FULLNAME, reading it unless an
+   up to date copy is cached.  Returns an empty pointer, with errno
+   set, if the file can't be read.  */
+
+static std::shared_ptr<source_buffer>
+gdbtk_get_source_buffer (const char *fullname)
+{
+  std::shared_ptr<source_buffer> buffer;
+  struct stat st;
+  size_t i;
+  int fd;
+
+  fd = open (fullname, O_RDONLY | O_BINARY);
+  if (fd < 0)
+    return buffer;
+
+  if (fstat (fd, &st) < 0)
     {
-      gdbtk_set_result (interp, "Invalid number of bytes, must be > 0");
-      return TCL_ERROR;
+      close (fd);
+      return buffer;
     }
 
-  if (Tcl_GetIntFromObj (interp, objv[6], &bpr) != TCL_OK)
-    return TCL_ERROR;
-  else if (bpr <= 0)
+  for (i = 0; i < source_buffers.size (); i++)
     {
-      gdbtk_set_result (interp, "Invalid bytes per row, must be > 0");
-      return TCL_ERROR;
+      if (source_buffers[i]->fullname == fullname)
+	{
+	  buffer = source_buffers[i];
+	  source_buffers.erase (source_buffers.begin () + i);
+	  if (buffer->mtime != st.st_mtime || buffer->file_size != st.st_size)
+	    buffer.reset ();
+	  break;
+	}
     }
 
-  tmp = Tcl_GetStringFromObj (objv[2], NULL);
-  if (tmp == NULL)
+  if (buffer)
+    source_cache_hits++;
+  else
     {
-      gdbtk_set_result (interp, "could not get address");
-      return TCL_ERROR;
+      source_buffer *b = gdbtk_read_source_buffer (fullname, fd, &st);
+
+      if (b != NULL)
+	buffer.reset (b);
+      source_cache_misses++;
     }
-  addr = string_to_core_addr (tmp);
+  close (fd);
 
-  format = *(Tcl_GetStringFromObj (objv[3], NULL));
-  mbuf = (gdb_byte *) xmalloc (nbytes + 32);
-  if (!mbuf)
+  if (buffer)
     {
-      gdbtk_set_result (interp, "Out of memory.");
-      return TCL_ERROR;
+      source_buffers.insert (source_buffers.begin (), buffer);
+      gdbtk_source_cache_trim ();
     }
 
-  memset (mbuf, 0, nbytes + 32);
-  mptr = cptr = mbuf;
+  return buffer;
+}
 
-  /* Dispatch memory reads to the topmost target, not the flattened
-     current_target.  */
-  rnum = target_read (current_target.beneath, TARGET_OBJECT_MEMORY, NULL,
-		      mbuf, addr, nbytes);
-  if (rnum <= 0)
-    {
-      gdbtk_set_result (interp, "Unable to read memory.");
-      return TCL_ERROR;
-    }
+/* Return the modification time of OBJFILE, or of the executable if
+   OBJFILE is NULL, or 0 if it is not known.  */
 
-  if (objc == 8)
-    aschar = *(Tcl_GetStringFromObj (objv[7], NULL));
-  else
-    aschar = 0;
+static long
+gdbtk_objfile_mtime (struct objfile *objfile)
+{
+  if (objfile != NULL && objfile->obfd != NULL)
+    return bfd_get_mtime (objfile->obfd);
+  else if (exec_bfd)
+    return bfd_get_mtime (exec_bfd);
+  return 0;
+}
 
-  switch (size)
+/* Return a vector where element N is true for each line N of SOURCE
+   which has code in SYMTAB.  The linetable is only walked when SOURCE
+   has not been shown with this SYMTAB, or the objfile has changed,
+   since the result is kept with the buffer.  */
+
+static const std::vector<bool> &
+gdbtk_executable_lines (source_buffer *source, struct symtab *symtab)
+{
+  struct objfile *objfile = SYMTAB_OBJFILE (symtab);
+  long mtime = gdbtk_objfile_mtime (objfile);
+  size_t nlines = source->lines.size () - 1;
+  struct linetable_entry *le;
+  int ln;
+
+  if (source->executable_symtab == symtab
+      && source->executable_objfile == objfile
+      && source->executable_mtime == mtime
+      && source->executable.size () == nlines + 1)
+    return source->executable;
+
+  source_cache_walks++;
+  source->bytes -= source->executable.size () / 8;
+  source->executable.assign (nlines + 1, false);
+  source->executable_symtab = symtab;
+  source->executable_objfile = objfile;
+  source->executable_mtime = mtime;
+  source->bytes += source->executable.size () / 8;
+
+  if (SYMTAB_LINETABLE (symtab) && SYMTAB_LINETABLE (symtab)->nitems)
     {
-    case 1:
-      val_type = builtin_type (get_current_arch ())->builtin_int8;
-      asize = 'b';
-      break;
-    case 2:
-      val_type = builtin_type (get_current_arch ())->builtin_int16;
-      asize = 'h';
-      break;
-    case 4:
-      val_type = builtin_type (get_current_arch ())->builtin_int32;
-      asize = 'w';
-      break;
-    case 8:
-      val_type = builtin_type (get_current_arch ())->builtin_int64;
-      asize = 'g';
-      break;
-    default:
-      val_type = builtin_type (get_current_arch ())->builtin_int8;
-      asize = 'b';
+      le = SYMTAB_LINETABLE (symtab)->item;
+      for (ln = SYMTAB_LINETABLE (symtab)->nitems; ln > 0; ln--, le++)
+	if (le->line > 0 && (size_t) le->line <= nlines)
+	  source->executable[le->line] = true;
     }
 
-  bc = 0;			/* count of bytes in a row */
-  bptr = &buff[0];		/* pointer for ascii dump */
+  gdbtk_source_cache_trim ();
+  return source->executable;
+}
 
-  /* A little macro to do column indices. As a rule, given the current
-     byte, i, of a total nbytes and the bytes per row, bpr, and the size of
-     each cell, size, the row and column will be given by:
+/* This implements the Tcl command 'gdb_source_cache', which controls
+ * the cache of source buffers shared by the source windows.
+ *
+ * Arguments:
+ *   gdb_source_cache stats ?-reset?
+ *     Returns a list of name/value pairs: "hits" and "misses" count
+ *     requests for a file which was, or wasn't, cached, "walks"
+ *     counts linetable walks, "files" is the number of files cached
+ *     and "bytes" the memory they use.  With -reset, the counters are
+ *     cleared after being returned.
+ *   gdb_source_cache flush
+ *     Empties the cache.
+ *   gdb_source_cache limit ?bytes?
+ *     Returns, or sets, the most memory the cache may use.
+ */
 
-     row = i/bpr
-     col = (i%bpr)/size
-  */
-#define INDEX(row,col) sprintf (index, "%d,%d",(row),(col))
+static int
+gdb_source_cache (ClientData clientData, Tcl_Interp *interp,
+		  int objc, Tcl_Obj *CONST objv[])
+{
+  int index;
+  static const char *commands[] = {"stats", "flush", "limit", NULL};
+  enum commands_enum { SRCCACHE_STATS, SRCCACHE_FLUSH, SRCCACHE_LIMIT };
 
-  /* Fill in address labels */
-  max_label_len = 0;
-  for (i = 0; i < nbytes; i += bpr)
+  if (objc < 2)
     {
-      char s[130];
-      sprintf (s, "%s", core_addr_to_string (addr + i));
-      INDEX ((int) i/bpr, -1);
-      Tcl_SetVar2 (interp, "data", index, s, 0);
-
-      /* The tcl code in MemWin::update_addr used to track the size
-	 of each cell. I don't see how these could change for any given
-	 update, so we don't loop over all cells. We just note the first
-	 size. */
-      if (max_label_len == 0)
-	max_label_len = strlen (s);
+      Tcl_WrongNumArgs (interp, 1, objv, "stats|flush|limit ?arg?");
+      return TCL_ERROR;
     }
 
-  /* Fill in memory */
-  max_val_len   = 0;		/* Ditto the above comments about max_label_len */
-  max_ascii_len = 0;
-  for (i = 0; i < nbytes; i += size)
+  if (Tcl_GetIndexFromObj (interp, objv[1], commands, "option", 0,
+			   &index) != TCL_OK)
     {
-      stb.clear ();
-      INDEX ((int) i/bpr, (int) (i%bpr)/size);
+      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+      return TCL_ERROR;
+    }
 
-      if (i >= rnum)
+  switch ((enum commands_enum) index)
+    {
+    case SRCCACHE_STATS:
+      if (objc > 3 || (objc == 3
+		       && strcmp (Tcl_GetString (objv[2]), "-reset") != 0))
 	{
-	  /* Read fewer bytes than requested */
-	  stb.puts ("N/A");
-
-	  if (aschar)
-	    {
-	      for (j = 0; j < size; j++)
-		*bptr++ = 'X';
-	    }
+	  Tcl_WrongNumArgs (interp, 2, objv, "?-reset?");
+	  return TCL_ERROR;
 	}
-      else
-	{
-	  struct value_print_options opts;
-
-	  get_formatted_print_options (&opts, format);
+      Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("hits", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (source_cache_hits));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("misses", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (source_cache_misses));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("walks", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (source_cache_walks));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("files", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (source_buffers.size ()));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewStringObj ("bytes", -1));
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewWideIntObj (gdbtk_source_cache_bytes ()));
+      if (objc == 3)
+	source_cache_hits = source_cache_misses = source_cache_walks = 0;
+      break;
 
-	  /* print memory to our uiout file and set the table's variable */
-	  print_scalar_formatted (mptr, val_type, &opts, asize, &stb);
+    case SRCCACHE_FLUSH:
+      source_buffers.clear ();
+      break;
 
-	  /* See comments above on max_*_len */
-	  if (max_val_len == 0)
-	    max_val_len = stb.size ();
+    case SRCCACHE_LIMIT:
+      if (objc > 3)
+	{
+	  Tcl_WrongNumArgs (interp, 2, objv, "?bytes?");
+	  return TCL_ERROR;
+	}
+      if (objc == 3)
+	{
+	  Tcl_WideInt limit;
 
-	  if (aschar)
+	  if (Tcl_GetWideIntFromObj (interp, objv[2], &limit) != TCL_OK)
 	    {
-	      for (j = 0; j < size; j++)
-		{
-		  if (isprint (*cptr))
-		    *bptr++ = *cptr++;
-		  else
-		    {
-		      *bptr++ = aschar;
-		      cptr++;;
-		    }
-		}
+	      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	      return TCL_ERROR;
 	    }
+	  source_cache_limit = limit > 0 ? (size_t) limit : 0;
+	  gdbtk_source_cache_trim ();
 	}
-      Tcl_SetVar2 (interp, "data", index, stb.data (), 0);
+      Tcl_SetWideIntObj (result_ptr->obj_ptr, source_cache_limit);
+      break;
+    }
 
-      mptr += size;
-      bc += size;
+  return TCL_OK;
+}
 
-      if (aschar && (bc >= bpr))
-	{
-	  /* end of row. Add it to the result and reset variables */
-	  *bptr = '\000';
-	  INDEX (i/bpr, bpr/size);
-	  Tcl_SetVar2 (interp, "data", index, buff, 0);
+/* This implements the Tcl command 'gdb_objfile_mtime', which returns
+ * the modification time of the objfile with the code of a source file
+ * or address.  The source windows use it to tell the views of a
+ * rebuilt program from the old ones.
+ *
+ * Arguments:
+ *   filename, or -pc address
+ * Return:
+ *   The modification time of the objfile, or of the executable if
+ *   there is no such objfile, or 0 if that is not known either.
+ */
 
-	  /* See comments above on max_*_len */
-	  if (max_ascii_len == 0)
-	    max_ascii_len = strlen (buff);
+static int
+gdb_objfile_mtime (ClientData clientData, Tcl_Interp *interp,
+		   int objc, Tcl_Obj *CONST objv[])
+{
+  struct objfile *objfile = NULL;
 
-	  bc = 0;
-	  bptr = &buff[0];
-	}
+  if (objc == 3 && strcmp (Tcl_GetString (objv[1]), "-pc") == 0)
+    {
+      struct obj_section *osect;
+      CORE_ADDR pc;
+
+      pc = string_to_core_addr (Tcl_GetStringFromObj (objv[2], NULL));
+      osect = find_pc_section (pc);
+      if (osect != NULL)
+	objfile = osect->objfile;
+    }
+  else if (objc == 2)
+    {
+      struct symtab *symtab = lookup_symtab (Tcl_GetString (objv[1]));
+
+      if (symtab != NULL)
+	objfile = SYMTAB_OBJFILE (symtab);
+    }
+  else
+    {
+      Tcl_WrongNumArgs (interp, 1, objv, "filename | -pc address");
+      return TCL_ERROR;
     }
 
-  /* return max_*_len so that column widths can be set */
-  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr, Tcl_NewIntObj (max_label_len + 1));
-  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr, Tcl_NewIntObj (max_val_len + 1));
-  Tcl_ListObjAppendElement (interp, result_ptr->obj_ptr, Tcl_NewIntObj (max_ascii_len + 1));
-  xfree (mbuf);
+  Tcl_SetLongObj (result_ptr->obj_ptr, gdbtk_objfile_mtime (objfile));
   return TCL_OK;
-#undef INDEX
 }
-
 
 /* This implements the tcl command "gdb_loadfile"
  * It loads a c source file into a text widget.
@@ -2702,33 +5654,20 @@ gdb_update_mem (ClientData clientData, Tcl_Interp *interp,
  *
  */
 
-/* In this routine, we will build up a "line table", i.e. a
- * table of bits showing which lines in the source file are executible.
- * LTABLE_SIZE is the number of bytes to allocate for the line table.
- *
- * Its size limits the maximum number of lines
- * in a file to 8 * LTABLE_SIZE.  This memory is freed after
- * the file is loaded, so it is OK to make this very large.
- * Additional memory will be allocated if needed. */
-#define LTABLE_SIZE 20000
 static int
 gdb_loadfile (ClientData clientData, Tcl_Interp *interp, int objc,
 	      Tcl_Obj *CONST objv[])
 {
   const char *file;
   char *widget;
-  int linenumbers, ln, lnum, ltable_size;
-  FILE *fp;
-  char *ltable;
+  int linenumbers;
+  size_t ln, nlines, first, last;
+  std::shared_ptr<source_buffer> source;
   struct symtab *symtab;
-  struct linetable_entry *le;
-  long mtime = 0;
-  struct stat st;
-  int llen;
-  char inputline[10000];
-  char line[10000], line_num_buf[18];
-  int found_carriage_return = 1;
-  const char *text_argv[9];
+  long mtime;
+  std::string scratch;
+  std::vector<size_t> offsets;
+  std::vector<const char *> text_argv;
   Tcl_CmdInfo text_cmd;
 
   if (objc != 4)
@@ -2760,143 +5699,78 @@ gdb_loadfile (ClientData clientData, Tcl_Interp *interp, int objc,
     }
 
   file = symtab_to_filename ( symtab );
-  if ((fp = fopen ( file, "r" )) == NULL)
+  source = gdbtk_get_source_buffer (file);
+  if (!source)
     {
       gdbtk_set_result (interp, "Can't open file for reading");
       return TCL_ERROR;
     }
 
-  if (stat (file, &st) < 0)
-    {
-      catch_errors (perror_with_name_wrapper, (void *) "gdbtk: get time stamp",
-		    "", RETURN_MASK_ALL);
-      return TCL_ERROR;
-    }
-
-  if (symtab && SYMTAB_OBJFILE (symtab) && SYMTAB_OBJFILE (symtab)->obfd)
-    mtime = bfd_get_mtime (SYMTAB_OBJFILE (symtab)->obfd);
-  else if (exec_bfd)
-    mtime = bfd_get_mtime(exec_bfd);
-
-  if (mtime && mtime < st.st_mtime)
+  mtime = gdbtk_objfile_mtime (SYMTAB_OBJFILE (symtab));
+  if (mtime && mtime < source->mtime)
     {
       gdbtk_ignorable_warning("file_times",\
 			      "Source file is more recent than executable.\n");
     }
 
+  nlines = source->lines.size () - 1;
+  const std::vector<bool> &executable
+    = gdbtk_executable_lines (source.get (), symtab);
 
-  /* Source linenumbers don't appear to be in order, and a sort is */
-  /* too slow so the fastest solution is just to allocate a huge */
-  /* array and set the array entry for each linenumber */
-
-  ltable_size = LTABLE_SIZE;
-  ltable = (char *)malloc (LTABLE_SIZE);
-  if (ltable == NULL)
-    {
-      fclose (fp);
-      gdbtk_set_result (interp, "Out of memory.");
-      return TCL_ERROR;
-    }
-
-  memset (ltable, 0, LTABLE_SIZE);
-
-  if (SYMTAB_LINETABLE (symtab) && SYMTAB_LINETABLE (symtab)->nitems)
-    {
-      le = SYMTAB_LINETABLE (symtab)->item;
-      for (ln = SYMTAB_LINETABLE(symtab)->nitems ;ln > 0; ln--, le++)
-        {
-          lnum = le->line >> 3;
-          if (lnum >= ltable_size)
-            {
-              char *new_ltable;
-              new_ltable = (char *)realloc (ltable, ltable_size*2);
-              memset (new_ltable + ltable_size, 0, ltable_size);
-              ltable_size *= 2;
-              if (new_ltable == NULL)
-                {
-                  free (ltable);
-                  fclose (fp);
-		  gdbtk_set_result (interp, "Out of memory.");
-                  return TCL_ERROR;
-                }
-              ltable = new_ltable;
-            }
-          ltable[lnum] |= 1 << (le->line % 8);
-        }
-    }
-
-  ln = 1;
-
-  line[0] = '\t';
-  line_num_buf[1] = linenumbers? '\t': ' ';
-  line_num_buf[2] = '\0';
-  text_argv[0] = widget;
-  text_argv[1] = "insert";
-  text_argv[2] = "end";
-  text_argv[3] = line_num_buf;
-  text_argv[5] = line;
-  text_argv[6] = "source_tag";
-  text_argv[7] = NULL;
+  /* Insert the file SOURCE_INSERT_LINES lines at a time.  Each line is
+     two text/tag pairs: the line number (or just the breakpoint region
+     marker) and the text.  */
 
-  while (fgets (inputline, sizeof (inputline), fp))
+  for (first = 1; first <= nlines; first = last)
     {
-      llen = strlen(inputline);
-
-      /* Look for DOS style \r\n endings, and if found,
-       * strip off the \r.  We assume (for the sake of
-       * speed) that ALL lines in the file have DOS endings,
-       * or none do.
-       */
+      last = std::min (first + SOURCE_INSERT_LINES, nlines + 1);
 
-      if (found_carriage_return)
+      /* Build the strings first, SCRATCH may move as it grows.  */
+      scratch.clear ();
+      offsets.clear ();
+      for (ln = first; ln < last; ln++)
 	{
-	  char *p = inputline + llen - 2;
-	  if (llen > 1 && *p == '\r')
-	    {
-	      *p = '\n';
-	       *(p + 1) = '\0';
-	       llen--;
-	    }
-	  else
-	    found_carriage_return = 0;
-	}
-
-      /* Convert from system encoding to utf-8. This has the side effect
-       * to map invalid characters in source encoding to a default value.
-       */
-      if (Tcl_ExternalToUtf (interp, NULL, inputline, llen, 0, NULL,
-			     line + 1, 9980, NULL, &llen, NULL) != TCL_OK)
-	{
-	  free (ltable);
-	  fclose (fp);
-	  gdbtk_set_result (interp, "Conversion error.");
-	  return TCL_ERROR;
+	  char line_num_buf[24];
+	  size_t start = source->lines[ln - 1];
+
+	  line_num_buf[0] = executable[ln] ? '-' : ' ';
+	  line_num_buf[1] = linenumbers? '\t': ' ';
+	  line_num_buf[2] = '\0';
+	  if (linenumbers)
+	    sprintf (line_num_buf + 2, "%d", (int) ln);
+
+	  offsets.push_back (scratch.size ());
+	  scratch.append (line_num_buf);
+	  scratch.push_back ('\0');
+
+	  offsets.push_back (scratch.size ());
+	  scratch.push_back ('\t');
+	  scratch.append (source->text, start, source->lines[ln] - start);
+	  scratch.push_back ('\0');
 	}
-      line[llen + 1] = '\0';
 
-      if (linenumbers)
-        sprintf (line_num_buf+2, "%d", ln);
+      text_argv.clear ();
+      text_argv.push_back (widget);
+      text_argv.push_back ("insert");
+      text_argv.push_back ("end");
+      for (ln = first; ln < last; ln++)
+	{
+	  size_t i = 2 * (ln - first);
 
-      if (ltable[ln >> 3] & (1 << (ln % 8)))
-        {
-	  line_num_buf[0] = '-';
-          text_argv[4] = "break_rgn_tag";
-        }
-      else
-        {
-	  line_num_buf[0] = ' ';
-          text_argv[4] = "";
-        }
+	  text_argv.push_back (scratch.c_str () + offsets[i]);
+	  text_argv.push_back (executable[ln] ? "break_rgn_tag" : "");
+	  text_argv.push_back (scratch.c_str () + offsets[i + 1]);
+	  text_argv.push_back ("source_tag");
+	}
+      text_argv.push_back (NULL);
 
-      text_cmd.proc(text_cmd.clientData, interp, 7, text_argv);
-      ln++;
+      text_cmd.proc (text_cmd.clientData, interp, text_argv.size () - 1,
+		     text_argv.data ());
     }
 
-  free (ltable);
-  fclose (fp);
   return TCL_OK;
 }
-
+
 /*
  * This section contains a bunch of miscellaneous utility commands
  */
@@ -2947,13 +5821,6 @@ gdb_path_conv (ClientData clientData, Tcl_Interp *interp,
  * This section has utility routines that are not Tcl commands.
  */
 
-static int
-perror_with_name_wrapper (PTR args)
-{
-  perror_with_name ((const char *) args);
-  return 1;
-}
-
 /* Look for the function that contains PC and return the source
    (demangled) name for this function.
 
@@ -2963,9 +5830,14 @@ const char *
 pc_function_name (CORE_ADDR pc)
 {
   struct symbol *sym;
-  const char *funcname = NULL;
+  const char *funcname;
+
+  /* First look in the functions gdb_listfuncs has seen, then in the
+     symbol table... */
+  funcname = gdbtk_function_table_lookup (pc);
+  if (funcname != NULL)
+    return funcname;
 
-  /* First lookup the address in the symbol table... */
   sym = find_pc_function (pc);
   if (sym != NULL)
     funcname = GDBTK_SYMBOL_SOURCE_NAME (sym);
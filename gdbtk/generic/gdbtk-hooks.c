@@ -57,16 +57,51 @@
 #include <sys/time.h>
 
 #include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 #include "dis-asm.h"
 #include "gdbcmd.h"
 
 
 volatile bool gdbtk_in_write = false;
 
+/* Output bound for the console is not handed to Tcl one write at a
+   time.  It is collected in OUTPUT_BUFFER, one segment per run of
+   writes to the same Tcl proc, and flushed once OUTPUT_FLUSH_SIZE
+   bytes are pending or OUTPUT_FLUSH_INTERVAL milliseconds after the
+   last flush, and whenever something else is about to reach the user
+   (a gdbtk command returning, a query, the GUI turning busy or
+   idle...).  */
+#define OUTPUT_FLUSH_SIZE (64 * 1024)
+#define OUTPUT_FLUSH_INTERVAL 100
+
+struct output_segment
+{
+  const char *proc;
+  std::string text;
+};
+
+static std::vector<output_segment> output_buffer;
+static size_t output_buffer_bytes;
+static Tcl_TimerToken output_timer;
+static Tcl_Time output_last_flush;
+
+/* If positive, at most this many lines are passed on by a flush, for
+   a front end that would throw the older ones away anyway.  The
+   console keeps them in its log, so it leaves this at 0.  */
+int gdbtk_output_line_limit;
+
+struct gdbtk_output_stats gdbtk_output_stats;
+
 /* Set by gdb_stop, this flag informs x_event to tell its caller
    that it should forcibly detach from the target. */
 int gdbtk_force_detach = 0;
 
+/* Set when x_event returned without running the event loop, so that
+   whoever woke it up can try again later. */
+volatile int gdbtk_x_event_deferred = 0;
+
 /* From gdbtk-bp.c */
 extern void gdbtk_create_breakpoint (struct breakpoint *);
 extern void gdbtk_delete_breakpoint (struct breakpoint *);
@@ -93,11 +128,17 @@ static void gdbtk_post_add_symbol (void);
 static void gdbtk_register_changed (struct frame_info *frame, int regno);
 static void gdbtk_memory_changed (struct inferior *inferior, CORE_ADDR addr,
 				  ssize_t len, const bfd_byte *data);
+static void gdbtk_target_resumed (ptid_t ptid);
+static void gdbtk_free_objfile (struct objfile *objfile);
+static void gdbtk_new_objfile (struct objfile *objfile);
 static void gdbtk_context_change (int);
 static void gdbtk_error_begin (void);
 void report_error (void);
 static void gdbtk_annotate_signal (void);
 static void gdbtk_param_changed (const char *, const char *);
+static void gdbtk_output_append (const char *, const char *, long);
+static void gdbtk_output_timer (ClientData);
+static void gdbtk_output_trim (std::vector<output_segment> &);
 
 /* I/O stream for gdbtk. */
 
@@ -126,6 +167,9 @@ gdbtk_add_hooks (void)
   observer_attach_breakpoint_deleted (gdbtk_delete_breakpoint);
   observer_attach_architecture_changed (gdbtk_architecture_changed);
   observer_attach_memory_changed (gdbtk_memory_changed);
+  observer_attach_target_resumed (gdbtk_target_resumed);
+  observer_attach_free_objfile (gdbtk_free_objfile);
+  observer_attach_new_objfile (gdbtk_new_objfile);
   observer_attach_command_param_changed (gdbtk_param_changed);
   observer_attach_register_changed (gdbtk_register_changed);
   observer_attach_traceframe_changed (gdbtk_trace_find);
@@ -197,6 +241,9 @@ gdbtk_two_elem_cmd (const char *cmd_name, const char *argv1)
   char *command;
   int result, flags_ptr, arg_len, cmd_len;
 
+  /* Whatever this is, it should come after the output so far.  */
+  gdbtk_output_flush ();
+
   arg_len = Tcl_ScanElement (argv1, &flags_ptr);
   cmd_len = strlen (cmd_name);
   command = (char *) malloc (arg_len + cmd_len + 2);
@@ -212,6 +259,113 @@ gdbtk_two_elem_cmd (const char *cmd_name, const char *argv1)
   return result;
 }
 
+/* Queue LENGTH bytes of BUF of output for the Tcl proc PROC, and flush
+   the output if enough of it is pending or enough time has passed.  */
+static void
+gdbtk_output_append (const char *proc, const char *buf, long length)
+{
+  Tcl_Time now;
+  long elapsed;
+
+  if (output_buffer.empty () || output_buffer.back ().proc != proc)
+    {
+      output_buffer.push_back (output_segment ());
+      output_buffer.back ().proc = proc;
+    }
+  output_buffer.back ().text.append (buf, length);
+  output_buffer_bytes += length;
+  gdbtk_output_stats.writes++;
+
+  Tcl_GetTime (&now);
+  elapsed = (now.sec - output_last_flush.sec) * 1000
+    + (now.usec - output_last_flush.usec) / 1000;
+  if (output_buffer_bytes >= OUTPUT_FLUSH_SIZE
+      || elapsed >= OUTPUT_FLUSH_INTERVAL)
+    gdbtk_output_flush ();
+  else if (output_timer == NULL)
+    output_timer = Tcl_CreateTimerHandler (OUTPUT_FLUSH_INTERVAL,
+					   gdbtk_output_timer, NULL);
+}
+
+static void
+gdbtk_output_timer (ClientData clientData)
+{
+  output_timer = NULL;
+  gdbtk_output_flush ();
+}
+
+/* Drop all but the last gdbtk_output_line_limit lines of SEGMENTS.  */
+static void
+gdbtk_output_trim (std::vector<output_segment> &segments)
+{
+  long lines = 0;
+  size_t i, pos;
+
+  for (i = segments.size (); i-- > 0; )
+    {
+      std::string &text = segments[i].text;
+
+      for (pos = text.size (); pos-- > 0; )
+	if (text[pos] == '\n' && ++lines > gdbtk_output_line_limit)
+	  {
+	    gdbtk_output_stats.dropped
+	      += std::count (text.begin (), text.begin () + pos + 1, '\n');
+	    text.erase (0, pos + 1);
+	    for (size_t j = 0; j < i; j++)
+	      gdbtk_output_stats.dropped
+		+= std::count (segments[j].text.begin (),
+			       segments[j].text.end (), '\n');
+	    segments.erase (segments.begin (), segments.begin () + i);
+	    return;
+	  }
+    }
+}
+
+/* Hand the pending console output over to Tcl.  This is called
+   after commands have set their result, so the interp state is
+   preserved.  */
+void
+gdbtk_output_flush (void)
+{
+  std::vector<output_segment> segments;
+  bool in_write = gdbtk_in_write;
+  Tcl_InterpState state;
+
+  if (output_timer != NULL)
+    {
+      Tcl_DeleteTimerHandler (output_timer);
+      output_timer = NULL;
+    }
+  if (output_buffer.empty ())
+    return;
+  Tcl_GetTime (&output_last_flush);
+
+  /* Anything written while Tcl handles this goes to a new buffer.  */
+  segments.swap (output_buffer);
+  output_buffer_bytes = 0;
+  if (gdbtk_output_line_limit > 0)
+    gdbtk_output_trim (segments);
+
+  state = Tcl_SaveInterpState (gdbtk_tcl_interp, TCL_OK);
+  gdbtk_in_write = true;
+  for (const output_segment &segment : segments)
+    {
+      Tcl_Obj *cmd = Tcl_NewStringObj (segment.proc, -1);
+
+      Tcl_IncrRefCount (cmd);
+      Tcl_ListObjAppendElement (NULL, cmd,
+				Tcl_NewStringObj (segment.text.data (),
+						  segment.text.size ()));
+      if (Tcl_EvalObjEx (gdbtk_tcl_interp, cmd, TCL_EVAL_GLOBAL) != TCL_OK)
+	report_error ();
+      Tcl_DecrRefCount (cmd);
+      gdbtk_output_stats.bytes += segment.text.size ();
+    }
+  gdbtk_in_write = in_write;
+  Tcl_RestoreInterpState (gdbtk_tcl_interp, state);
+  gdbtk_output_stats.flushes++;
+}
+
 struct ui_file *
 gdbtk_fileopen (void)
 {
@@ -229,6 +383,7 @@ gdbtk_file::read (char *buf, long sizeof_buf)
 
   if (this == gdb_stdtargin)
     {
+      gdbtk_output_flush ();
       result = Tcl_Eval (gdbtk_tcl_interp, "gdbtk_console_read");
       if (result != TCL_OK)
         {
@@ -277,6 +432,9 @@ gdbtk_file::read (char *buf, long sizeof_buf)
  *    UNLESS it was coming to gdb_stderr.  Then we place it in the result_ptr
  *    anyway, so it can be dealt with.
  *
+ * Data routed to gdbtk_tcl_fputs (or the log and target procs) goes
+ * through the output buffer, see gdbtk_output_flush.
+ *
  * This method only supports text output, so null bytes cannot appear in
  * output data.
  *
@@ -285,50 +443,45 @@ gdbtk_file::read (char *buf, long sizeof_buf)
 void
 gdbtk_file::write (const char *buf, long length_buf)
 {
-  std::string tmp;
-  char *ptr;
-
   if (gdbtk_disable_write || length_buf < 0)
     return;
 
   gdbtk_in_write = true;
-  tmp = std::string(buf, (size_t) length_buf);
-  ptr = (char *) tmp.data ();
 
   if (this == gdb_stdlog)
-    gdbtk_two_elem_cmd ("gdbtk_tcl_fputs_log", ptr);
+    gdbtk_output_append ("gdbtk_tcl_fputs_log", buf, length_buf);
   else if (this == gdb_stdtarg)
-    gdbtk_two_elem_cmd ("gdbtk_tcl_fputs_target", ptr);
+    gdbtk_output_append ("gdbtk_tcl_fputs_target", buf, length_buf);
   else if (result_ptr != NULL)
     {
       if (result_ptr->flags & GDBTK_TO_RESULT)
 	{
 	  if (result_ptr->flags & GDBTK_MAKES_LIST)
 	    Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
-				      Tcl_NewStringObj (ptr, -1));
+				      Tcl_NewStringObj (buf, length_buf));
 	  else
-	    Tcl_AppendToObj (result_ptr->obj_ptr, ptr, -1);
+	    Tcl_AppendToObj (result_ptr->obj_ptr, buf, length_buf);
 	}
       else if (this == gdb_stderr || result_ptr->flags & GDBTK_ERROR_ONLY)
 	{
 	  if (result_ptr->flags & GDBTK_ERROR_STARTED)
-	    Tcl_AppendToObj (result_ptr->obj_ptr, ptr, -1);
+	    Tcl_AppendToObj (result_ptr->obj_ptr, buf, length_buf);
 	  else
 	    {
-	      Tcl_SetStringObj (result_ptr->obj_ptr, ptr, -1);
+	      Tcl_SetStringObj (result_ptr->obj_ptr, buf, length_buf);
 	      result_ptr->flags |= GDBTK_ERROR_STARTED;
 	    }
 	}
       else
 	{
-	  gdbtk_two_elem_cmd ("gdbtk_tcl_fputs", ptr);
+	  gdbtk_output_append ("gdbtk_tcl_fputs", buf, length_buf);
 	  if (result_ptr->flags & GDBTK_MAKES_LIST)
-	    gdbtk_two_elem_cmd ("gdbtk_tcl_fputs", " ");
+	    gdbtk_output_append ("gdbtk_tcl_fputs", " ", 1);
 	}
     }
   else
     {
-      gdbtk_two_elem_cmd ("gdbtk_tcl_fputs", ptr);
+      gdbtk_output_append ("gdbtk_tcl_fputs", buf, length_buf);
     }
 
   gdbtk_in_write = false;
@@ -429,6 +582,7 @@ gdbtk_ignorable_warning (const char *warnclass, const char *warning)
 static void
 gdbtk_register_changed (struct frame_info *frame, int regno)
 {
+  gdbtk_register_cache_flush ();
   if (Tcl_Eval (gdbtk_tcl_interp, "gdbtk_register_changed") != TCL_OK)
     report_error ();
 }
@@ -437,11 +591,55 @@ static void
 gdbtk_memory_changed (struct inferior *inferior, CORE_ADDR addr,
 		      ssize_t len, const bfd_byte *data)
 {
+  /* Let the memory windows know which bytes to re-read. */
+  if (len > 0)
+    gdbtk_memory_journal_add (addr, len);
+
+  /* The registers of outer frames are read from memory.  */
+  gdbtk_register_cache_flush ();
+
   if (Tcl_Eval (gdbtk_tcl_interp, "gdbtk_memory_changed") != TCL_OK)
     report_error ();
 }
 
 
+/* Called whenever the inferior is resumed: any memory, frame or
+   register the GUI cached for the previous stop is stale. */
+static void
+gdbtk_target_resumed (ptid_t ptid)
+{
+  gdbtk_memory_cache_flush ();
+  gdbtk_stack_cache_flush ();
+  gdbtk_register_cache_flush ();
+}
+
+/* Called before an objfile is freed: pending disassembly loads may
+   still point into its symbol tables, and the instructions, source
+   lines and symbol names cached for it are no longer valid. */
+static void
+gdbtk_free_objfile (struct objfile *objfile)
+{
+  gdbtk_disassembly_cancel_all ();
+  gdbtk_disassembly_cache_forget (objfile);
+  gdbtk_source_cache_forget (objfile);
+  gdbtk_symbol_index_flush ();
+  gdbtk_function_tables_flush ();
+  gdbtk_stack_cache_flush ();
+  gdbtk_breakpoint_index_flush ();
+}
+
+/* Called when symbols have been read for a new objfile, or with NULL
+   when all of them went away: the symbol index, the function
+   tables and the breakpoint location index are out of date. */
+static void
+gdbtk_new_objfile (struct objfile *objfile)
+{
+  gdbtk_symbol_index_flush ();
+  gdbtk_function_tables_flush ();
+  gdbtk_stack_cache_flush ();
+  gdbtk_breakpoint_index_flush ();
+}
+
 /* This hook is installed as the deprecated_ui_loop_hook, which is
  * used in several places to keep the gui alive (x_event runs gdbtk's
  * event loop). Users include:
@@ -461,10 +659,13 @@ gdbtk_memory_changed (struct inferior *inferior, CORE_ADDR addr,
  * caller. It is up to the caller of x_event to act on this
  * information.
  *
- * For native unix, we simply set an interval timer which calls
- * x_event to allow the debugger to run through the Tcl event
- * loop. See comments before gdbtk_start_timer and gdb_stop_timer
- * in gdbtk.c.
+ * For native unix, x_event is called from signal handlers to allow
+ * the debugger to run through the Tcl event loop: SIGIO when one of
+ * the files Tcl watches (the connection to the X server, for one)
+ * becomes readable, and SIGALRM when the next Tcl timer is due, or
+ * shortly after x_event could not run.  Hosts which cannot send SIGIO
+ * for a file fall back to a periodic SIGALRM.  See comments before
+ * gdbtk_start_timer and gdb_stop_timer in gdbtk.c.
  *
  * For native windows (and a few other targets, like the v850 ICE), we
  * rely on the target_wait loops to call deprecated_ui_loop_hook to
@@ -477,7 +678,10 @@ x_event (int signo)
 
   /* Do nor re-enter this code or enter it while collecting gdb output. */
   if (in_x_event || gdbtk_in_write)
-    return 0;
+    {
+      gdbtk_x_event_deferred = 1;
+      return 0;
+    }
 
   /* Also, only do things while the target is running (stops and redraws).
      FIXME: We wold like to at least redraw at other times but this is bundled
@@ -485,8 +689,12 @@ x_event (int signo)
      input.  We will have to prevent (unwanted)  user input to be generated
      in order to be able to redraw (removing this test here). */
   if (!running_now)
-    return 0;
+    {
+      gdbtk_x_event_deferred = 1;
+      return 0;
+    }
 
+  gdbtk_x_event_deferred = 0;
   in_x_event = 1;
   gdbtk_force_detach = 0;
 
@@ -576,6 +784,7 @@ gdbtk_call_command (struct cmd_list_element *cmdblk,
       int tracerunning = current_trace_status ()->running;
 
       running_now = 1;
+      gdbtk_output_flush ();
       if (!No_Update)
 	Tcl_Eval (gdbtk_tcl_interp, "gdbtk_tcl_busy");
       cmd_func (cmdblk, arg, from_tty);
@@ -592,6 +801,7 @@ gdbtk_call_command (struct cmd_list_element *cmdblk,
         gdbtk_trace_start_stop (current_trace_status ()->running, from_tty);
 
       running_now = 0;
+      gdbtk_output_flush ();
       if (!No_Update)
 	Tcl_Eval (gdbtk_tcl_interp, "gdbtk_tcl_idle");
     }
@@ -609,6 +819,11 @@ gdbtk_param_changed (const char *param, const char *value)
   Tcl_DString cmd;
   char *buffer = NULL;
 
+  gdbtk_disassembly_cache_param (param, value);
+  /* The formatted registers depend on print settings, the radix, the
+     language...  Settings change rarely, so forget them all.  */
+  gdbtk_register_cache_flush ();
+
   Tcl_DStringInit (&cmd);
   Tcl_DStringAppendElement (&cmd, "gdbtk_tcl_set_variable");
 
@@ -651,6 +866,7 @@ gdbtk_pre_add_symbol (const char *name)
 static void
 gdbtk_post_add_symbol (void)
 {
+  gdbtk_function_tables_flush ();
   if (Tcl_Eval (gdbtk_tcl_interp, "gdbtk_tcl_post_add_symbol") != TCL_OK)
     report_error ();
 }
@@ -716,6 +932,10 @@ gdbtk_trace_find (int tfnum, int tpnum)
 {
   Tcl_Obj *cmdObj;
 
+  /* Memory and registers now come from another trace frame. */
+  gdbtk_memory_cache_flush ();
+  gdbtk_register_cache_flush ();
+
   cmdObj = Tcl_NewListObj (0, NULL);
   Tcl_ListObjAppendElement (gdbtk_tcl_interp, cmdObj,
 			    Tcl_NewStringObj ("gdbtk_tcl_trace_find_hook", -1));
@@ -762,6 +982,7 @@ gdbtk_context_change (int num)
 static void
 gdbtk_file_changed (char *filename)
 {
+  gdbtk_memory_cache_flush ();
   gdbtk_two_elem_cmd ("gdbtk_tcl_file_changed", filename);
 }
 
@@ -810,6 +1031,8 @@ gdbtk_annotate_signal (void)
 static void
 gdbtk_attach (void)
 {
+  gdbtk_memory_cache_flush ();
+  gdbtk_register_cache_flush ();
   if (Tcl_Eval (gdbtk_tcl_interp,
                 "after idle \"update idletasks;gdbtk_attached\"") != TCL_OK)
     {
@@ -820,6 +1043,7 @@ gdbtk_attach (void)
 static void
 gdbtk_detach (void)
 {
+  gdbtk_memory_cache_flush ();
   if (Tcl_Eval (gdbtk_tcl_interp, "gdbtk_detached") != TCL_OK)
     {
       report_error ();
@@ -830,6 +1054,7 @@ gdbtk_detach (void)
 static void
 gdbtk_architecture_changed (struct gdbarch *ignore)
 {
+  gdbtk_disassembly_cache_flush ();
   Tcl_Eval (gdbtk_tcl_interp, "gdbtk_tcl_architecture_changed");
 }
 
@@ -28,6 +28,11 @@
 #include "language.h"
 #include "valprint.h"
 #include "arch-utils.h"
+#include "inferior.h"
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <vector>
 
 #include <tcl.h>
 #include "gdbtk.h"
@@ -44,6 +49,7 @@ typedef union
 typedef void (*map_func)(int, map_arg);
 
 static int gdb_register_info (ClientData, Tcl_Interp *, int, Tcl_Obj **);
+static Tcl_Obj *format_register (int, struct frame_info *);
 static void get_register (int, map_arg);
 static void get_register_name (int, map_arg);
 static void get_register_size (int, map_arg);
@@ -51,7 +57,8 @@ static void get_register_types (int regnum, map_arg);
 static void get_register_collectable (int regnum, map_arg);
 static int map_arg_registers (Tcl_Interp *, int, Tcl_Obj **,
 			      map_func, map_arg);
-static void register_changed_p (int, map_arg);
+static void register_snapshot_fetch (int, map_arg);
+static int register_changed (Tcl_Interp *, int, Tcl_Obj **, int);
 static void setup_architecture_data (void);
 static int gdb_regformat (ClientData, Tcl_Interp *, int, Tcl_Obj **);
 static int gdb_reggroup (ClientData, Tcl_Interp *, int, Tcl_Obj **);
@@ -59,15 +66,31 @@ static int gdb_reggrouplist (ClientData, Tcl_Interp *, int, Tcl_Obj **);
 static int gdb_regspecial (ClientData, Tcl_Interp *, int, Tcl_Obj **);
 
 /* This contains the previous values of the registers, since the last call to
-   gdb_changed_register_list.
+   "gdb_reginfo changed".
 
-   It is an array of (NUM_REGS+NUM_PSEUDO_REGS)*MAX_REGISTER_RAW_SIZE bytes. */
+   The registers are packed one after the other: register N takes the
+   bytes from REG_OFFSET[N] up to REG_OFFSET[N + 1].  NEW_REGS is where
+   the next snapshot is taken, to be compared with OLD_REGS.  */
 
-static char *old_regs = NULL;
+static std::vector<gdb_byte> old_regs;
+static std::vector<gdb_byte> new_regs;
+static std::vector<size_t> reg_offset;
 static int old_regs_count = 0;
 static int *regformat = (int *)NULL;
 static struct type **regtype = (struct type **)NULL;
 
+/* The registers formatted so far at the current stop, keyed by register
+   number, format and type.  They are those of the frame
+   REGISTER_CACHE_FRAME in thread REGISTER_CACHE_PTID; selecting another
+   frame empties the cache, as does anything that may change the
+   registers.  */
+
+typedef std::tuple<int, int, struct type *> register_cache_key;
+
+static std::map<register_cache_key, std::string> register_cache;
+static struct frame_id register_cache_frame;
+static ptid_t register_cache_ptid;
+
 int
 Gdbtk_Register_Init (Tcl_Interp *interp)
 {
@@ -96,9 +119,10 @@ Gdbtk_Register_Init (Tcl_Interp *interp)
  * Options:
  * changed
  *    Returns a list of registers whose values have changed since the
- *    last time the proc was called.
+ *    last time the proc was called.  With -values, each register number
+ *    is followed by its new value, as "value" would return it.
  *
- *    usage: gdb_reginfo changed [regnum0, ..., regnumN]
+ *    usage: gdb_reginfo changed [-values] [regnum0, ..., regnumN]
  *
  * name
  *    Return a list containing the names of the registers whose numbers
@@ -204,8 +228,19 @@ gdb_register_info (ClientData clientData, Tcl_Interp *interp, int objc,
   switch ((enum commands_enum) index)
     {
     case REGINFO_CHANGED:
-      func = register_changed_p;
-      break;
+      {
+	int values = 0;
+
+	if (objc != 0
+	    && strcmp (Tcl_GetStringFromObj (objv[0], NULL), "-values") == 0)
+	  {
+	    values = 1;
+	    objc--;
+	    objv++;
+	  }
+
+	return register_changed (interp, objc, objv, values);
+      }
 
     case REGINFO_NAME:
       {
@@ -332,18 +367,19 @@ get_register_types (int regnum, map_arg arg)
 }
 
 
-static void
-get_register (int regnum, map_arg arg)
+/* Return the value of register REGNUM in FRAME, formatted as set by
+   "gdb_reginfo format".  */
+
+static Tcl_Obj *
+format_register (int regnum, struct frame_info *frame)
 {
-  CORE_ADDR addr;
-  enum lval_type lval;
   struct type *reg_vtype;
   int format;
   string_file stb;
-  long dummy;
   struct gdbarch *gdbarch;
   struct value *val;
-  struct frame_info *frame;
+  register_cache_key key;
+  std::map<register_cache_key, std::string>::iterator it;
 
   format = regformat[regnum];
   if (format == 0)
@@ -353,27 +389,28 @@ get_register (int regnum, map_arg arg)
   if (reg_vtype == NULL)
     reg_vtype = register_type (get_current_arch (), regnum);
 
-  if (!target_has_registers)
+  key = register_cache_key (regnum, format, reg_vtype);
+  if (register_cache.empty ()
+      || !ptid_equal (register_cache_ptid, inferior_ptid)
+      || !frame_id_eq (register_cache_frame, get_frame_id (frame)))
     {
-      if (result_ptr->flags & GDBTK_MAKES_LIST)
-	Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr, Tcl_NewStringObj ("", -1));
-      else
-	Tcl_SetStringObj (result_ptr->obj_ptr, "", -1);
-      return;
+      register_cache.clear ();
+      register_cache_ptid = inferior_ptid;
+      register_cache_frame = get_frame_id (frame);
+    }
+  else
+    {
+      it = register_cache.find (key);
+      if (it != register_cache.end ())
+	return Tcl_NewStringObj (it->second.data (), it->second.size ());
     }
 
-  frame = get_selected_frame (NULL);
   gdbarch = get_frame_arch (frame);
   val = get_frame_register_value (frame, regnum);
 
   if (value_optimized_out (val))
-    {
-      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
-				Tcl_NewStringObj ("Optimized out", -1));
-      return;
-    }
-
-  if (format == 'r')
+    fputs_unfiltered ("Optimized out", &stb);
+  else if (format == 'r')
     {
       /* shouldn't happen. raw format is deprecated */
       int j;
@@ -403,10 +440,35 @@ get_register (int regnum, map_arg arg)
 		 &stb, 0, val, &opts, current_language);
     }
 
+  register_cache[key] = stb.string ();
+  return Tcl_NewStringObj (stb.data (), stb.size ());
+}
+
+/* Forget the registers formatted so far.  */
+
+void
+gdbtk_register_cache_flush (void)
+{
+  register_cache.clear ();
+}
+
+static void
+get_register (int regnum, map_arg arg)
+{
+  Tcl_Obj *value;
+
+  if (!target_has_registers)
+    value = Tcl_NewStringObj ("", -1);
+  else
+    value = format_register (regnum, get_selected_frame (NULL));
+
   if (result_ptr->flags & GDBTK_MAKES_LIST)
-    Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr, Tcl_NewStringObj (stb.data (), -1));
+    Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr, value);
   else
-    Tcl_SetStringObj (result_ptr->obj_ptr, stb.data (), -1);
+    {
+      Tcl_SetStringObj (result_ptr->obj_ptr, Tcl_GetString (value), -1);
+      Tcl_DecrRefCount (value);
+    }
 }
 
 static void
@@ -491,39 +553,187 @@ map_arg_registers (Tcl_Interp *interp, int objc, Tcl_Obj **objv,
   return TCL_OK;
 }
 
+/* Where register_snapshot_fetch takes the registers from: the
+   frame, and for the innermost frame, the regcache holding its raw
+   registers.  */
+
+struct register_snapshot_source
+{
+  struct frame_info *frame;
+  struct regcache *regcache;
+};
+
+/* Copy the contents of register REGNUM, from the source ARG points to,
+   into NEW_REGS.  A register whose contents are not all available is
+   left as it was.  */
+
 static void
-register_changed_p (int regnum, map_arg arg)
+register_snapshot_fetch (int regnum, map_arg arg)
 {
+  struct register_snapshot_source *source
+    = (struct register_snapshot_source *) arg.ptr;
+  struct gdbarch *gdbarch = get_frame_arch (source->frame);
   struct value *val;
+  size_t size;
+
   gdb_assert (regnum < old_regs_count);
 
-  if (!target_has_registers)
+  size = reg_offset[regnum + 1] - reg_offset[regnum];
+  if (size == 0)
     return;
 
-  val = get_frame_register_value (get_selected_frame (NULL), regnum);
+  if (source->regcache != NULL && regnum < gdbarch_num_regs (gdbarch)
+      && size == (size_t) register_size (gdbarch, regnum))
+    {
+      switch (regcache_register_status (source->regcache, regnum))
+	{
+	case REG_VALID:
+	  regcache_raw_collect (source->regcache, regnum,
+				&new_regs[reg_offset[regnum]]);
+	  return;
+	case REG_UNKNOWN:
+	  /* Not supplied by the bulk fetch; ask for it alone below.  */
+	  break;
+	default:
+	  return;
+	}
+    }
+
+  val = get_frame_register_value (source->frame, regnum);
   if (value_optimized_out (val) || !value_entirely_available (val))
     return;
 
-  if (memcmp (&old_regs[regnum * MAX_REGISTER_SIZE],
-	      value_contents_all (val),
-	      register_size (get_current_arch (), regnum)) == 0)
-    return;
+  memcpy (&new_regs[reg_offset[regnum]], value_contents_all (val),
+	  std::min (size, (size_t) TYPE_LENGTH (value_type (val))));
+}
+
+/* Append to the result the numbers of the registers whose contents
+   differ between OLD_REGS and NEW_REGS, in increasing order, each
+   followed by its value if VALUES is non-zero.
+
+   Most registers do not change from one stop to the next, so the
+   snapshots are compared a word at a time, and only the registers
+   sharing a differing word are compared one by one.  */
+
+static void
+register_snapshot_compare (struct frame_info *frame, int values)
+{
+  const gdb_byte *o = old_regs.data ();
+  const gdb_byte *n = new_regs.data ();
+  size_t end = old_regs.size ();
+  size_t off = 0;
+
+  while (off < end)
+    {
+      int regnum, last;
+
+      /* Skip the words which did not change.  */
+      while (off + sizeof (uint64_t) <= end)
+	{
+	  uint64_t a, b;
+
+	  memcpy (&a, o + off, sizeof (a));
+	  memcpy (&b, n + off, sizeof (b));
+	  if (a != b)
+	    break;
+	  off += sizeof (uint64_t);
+	}
+      if (off + sizeof (uint64_t) > end
+	  && memcmp (o + off, n + off, end - off) == 0)
+	break;
+
+      /* Find the registers sharing this word.  */
+      regnum = std::upper_bound (reg_offset.begin (), reg_offset.end (), off)
+	       - reg_offset.begin () - 1;
+      last = std::lower_bound (reg_offset.begin (), reg_offset.end (),
+			       std::min (off + sizeof (uint64_t), end))
+	     - reg_offset.begin ();
+
+      for (; regnum < last; regnum++)
+	{
+	  size_t start = reg_offset[regnum];
+	  size_t size = reg_offset[regnum + 1] - start;
+
+	  if (size == 0 || memcmp (o + start, n + start, size) == 0)
+	    continue;
+
+	  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				    Tcl_NewIntObj (regnum));
+	  if (values)
+	    {
+	      Tcl_Obj *value = NULL;
+
+	      TRY
+		{
+		  value = format_register (regnum, frame);
+		}
+	      CATCH (except, RETURN_MASK_ERROR)
+		{
+		  value = Tcl_NewStringObj ("", -1);
+		}
+	      END_CATCH
+
+	      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr, value);
+	    }
+	}
+
+      off = reg_offset[last];
+    }
+}
 
-  /* Found a changed register.  Save new value and return its number. */
+/* Implement "gdb_reginfo changed".  The registers given by OBJC and
+   OBJV, all of them by default, are fetched into a new snapshot, which
+   is compared with the previous one and then replaces it.
 
-  memcpy (&old_regs[regnum * MAX_REGISTER_SIZE],
-	  value_contents_all (val),
-	  register_size (get_current_arch (), regnum));
+   In the innermost frame, the raw registers are those of the thread's
+   regcache.  The target is asked for all of them at once, if any is
+   missing, and they are copied from there without building a value
+   for each.  Pseudo registers and outer frames go through the frame
+   unwinders as before.  */
+
+static int
+register_changed (Tcl_Interp *interp, int objc, Tcl_Obj **objv, int values)
+{
+  struct frame_info *frame;
+  struct register_snapshot_source source;
+  map_arg arg;
 
-  Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr, Tcl_NewIntObj (regnum));
+  if (!target_has_registers)
+    return TCL_OK;
+
+  frame = get_selected_frame (NULL);
+  source.frame = frame;
+  source.regcache = NULL;
+  if (frame_relative_level (frame) == 0)
+    {
+      int regnum, numregs = gdbarch_num_regs (get_frame_arch (frame));
+
+      source.regcache = get_current_regcache ();
+      for (regnum = 0; regnum < numregs; regnum++)
+	if (regcache_register_status (source.regcache, regnum) == REG_UNKNOWN)
+	  {
+	    target_fetch_registers (source.regcache, -1);
+	    break;
+	  }
+    }
+  arg.ptr = &source;
+
+  new_regs = old_regs;
+  if (map_arg_registers (interp, objc, objv, register_snapshot_fetch, arg)
+      != TCL_OK)
+    return TCL_ERROR;
+
+  register_snapshot_compare (frame, values);
+  old_regs.swap (new_regs);
+  return TCL_OK;
 }
 
 static void
 setup_architecture_data (void)
 {
-  int numregs;
+  int numregs, regnum;
 
-  xfree (old_regs);
+  gdbtk_register_cache_flush ();
   xfree (regformat);
   xfree (regtype);
 
@@ -531,7 +741,22 @@ setup_architecture_data (void)
   numregs = (gdbarch_num_regs (target_gdbarch ())
 	     + gdbarch_num_pseudo_regs (target_gdbarch ()));
   old_regs_count = numregs;
-  old_regs = (char *) xcalloc (1, numregs * MAX_REGISTER_SIZE + 1);
+
+  /* Registers without a name have no contents to keep.  */
+  reg_offset.resize (numregs + 1);
+  reg_offset[0] = 0;
+  for (regnum = 0; regnum < numregs; regnum++)
+    {
+      const char *name = gdbarch_register_name (target_gdbarch (), regnum);
+      size_t size = 0;
+
+      if (name != NULL && *name != '\0')
+	size = register_size (target_gdbarch (), regnum);
+      reg_offset[regnum + 1] = reg_offset[regnum] + size;
+    }
+  old_regs.assign (reg_offset[numregs], 0);
+  new_regs.clear ();
+
   regformat = (int *) xcalloc (numregs, sizeof(int));
   regtype = (struct type **) xcalloc (numregs, sizeof(struct type **));
 }
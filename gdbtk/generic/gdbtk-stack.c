@@ -29,8 +29,10 @@
 #include "arch-utils.h"
 #include "stack.h"
 #include "solib.h"
+#include "frame.h"
 
 #include <tcl.h>
+#include <vector>
 #include "gdbtk.h"
 #include "gdbtk-cmds.h"
 #include "gdbtk-wrapper.h"
@@ -58,7 +60,19 @@ static int gdb_selected_frame_level (ClientData clientData,
 				     Tcl_Obj * CONST objv[]);
 static int gdb_stack (ClientData, Tcl_Interp *, int, Tcl_Obj * CONST[]);
 static void get_frame_name (Tcl_Interp *interp, Tcl_Obj *list,
-			    struct frame_info *fi);
+			    struct frame_info *fi, int level);
+static Tcl_Obj *frame_name (struct frame_info *fi);
+
+/* The names of the frames gdb_stack has described since the target
+   stopped, by level, with the frame_id they were computed for.  */
+
+struct stack_frame_name
+{
+  struct frame_id id;
+  Tcl_Obj *name;
+};
+
+static std::vector<stack_frame_name> stack_frame_names;
 
 int
 Gdbtk_Stack_Init (Tcl_Interp *interp)
@@ -464,6 +478,19 @@ gdb_selected_frame_level (ClientData clientData, Tcl_Interp *interp,
   return TCL_OK;
 }
 
+/* Forget the frame names gdb_stack has cached: the target has run,
+   or its registers, memory or symbols have changed.  */
+
+void
+gdbtk_stack_cache_flush (void)
+{
+  size_t i;
+
+  for (i = 0; i < stack_frame_names.size (); i++)
+    Tcl_DecrRefCount (stack_frame_names[i].name);
+  stack_frame_names.clear ();
+}
+
 /* This implements the tcl command gdb_stack.
  * It builds up a list of stack frames.
  *
@@ -472,30 +499,101 @@ gdb_selected_frame_level (ClientData clientData, Tcl_Interp *interp,
  *    count - number of frames to inspect
  * Tcl Result:
  *    A list of function names
+ *
+ * The arguments count frames from the outermost one, so the whole
+ * stack has to be unwound.  To only unwind what is needed, use:
+ *
+ * Tcl Arguments:
+ *    -level - count frames from the innermost one
+ *    first  - level of the first frame
+ *    count  - number of frames to return
+ *    more   - optional, how many frames past these to look for,
+ *             defaults to 1
+ * Tcl Result:
+ *    A list of two elements: the function names of the frames, innermost
+ *    first, and the number of frames found after them, at most MORE.
  */
 static int
 gdb_stack (ClientData clientData, Tcl_Interp *interp,
 	   int objc, Tcl_Obj *CONST objv[])
 {
-  int start, count;
+  int start, count, more = 1, by_level = 0, arg = 1;
 
-  if (objc < 3)
+  if (objc > 1 && strcmp (Tcl_GetString (objv[1]), "-level") == 0)
+    {
+      by_level = 1;
+      arg++;
+    }
+
+  if (objc < arg + 2 || (by_level && objc > arg + 3))
     {
-      Tcl_WrongNumArgs (interp, 1, objv, "start count");
+      Tcl_WrongNumArgs (interp, 1, objv,
+			by_level ? "-level first count ?more?" : "start count");
       return TCL_ERROR;
     }
 
-  if (Tcl_GetIntFromObj (NULL, objv[1], &start))
+  if (Tcl_GetIntFromObj (NULL, objv[arg], &start))
+    {
+      result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+      return TCL_ERROR;
+    }
+  if (Tcl_GetIntFromObj (NULL, objv[arg + 1], &count))
     {
       result_ptr->flags |= GDBTK_IN_TCL_RESULT;
       return TCL_ERROR;
     }
-  if (Tcl_GetIntFromObj (NULL, objv[2], &count))
+  if (objc == arg + 3
+      && Tcl_GetIntFromObj (NULL, objv[arg + 2], &more))
     {
       result_ptr->flags |= GDBTK_IN_TCL_RESULT;
       return TCL_ERROR;
     }
 
+  if (by_level)
+    {
+      gdb_result r;
+      struct frame_info *fi = NULL;
+      Tcl_Obj *frames = Tcl_NewListObj (0, NULL);
+      int level, found = 0;
+
+      if (target_has_stack)
+	{
+	  r = GDB_get_current_frame (&fi);
+	  if (r != GDB_OK)
+	    fi = NULL;
+	}
+
+      /* Only unwind as far as asked, and a few frames more.  */
+      for (level = 0; fi != NULL && level < start; level++)
+	{
+	  r = GDB_get_prev_frame (fi, &fi);
+	  if (r != GDB_OK)
+	    fi = NULL;
+	}
+
+      for (; fi != NULL && level < start + count; level++)
+	{
+	  get_frame_name (interp, frames, fi, level);
+	  r = GDB_get_prev_frame (fi, &fi);
+	  if (r != GDB_OK)
+	    fi = NULL;
+	}
+
+      while (fi != NULL && found < more)
+	{
+	  found++;
+	  r = GDB_get_prev_frame (fi, &fi);
+	  if (r != GDB_OK)
+	    fi = NULL;
+	}
+
+      Tcl_SetListObj (result_ptr->obj_ptr, 0, NULL);
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr, frames);
+      Tcl_ListObjAppendElement (NULL, result_ptr->obj_ptr,
+				Tcl_NewIntObj (found));
+      return TCL_OK;
+    }
+
   if (target_has_stack)
     {
       gdb_result r;
@@ -531,7 +629,8 @@ gdb_stack (ClientData clientData, Tcl_Interp *interp,
           fi = top;
           while (fi && count--)
             {
-              get_frame_name (interp, result_ptr->obj_ptr, fi);
+              get_frame_name (interp, result_ptr->obj_ptr, fi,
+			      frame_relative_level (fi));
               r = GDB_get_next_frame (fi, &fi);
               if (r != GDB_OK)
                 break;
@@ -543,50 +642,75 @@ gdb_stack (ClientData clientData, Tcl_Interp *interp,
 }
 
 /* A helper function for get_stack which adds information about
- * the stack frame FI to the caller's LIST.
+ * the stack frame FI, at LEVEL, to the caller's LIST.  The name is
+ * cached until the target runs again.
+ */
+
+static void
+get_frame_name (Tcl_Interp *interp, Tcl_Obj *list, struct frame_info *fi,
+		int level)
+{
+  struct frame_id id = get_frame_id (fi);
+  Tcl_Obj *name;
+
+  if (level >= 0 && (size_t) level < stack_frame_names.size ()
+      && frame_id_eq (stack_frame_names[level].id, id))
+    {
+      Tcl_ListObjAppendElement (interp, list, stack_frame_names[level].name);
+      return;
+    }
+
+  name = frame_name (fi);
+  if (level >= 0)
+    {
+      if ((size_t) level >= stack_frame_names.size ())
+	{
+	  stack_frame_name blank;
+
+	  blank.id = null_frame_id;
+	  blank.name = NULL;
+	  stack_frame_names.resize (level + 1, blank);
+	}
+      if (stack_frame_names[level].name != NULL)
+	Tcl_DecrRefCount (stack_frame_names[level].name);
+      stack_frame_names[level].id = id;
+      stack_frame_names[level].name = name;
+      Tcl_IncrRefCount (name);
+    }
+  Tcl_ListObjAppendElement (interp, list, name);
+}
+
+/* Describe the stack frame FI.
  *
  * This is stolen from print_frame_info/print_frame in stack.c.
  */
 
-static void
-get_frame_name (Tcl_Interp *interp, Tcl_Obj *list, struct frame_info *fi)
+static Tcl_Obj *
+frame_name (struct frame_info *fi)
 {
   struct symbol *func = NULL;
   char *funname = NULL;
   enum language funlang = language_unknown;
-  Tcl_Obj *objv[1];
+  Tcl_Obj *obj;
 
   if (get_frame_type (fi) == DUMMY_FRAME)
-    {
-      objv[0] = Tcl_NewStringObj ("<function called from gdb>", -1);
-      Tcl_ListObjAppendElement (interp, list, objv[0]);
-      return;
-    }
+    return Tcl_NewStringObj ("<function called from gdb>", -1);
   if (get_frame_type (fi) == SIGTRAMP_FRAME)
-    {
-      objv[0] = Tcl_NewStringObj ("<signal handler called>", -1);
-      Tcl_ListObjAppendElement (interp, list, objv[0]);
-      return;
-    }
+    return Tcl_NewStringObj ("<signal handler called>", -1);
   if (get_frame_type (fi) == ARCH_FRAME)
-    {
-      objv[0] = Tcl_NewStringObj ("<cross-architecture call>", -1);
-      Tcl_ListObjAppendElement (interp, list, objv[0]);
-      return;
-    }
+    return Tcl_NewStringObj ("<cross-architecture call>", -1);
 
   find_frame_funname (fi, &funname, &funlang, &func);
 
   if (funname)
     {
-      objv[0] = Tcl_NewStringObj (funname, -1);
-      Tcl_ListObjAppendElement (interp, list, objv[0]);
+      obj = Tcl_NewStringObj (funname, -1);
       xfree (funname);
     }
   else
     {
       char *lib = NULL;
-      objv[0] = Tcl_NewStringObj (funname ? funname : "??", -1);
+      obj = Tcl_NewStringObj ("??", -1);
 #ifdef PC_SOLIB
       lib = PC_SOLIB (get_frame_pc (fi));
 #else
@@ -594,8 +718,8 @@ get_frame_name (Tcl_Interp *interp, Tcl_Obj *list, struct frame_info *fi)
                                      get_frame_pc (fi));
 #endif
       if (lib)
-        Tcl_AppendStringsToObj (objv[0], " from ", lib, (char *) NULL);
-
-      Tcl_ListObjAppendElement (interp, list, objv[0]);
+        Tcl_AppendStringsToObj (obj, " from ", lib, (char *) NULL);
     }
+
+  return obj;
 }
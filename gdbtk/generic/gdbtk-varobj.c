@@ -31,6 +31,9 @@
 #include "gdbtk.h"
 #include "gdbtk-cmds.h"
 #include "gdbtk-wrapper.h"
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 /*
  * Public functions defined in this file
@@ -56,7 +59,8 @@ static int variable_create (Tcl_Interp *, int, Tcl_Obj * CONST[]);
 
 static void variable_delete (Tcl_Interp *, struct varobj *, int);
 
-static Tcl_Obj *variable_children (Tcl_Interp *, struct varobj *);
+static int variable_children (Tcl_Interp *, int, Tcl_Obj * CONST[],
+			      struct varobj *);
 
 static int variable_format (Tcl_Interp *, int, Tcl_Obj * CONST[],
 			    struct varobj *);
@@ -72,12 +76,16 @@ static int variable_print (Tcl_Interp *, int, Tcl_Obj * CONST[],
 
 static Tcl_Obj *variable_update (Tcl_Interp * interp, struct varobj **var);
 
+static int variable_update_all (Tcl_Interp *, int, Tcl_Obj * CONST[]);
+
 /* Helper functions for the above subcommands. */
 
 static void install_variable (Tcl_Interp *, const char *);
 
 static void uninstall_variable (Tcl_Interp *, const char *);
 
+static int variable_print_value (struct varobj *, std::string &);
+
 /* String representations of gdb's format codes */
 static const char *format_string[] =
   {"natural", "binary", "decimal", "hexadecimal", "octal"};
@@ -112,22 +120,25 @@ gdb_variable_init (Tcl_Interp *interp)
    gdb_variable create -expr EXPR
    gdb_variable create -frame FRAME
    (it will also include permutations of the above options)
+   gdb_variable update_all ?-open VAROBJS? ?ROOT ...?
 
    NAME  = name of object to create. If no NAME, then automatically create
    a name
    EXPR  = the gdb expression for which to create a variable. This will
    be the most common usage.
    FRAME = the frame defining the scope of the variable.
+   ROOT  = a root variable object to update, all of them by default.
+   VAROBJS = see variable_update_all.
 */
 static int
 gdb_variable_command (ClientData clientData, Tcl_Interp *interp,
 		      int objc, Tcl_Obj *CONST objv[])
 {
   static const char *commands[] =
-    {"create", "list", NULL};
+    {"create", "list", "update_all", NULL};
   enum commands_enum
     {
-      VARIABLE_CREATE, VARIABLE_LIST
+      VARIABLE_CREATE, VARIABLE_LIST, VARIABLE_UPDATE_ALL
     };
   int index, result;
 
@@ -149,6 +160,10 @@ gdb_variable_command (ClientData clientData, Tcl_Interp *interp,
       result = variable_create (interp, objc - 2, objv + 2);
       break;
 
+    case VARIABLE_UPDATE_ALL:
+      result = variable_update_all (interp, objc - 2, objv + 2);
+      break;
+
     default:
       return TCL_ERROR;
     }
@@ -164,6 +179,7 @@ gdb_variable_command (ClientData clientData, Tcl_Interp *interp,
    - update        update the variable and its children (root vars only)
    - numChildren   how many children does this object have
    - children      create the children and return a list of their objects
+                   (-from N and -to M ask for children N up to M only)
    - name          print out the name of this variable
    - format        query/set the display format of this variable
    - type          get the type of this variable
@@ -245,10 +261,7 @@ variable_obj_command (ClientData clientData, Tcl_Interp *interp,
       break;
 
     case VARIABLE_CHILDREN:
-      {
-	Tcl_Obj *children = variable_children (interp, var);
-	Tcl_SetObjResult (interp, children);
-      }
+      result = variable_children (interp, objc, objv, var);
       break;
 
     case VARIABLE_FORMAT:
@@ -433,25 +446,64 @@ variable_delete (Tcl_Interp *interp, struct varobj *var,
   varobj_delete (var, only_children_p);
 }
 
-/* Return a list of all the children of VAR, creating them if necessary. */
-static Tcl_Obj *
-variable_children (Tcl_Interp *interp, struct varobj *var)
+/* This implements the children object command, which returns a list of
+   the children of VAR, creating them if necessary.
+
+   With "-from N", the list starts with child N, and with "-to M", it
+   stops before child M.  Only those children get a Tcl command, so an
+   array with a million elements can be shown a page at a time.  */
+static int
+variable_children (Tcl_Interp *interp, int objc,
+		   Tcl_Obj *CONST objv[], struct varobj *var)
 {
+  static const char *switches[] = {"-from", "-to", NULL};
+  enum switches_opts { SWITCH_FROM, SWITCH_TO };
   Tcl_Obj *list;
   VEC(varobj_p) *children;
   struct varobj *child;
   const char *childname;
-  int ix, from, to;
-
-  list = Tcl_NewListObj (0, NULL);
+  int i, ix, from, to;
 
   from = -1;
   to = -1;
+  for (i = 2; i < objc; i += 2)
+    {
+      int index, n;
+
+      if (Tcl_GetIndexFromObj (interp, objv[i], switches, "option", 0,
+			       &index) != TCL_OK)
+	return TCL_ERROR;
+      if (i + 1 == objc)
+	{
+	  Tcl_WrongNumArgs (interp, 2, objv, "?-from first? ?-to last?");
+	  return TCL_ERROR;
+	}
+      if (Tcl_GetIntFromObj (interp, objv[i + 1], &n) != TCL_OK)
+	return TCL_ERROR;
+      if (n < 0)
+	n = 0;
+
+      if ((enum switches_opts) index == SWITCH_FROM)
+	from = n;
+      else
+	to = n;
+    }
+
+  /* gdb only honors a range with both ends.  */
+  if (from >= 0 && to < 0)
+    to = varobj_get_num_children (var);
+  else if (to >= 0 && from < 0)
+    from = 0;
+
+  list = Tcl_NewListObj (0, NULL);
 
   children = varobj_list_children (var, &from, &to);
 
   for (ix = from; ix < to && VEC_iterate (varobj_p, children, ix, child); ++ix)
     {
+      if (child == NULL)
+	continue;
+
       childname = varobj_get_objname (child);
       /* Add child to result list and install the Tcl command for it. */
       Tcl_ListObjAppendElement (NULL, list,
@@ -459,7 +511,8 @@ variable_children (Tcl_Interp *interp, struct varobj *var)
       install_variable (interp, childname);
     }
 
-  return list;
+  Tcl_SetObjResult (interp, list);
+  return TCL_OK;
 }
 
 /* Update the values for a variable and its children. */
@@ -499,6 +552,161 @@ variable_update (Tcl_Interp *interp, struct varobj **var)
   return changed;
 }
 
+/* A record of what an update did to a variable object, as listed by
+   variable_update_all.  */
+
+static void
+variable_update_record (Tcl_Obj *list, struct varobj *var,
+			const char *status, const char *value,
+			const char *type)
+{
+  Tcl_ListObjAppendElement (NULL, list,
+			    Tcl_NewStringObj (varobj_get_objname (var), -1));
+  Tcl_ListObjAppendElement (NULL, list, Tcl_NewStringObj (status, -1));
+  Tcl_ListObjAppendElement (NULL, list, Tcl_NewStringObj (value, -1));
+  Tcl_ListObjAppendElement (NULL, list, Tcl_NewStringObj (type, -1));
+}
+
+/* Whether VAR is shown, that is whether all its ancestors are in
+   OPEN.  */
+
+static bool
+variable_shown_p (struct varobj *var,
+		  const std::unordered_set<std::string> &open)
+{
+  for (var = var->parent; var != NULL; var = var->parent)
+    if (open.find (var->obj_name) == open.end ())
+      return false;
+  return true;
+}
+
+static void
+variable_collect_root (struct varobj *var, void *data)
+{
+  ((std::vector<struct varobj *> *) data)->push_back (var);
+}
+
+/* Update the given root variable objects, all of them by default, and
+   list what changed.  The result is a flat list of records of four
+   elements: the name of the variable object, its status, its value and
+   its type.  The status is one of:
+
+   changed      - VALUE is its new value, printed as by "print"; TYPE is
+                  its new type when that changed too, otherwise "".
+   error        - its value could not be read: VALUE says why.  A root
+                  which could not be updated at all is listed so, with
+                  an empty VALUE.
+   out_of_scope - it is not in scope any more.
+   invalid      - it cannot be evaluated any more.
+
+   With -open, only the variable objects whose parents are all among
+   VAROBJS are listed, besides the roots: the children of a closed node
+   are not shown, so their values are not worth printing.  */
+
+static int
+variable_update_all (Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
+{
+  std::unordered_set<std::string> open;
+  std::vector<struct varobj *> roots;
+  bool filter = false;
+  Tcl_Obj *result;
+  int i;
+
+  if (objc > 0 && strcmp (Tcl_GetString (objv[0]), "-open") == 0)
+    {
+      Tcl_Obj **names;
+      int nnames;
+
+      if (objc < 2)
+	{
+	  gdbtk_set_result (interp, "-open requires a list of varobjs");
+	  return TCL_ERROR;
+	}
+      if (Tcl_ListObjGetElements (interp, objv[1], &nnames, &names)
+	  != TCL_OK)
+	{
+	  result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+	  return TCL_ERROR;
+	}
+      for (i = 0; i < nnames; i++)
+	open.insert (Tcl_GetString (names[i]));
+      filter = true;
+      objc -= 2;
+      objv += 2;
+    }
+
+  if (objc == 0)
+    all_root_varobjs (variable_collect_root, &roots);
+  for (i = 0; i < objc; i++)
+    {
+      struct varobj *var = NULL;
+
+      TRY
+	{
+	  var = varobj_get_handle (Tcl_GetString (objv[i]));
+	}
+      CATCH (except, RETURN_MASK_ERROR)
+	{
+	  gdbtk_set_result (interp, "%s", except.message);
+	  return TCL_ERROR;
+	}
+      END_CATCH
+
+      roots.push_back (var);
+    }
+
+  result = Tcl_NewListObj (0, NULL);
+  for (struct varobj *root : roots)
+    {
+      VEC (varobj_update_result) *changes = NULL;
+      varobj_update_result *r;
+
+      if (GDB_varobj_update (&root, 1, &changes) != GDB_OK)
+	{
+	  variable_update_record (result, root, "error", "", "");
+	  continue;
+	}
+
+      for (i = 0; VEC_iterate (varobj_update_result, changes, i, r); ++i)
+	{
+	  if (filter && !variable_shown_p (r->varobj, open))
+	    continue;
+
+	  switch (r->status)
+	    {
+	    case VAROBJ_IN_SCOPE:
+	      {
+		std::string value, type;
+
+		if (r->type_changed)
+		  type = varobj_get_type (r->varobj);
+		if (variable_print_value (r->varobj, value))
+		  variable_update_record (result, r->varobj, "changed",
+					  value.c_str (), type.c_str ());
+		else
+		  variable_update_record (result, r->varobj, "error",
+					  value.c_str (), type.c_str ());
+	      }
+	      break;
+
+	    case VAROBJ_NOT_IN_SCOPE:
+	      variable_update_record (result, r->varobj, "out_of_scope",
+				      "", "");
+	      break;
+
+	    case VAROBJ_INVALID:
+	      variable_update_record (result, r->varobj, "invalid", "", "");
+	      break;
+	    }
+	}
+      VEC_free (varobj_update_result, changes);
+    }
+
+  Tcl_SetObjResult (interp, result);
+  result_ptr->flags |= GDBTK_IN_TCL_RESULT;
+  return TCL_OK;
+}
+
 /* This implements the format object command allowing
    the querying or setting of the object's display format. */
 static int
@@ -638,10 +846,28 @@ variable_value (Tcl_Interp *interp, int objc,
 static int
 variable_print (Tcl_Interp *interp, int objc,
 		Tcl_Obj *CONST objv[], struct varobj *var)
+{
+  std::string text;
+
+  if (!variable_print_value (var, text))
+    {
+      gdbtk_set_result (interp, "%s", text.c_str ());
+      return TCL_ERROR;
+    }
+
+  Tcl_SetObjResult (interp, Tcl_NewStringObj (text.c_str (), -1));
+  return TCL_OK;
+}
+
+/* Helper functions for the above */
+
+/* Print the value of VAR into TEXT, in its display format.  Return
+   zero, with TEXT saying why, if it could not be read.  */
+static int
+variable_print_value (struct varobj *var, std::string &text)
 {
   string_file stream;
-  int ret = TCL_ERROR;
-  volatile struct gdb_exception except;
+  int ok = 0;
 
   TRY
     {
@@ -651,20 +877,19 @@ variable_print (Tcl_Interp *interp, int objc,
       opts.deref_ref = 1;
       opts.raw = 0;
       common_val_print (var->value, &stream, 0, &opts, current_language);
-      Tcl_SetObjResult (interp, Tcl_NewStringObj (stream.data (), -1));
-      ret = TCL_OK;
+      text = stream.string ();
+      ok = 1;
     }
   CATCH (except, RETURN_MASK_ERROR)
     {
-      gdbtk_set_result (interp, "<error reading variable: %s>", except.message);
+      text = string_printf ("<error reading variable: %s>",
+			    except.message);
     }
   END_CATCH
 
-  return ret;
+  return ok;
 }
 
-/* Helper functions for the above */
-
 /* Install the given variable VAR into the tcl interpreter with
    the object name NAME. */
 static void
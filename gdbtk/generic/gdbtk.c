@@ -78,16 +78,39 @@
 extern void _initialize_gdbtk (void);
 
 #ifndef __MINGW32__
-/* For unix natives, we use a timer to periodically keep the gui alive.
+/* For unix natives, signals keep the gui alive while the target runs.
    See comments before x_event. */
 static sigset_t nullsigmask;
 static struct sigaction act1, act2;
 static struct itimerval it_on, it_off;
 
+#if defined (O_ASYNC) && defined (F_SETOWN)
+/* Where we can, the signals are only sent when the gui has something to
+   do: SIGIO when a file Tcl watches (the connection to the X server,
+   for one) becomes readable, and SIGALRM when the next Tcl timer is
+   due.  Elsewhere, SIGALRM is sent periodically.  */
+#define GDBTK_SIGIO_WAKEUP 1
+
+/* SIGIO is only sent when more input arrives, so when x_event could not
+   run, SIGALRM is sent again after this many microseconds.  */
+#define GDBTK_WAKEUP_RETRY 50000
+
+static struct sigaction old_sigio;
+
+static void gdbtk_wakeup_timer (long max_usec);
+#endif
+
 static void
 x_event_wrapper (int signo)
 {
+  int saved_errno = errno;
+
   x_event (signo);
+#ifdef GDBTK_SIGIO_WAKEUP
+  if (gdbtk_x_event_deferred)
+    gdbtk_wakeup_timer (GDBTK_WAKEUP_RETRY);
+#endif
+  errno = saved_errno;
 }
 #endif
 
@@ -266,6 +289,9 @@ struct _gdbtk_notifier_file_data
     int readymask;                      /* Pending mask. */
     Tcl_FileProc *proc;                 /* Tcl callback procedure. */
     ClientData clientData;              /* Tcl client data. */
+    int async_flags;                    /* File flags before O_ASYNC was
+                                           set, or -1. */
+    int async_owner;                    /* Owner before F_SETOWN. */
   };
 
 /* Notifier data. */
@@ -275,6 +301,8 @@ static struct
     gdbtk_notifier_file_data *filelist; /* List of gdbtk_notifier_file_data. */
     struct async_event_handler *schedule; /* Gdb event to tcl event loop. */
     int timer_id;                       /* Active timer or 0. */
+    int deadline_set;                   /* A Tcl timer is pending. */
+    struct timeval deadline;            /* When it is due. */
     int service_mode;                   /* Current service mode. */
     int in_tcl;                         /* Tcl currently executing. */
     int redispatch;                     /* Tcl needs redispatching. */
@@ -404,6 +432,65 @@ gdbtk_notifier_file_proc (int error, gdb_client_data clientData)
     }
 }
 
+#ifdef GDBTK_SIGIO_WAKEUP
+/* Have SIGIO sent when the file of DATA becomes readable, or put its
+   flags and owner back as they were. */
+static void
+gdbtk_wakeup_fd (gdbtk_notifier_file_data *data, int on)
+{
+  if (on)
+    {
+      int flags;
+
+      if (data->async_flags != -1)
+        return;
+      flags = fcntl (data->fd, F_GETFL);
+      if (flags == -1)
+        return;
+      data->async_flags = flags;
+      data->async_owner = fcntl (data->fd, F_GETOWN);
+      fcntl (data->fd, F_SETOWN, getpid ());
+      fcntl (data->fd, F_SETFL, flags | O_ASYNC);
+    }
+  else if (data->async_flags != -1)
+    {
+      fcntl (data->fd, F_SETFL, data->async_flags);
+      if (data->async_owner != -1)
+        fcntl (data->fd, F_SETOWN, data->async_owner);
+      data->async_flags = -1;
+    }
+}
+
+/* While the target runs, have SIGALRM sent when the next Tcl timer is
+   due, or after MAX_USEC microseconds at the latest if it is not 0. */
+static void
+gdbtk_wakeup_timer (long max_usec)
+{
+  struct itimerval it = it_off;
+  long usec = max_usec;
+
+  if (!gdbtk_timer_going)
+    return;
+
+  if (gdbtk_notifier_data.deadline_set)
+    {
+      struct timeval now;
+      long due;
+
+      gettimeofday (&now, NULL);
+      due = ((gdbtk_notifier_data.deadline.tv_sec - now.tv_sec) * 1000000L
+	     + gdbtk_notifier_data.deadline.tv_usec - now.tv_usec);
+      if (due <= 0)
+	due = 1;
+      if (usec == 0 || due < usec)
+	usec = due;
+    }
+  it.it_value.tv_sec = usec / 1000000;
+  it.it_value.tv_usec = usec % 1000000;
+  setitimer (ITIMER_REAL, &it, NULL);
+}
+#endif
+
 /* Timer has elapsed. */
 static void
 gdbtk_notifier_timeout (gdb_client_data clientData)
@@ -429,7 +516,21 @@ gdbtk_notifier_set_timer (CONST86 Tcl_Time *timeptr)
       gdbtk_notifier_data.timer_id = create_timer (msec,
                                                    gdbtk_notifier_timeout,
                                                    (gdb_client_data) NULL);
+
+      /* Remember when, for the target runs. */
+      gettimeofday (&gdbtk_notifier_data.deadline, NULL);
+      gdbtk_notifier_data.deadline.tv_sec += timeptr->sec;
+      gdbtk_notifier_data.deadline.tv_usec += timeptr->usec;
+      if (gdbtk_notifier_data.deadline.tv_usec >= 1000000)
+        {
+          gdbtk_notifier_data.deadline.tv_usec -= 1000000;
+          gdbtk_notifier_data.deadline.tv_sec++;
+        }
     }
+  gdbtk_notifier_data.deadline_set = timeptr != NULL;
+#ifdef GDBTK_SIGIO_WAKEUP
+  gdbtk_wakeup_timer (0);
+#endif
 }
 
 /* Tcl notifier procedure to wait for an event.
@@ -477,6 +578,9 @@ gdbtk_notifier_delete_file_handler (int fd)
   delete_file_handler (fd);
   if (data)
     {
+#ifdef GDBTK_SIGIO_WAKEUP
+      gdbtk_wakeup_fd (data, 0);
+#endif
       /* Release associated data. */
       *dataptr = data->next;
       xfree (data);
@@ -510,10 +614,15 @@ gdbtk_notifier_create_file_handler (int fd, int tclmask, Tcl_FileProc *proc,
   data->proc = proc;
   data->mask = tclmask;
   data->clientData = clientData;
+  data->async_flags = -1;
   data->next = gdbtk_notifier_data.filelist;
   gdbtk_notifier_data.filelist = data;
   add_file_handler (fd, gdbmask,
                     gdbtk_notifier_file_proc, (gdb_client_data) data);
+#ifdef GDBTK_SIGIO_WAKEUP
+  if (gdbtk_timer_going && (tclmask & TCL_READABLE))
+    gdbtk_wakeup_fd (data, 1);
+#endif
 }
 
 /* Tcl notifier procedure to initialize the notifier. */
@@ -621,7 +730,7 @@ gdbtk_interactive (void)
   /* Tk_DoOneEvent (TK_DONT_WAIT|TK_IDLE_EVENTS); */
 }
 
-/* Start a timer which will keep the GUI alive while in target_wait. */
+/* Start the signals which will keep the GUI alive while in target_wait. */
 void
 gdbtk_start_timer (void)
 {
@@ -658,17 +767,29 @@ gdbtk_start_timer (void)
     {
       if (!gdbtk_timer_going)
 	{
-#ifndef __MINGW32__
+	  gdbtk_timer_going = 1;
+#ifdef GDBTK_SIGIO_WAKEUP
+	  {
+	    gdbtk_notifier_file_data *data;
+
+	    sigaction (SIGIO, &act1, &old_sigio);
+	    for (data = gdbtk_notifier_data.filelist; data; data = data->next)
+	      if (data->mask & TCL_READABLE)
+		gdbtk_wakeup_fd (data, 1);
+
+	    sigaction (SIGALRM, &act1, NULL);
+	    gdbtk_wakeup_timer (0);
+	  }
+#elif !defined (__MINGW32__)
 	  sigaction (SIGALRM, &act1, NULL);
 	  setitimer (ITIMER_REAL, &it_on, NULL);
 #endif
-	  gdbtk_timer_going = 1;
 	}
     }
   return;
 }
 
-/* Stop the timer if it is running. */
+/* Stop the signals if they are running. */
 void
 gdbtk_stop_timer (void)
 {
@@ -678,6 +799,15 @@ gdbtk_stop_timer (void)
 #ifndef __MINGW32__
       setitimer (ITIMER_REAL, &it_off, NULL);
       sigaction (SIGALRM, &act2, NULL);
+#endif
+#ifdef GDBTK_SIGIO_WAKEUP
+      {
+	gdbtk_notifier_file_data *data;
+
+	for (data = gdbtk_notifier_data.filelist; data; data = data->next)
+	  gdbtk_wakeup_fd (data, 0);
+	sigaction (SIGIO, &old_sigio, NULL);
+      }
 #endif
     }
   return;
@@ -149,6 +149,9 @@ extern int gdb_context;
    x_event and gdb_stop. */
 extern int gdbtk_force_detach;
 
+/* Set when x_event could not run the event loop. */
+extern volatile int gdbtk_x_event_deferred;
+
 /*
  * These functions are used in all the modules of Gdbtk.
  *
@@ -162,10 +165,37 @@ extern void gdbtk_ignorable_warning (const char *, const char *);
 extern void gdbtk_interactive (void);
 extern int x_event (int);
 extern int gdbtk_two_elem_cmd (char *, const char *);
+extern void gdbtk_output_flush (void);
+extern int gdbtk_output_line_limit;
+
+/* Counters of the console output buffer, see gdb_console_output.  */
+struct gdbtk_output_stats
+{
+  unsigned long writes;
+  unsigned long flushes;
+  unsigned long bytes;
+  unsigned long dropped;
+};
+extern struct gdbtk_output_stats gdbtk_output_stats;
 extern int target_is_native (struct target_ops *t);
 extern struct ui_file *gdbtk_fileopen (void);
 extern bool gdbtk_disable_write;
 extern ptid_t gdbtk_get_ptid (void);
+extern void gdbtk_memory_journal_add (CORE_ADDR addr, ULONGEST len);
+extern void gdbtk_memory_cache_flush (void);
+extern void gdbtk_disassembly_cancel_all (void);
+extern void gdbtk_disassembly_cache_flush (void);
+extern void gdbtk_disassembly_cache_forget (struct objfile *objfile);
+extern void gdbtk_disassembly_cache_invalidate (CORE_ADDR addr, ULONGEST len);
+extern void gdbtk_disassembly_cache_param (const char *param,
+					   const char *value);
+extern void gdbtk_source_cache_forget (struct objfile *objfile);
+extern void gdbtk_symbol_index_flush (void);
+extern void gdbtk_function_tables_flush (void);
+extern void gdbtk_stack_cache_flush (void);
+extern void gdbtk_register_cache_flush (void);
+extern void gdbtk_breakpoint_index_flush (void);
+extern void gdbtk_breakpoint_events_flush (void);
 
 #ifdef _WIN32
 extern void close_bfds (void);
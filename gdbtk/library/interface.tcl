@@ -500,13 +500,33 @@ proc gdbtk_tcl_end_variable_annotation {} {
   debug [info level 0]
 }
 
+# ------------------------------------------------------------------
+# PROC: gdbtk_tcl_breakpoints - Breakpoints and tracepoints were
+#                               changed -- notify gui.  EVENTS is a
+#                               list of {kind action number info}.
+# ------------------------------------------------------------------
+proc gdbtk_tcl_breakpoints {events} {
+#  debug "BREAKPOINTS: $events"
+
+  # For more than a handful of events, fetch all the breakpoints at
+  # once rather than one event at a time.
+  if {[llength $events] > 16} {
+    bp_snapshot
+  }
+  foreach event $events {
+    lassign $event kind action number info
+    gdbtk_tcl_$kind $action $number $info
+  }
+}
+
 # ------------------------------------------------------------------
 # PROC: gdbtk_tcl_breakpoint - A breakpoint was changed -- notify
 #                               gui.
 # ------------------------------------------------------------------
-proc gdbtk_tcl_breakpoint {action bpnum} {
+proc gdbtk_tcl_breakpoint {action bpnum {info {}}} {
 #  debug "BREAKPOINT: $action $bpnum"
-  set e [BreakpointEvent \#auto -action $action -number $bpnum]
+  set e [BreakpointEvent \#auto -action $action -number $bpnum \
+	   -bpinfo $info]
   GDBEventHandler::dispatch $e
   delete object $e
 }
@@ -515,9 +535,10 @@ proc gdbtk_tcl_breakpoint {action bpnum} {
 # PROC: gdbtk_tcl_tracepoint - A tracepoint was changed -- notify
 #                               gui.
 # ------------------------------------------------------------------
-proc gdbtk_tcl_tracepoint {action tpnum} {
+proc gdbtk_tcl_tracepoint {action tpnum {info {}}} {
 #  debug "TRACEPOINT: $action $tpnum"
-  set e [TracepointEvent \#auto -action $action -number $tpnum]
+  set e [TracepointEvent \#auto -action $action -number $tpnum \
+	   -tpinfo $info]
   GDBEventHandler::dispatch $e
   delete object $e
 }
@@ -372,6 +372,18 @@ proc pref_set_defaults {} {
 
   pref define gdb/src/disassembly-flavor  ""
 
+  # Number of lines of disassembly loaded at a time; the rest of a
+  # function is appended in the background.  0 loads it all at once.
+
+  pref define gdb/src/disassembly-chunk   500
+
+  # Most characters of source and disassembly kept in the (hidden)
+  # views all the source windows cache, and most bytes of source files
+  # kept in memory for them.
+
+  pref define gdb/src/cache-size          4000000
+  pref define gdb/src/file-cache-size     16000000
+
   # Variable Window defaults
   pref define gdb/variable/font           global/fixed
   pref define gdb/variable/disabled_fg    gray
@@ -52,8 +52,8 @@ namespace eval Session {
       set debugging_gdb 0
     }
 
-    foreach bp_num [gdb_get_breakpoint_list] {
-      lassign [gdb_get_breakpoint_info $bp_num] file function line_number \
+    foreach {bp_num info} [lindex [bp_snapshot] 0] {
+      lassign $info file function line_number \
 	address type enabled disposition ignore_count command_list \
 	condition thread hit_count user_specification
 
@@ -117,31 +117,37 @@ namespace eval Session {
   # An internal function used when loading sessions.  It takes a
   # breakpoint string and recreates all the breakpoints.
   proc _recreate_bps {specs} {
-    foreach spec $specs {
-      lassign $spec create enabled condition commands
-
-      # Create the breakpoint
-      if {[catch {gdb_cmd $create} txt]} {
-	dbug W $txt
-      }
+    # Have the windows learn about all the breakpoints at once.
+    gdb_breakpoint_events suspend
+    set code [catch {
+      foreach spec $specs {
+	lassign $spec create enabled condition commands
+
+	# Create the breakpoint
+	if {[catch {gdb_cmd $create} txt]} {
+	  dbug W $txt
+	}
 
-      # Below we use `\$bpnum'.  This means we don't have to figure out
-      # the number of the breakpoint when doing further manipulations.
+	# Below we use `\$bpnum'.  This means we don't have to figure out
+	# the number of the breakpoint when doing further manipulations.
 
-      if {! $enabled} {
-	gdb_cmd "disable \$bpnum"
-      }
+	if {! $enabled} {
+	  gdb_cmd "disable \$bpnum"
+	}
 
-      if {$condition != ""} {
-	gdb_cmd "cond \$bpnum $condition"
-      }
+	if {$condition != ""} {
+	  gdb_cmd "cond \$bpnum $condition"
+	}
 
-      if {[llength $commands]} {
-	lappend commands end
-	eval gdb_run_readline_command_no_output [list "commands \$bpnum"] \
-	  $commands
+	if {[llength $commands]} {
+	  lappend commands end
+	  eval gdb_run_readline_command_no_output [list "commands \$bpnum"] \
+	    $commands
+	}
       }
-    }
+    } result]
+    gdb_breakpoint_events resume
+    return -code $code $result
   }
 
   #
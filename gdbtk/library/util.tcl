@@ -162,6 +162,62 @@ proc gdbtk_read_defs {} {
   return 1
 }
 
+# ------------------------------------------------------------------
+#  PROCEDURE:  bp_snapshot
+#            Returns a list {breakpoints tracepoints} of the flat
+#            number/info lists reported by gdb_get_breakpoints.  The
+#            snapshot is kept and only fetched again once gdb reports
+#            that the breakpoints changed.
+# ------------------------------------------------------------------
+proc bp_snapshot {} {
+  global _bp_snapshot _bp_info _tp_info
+
+  if {![info exists _bp_snapshot(generation)]} {
+    set _bp_snapshot(generation) 0
+  }
+
+  set snap [gdb_get_breakpoints -since $_bp_snapshot(generation)]
+  if {[llength $snap] > 1} {
+    lassign $snap _bp_snapshot(generation) _bp_snapshot(breakpoints) \
+      _bp_snapshot(tracepoints)
+    catch {unset _bp_info}
+    catch {unset _tp_info}
+    array set _bp_info $_bp_snapshot(breakpoints)
+    array set _tp_info $_bp_snapshot(tracepoints)
+  }
+
+  return [list $_bp_snapshot(breakpoints) $_bp_snapshot(tracepoints)]
+}
+
+# ------------------------------------------------------------------
+#  PROCEDURE:  bp_info
+#            Returns what gdb_get_breakpoint_info (or, if TRACEPOINT is
+#            set, gdb_get_tracepoint_info) returns for BPNUM.  This is
+#            taken from the last bp_snapshot while it is still current.
+# ------------------------------------------------------------------
+proc bp_info {bpnum {tracepoint 0}} {
+  global _bp_snapshot _bp_info _tp_info
+
+  if {[info exists _bp_snapshot(generation)]
+      && $_bp_snapshot(generation) == [gdb_breakpoint_generation]} {
+    if {$tracepoint} {
+      if {[info exists _tp_info($bpnum)]} {
+	return $_tp_info($bpnum)
+      }
+    } elseif {[info exists _bp_info($bpnum)]} {
+      return $_bp_info($bpnum)
+    }
+  }
+
+  # Either the snapshot is stale, or there is no such point and the
+  # command below reports the error.  Do not take a whole new snapshot
+  # for a single lookup.
+  if {$tracepoint} {
+    return [gdb_get_tracepoint_info $bpnum]
+  }
+  return [gdb_get_breakpoint_info $bpnum]
+}
+
 # ------------------------------------------------------------------
 #  PROCEDURE:  bp_exists
 #            Returns BPNUM if a breakpoint exists at LINESPEC or
@@ -171,9 +227,7 @@ proc bp_exists {linespec} {
 
   lassign $linespec foo function filename line_number addr pc_addr
 
-  set bps [gdb_get_breakpoint_list]
-  foreach bpnum $bps {
-    set bpinfo [gdb_get_breakpoint_info $bpnum]
+  foreach {bpnum bpinfo} [lindex [bp_snapshot] 0] {
     lassign $bpinfo file func line pc type enabled disposition \
       ignore_count commands cond thread hit_count user_specification
     if {$filename == $file && $function == $func && $addr == $pc} {
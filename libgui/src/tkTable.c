@@ -42,6 +42,8 @@ static void	TableEventProc _ANSI_ARGS_((ClientData clientData,
 static void	TableCmdDeletedProc _ANSI_ARGS_((ClientData clientData));
 
 static void	TableRedrawHighlight _ANSI_ARGS_((Table *tablePtr));
+static int	TableScrollBlit _ANSI_ARGS_((Table *tablePtr,
+			int oldTop, int oldLeft));
 static void	TableGetGc _ANSI_ARGS_((Display *display, Drawable d,
 			TableTag *tagPtr, GC *tagGc));
 
@@ -78,8 +80,8 @@ static const char *commandNames[] = {
     "postscript",
 #endif
     "reread", "scan", "see", "selection", "set",
-    "spans", "tag", "validate", "version", "window", "width",
-    "xview", "yview", (char *)NULL
+    "spans", "stats", "store", "tag", "validate", "version", "window",
+    "width", "xview", "yview", (char *)NULL
 };
 enum command {
     CMD_ACTIVATE, CMD_BBOX, CMD_BORDER, CMD_CGET, CMD_CLEAR, CMD_CONFIGURE,
@@ -89,8 +91,8 @@ enum command {
     CMD_POSTSCRIPT,
 #endif
     CMD_REREAD, CMD_SCAN, CMD_SEE, CMD_SELECTION, CMD_SET,
-    CMD_SPANS, CMD_TAG, CMD_VALIDATE, CMD_VERSION, CMD_WINDOW, CMD_WIDTH,
-    CMD_XVIEW, CMD_YVIEW
+    CMD_SPANS, CMD_STATS, CMD_STORE, CMD_TAG, CMD_VALIDATE, CMD_VERSION,
+    CMD_WINDOW, CMD_WIDTH, CMD_XVIEW, CMD_YVIEW
 };
 
 /* -selecttype selection type options */
@@ -152,6 +154,14 @@ static Cmd_Struct stretch_vals[] = {
     {"", 0}
 };
 
+/* -datastore native cell store layouts */
+static Cmd_Struct store_vals[]= {
+    {"none",	 STORE_NONE},
+    {"dense",	 STORE_DENSE},
+    {"sparse",	 STORE_SPARSE},
+    {"",	 0 }
+};
+
 static Cmd_Struct state_vals[]= {
     {"normal",	 STATE_NORMAL},
     {"disabled", STATE_DISABLED},
@@ -169,6 +179,8 @@ static Tk_CustomOption selTypeOpt	= { Cmd_OptionSet, Cmd_OptionGet,
 					    (ClientData)(&sel_vals) };
 static Tk_CustomOption stateTypeOpt	= { Cmd_OptionSet, Cmd_OptionGet,
 					    (ClientData)(&state_vals) };
+static Tk_CustomOption storeOpt		= { Cmd_OptionSet, Cmd_OptionGet,
+					    (ClientData)(&store_vals) };
 static Tk_CustomOption bdOpt		= { TableOptionBdSet, TableOptionBdGet,
 					    (ClientData) BD_TABLE };
 
@@ -207,6 +219,8 @@ Tk_ConfigSpec tableSpecs[] = {
      Tk_Offset(Table, command), TK_CONFIG_NULL_OK},
     {TK_CONFIG_ACTIVE_CURSOR, "-cursor", "cursor", "Cursor", "xterm",
      Tk_Offset(Table, cursor), TK_CONFIG_NULL_OK },
+    {TK_CONFIG_CUSTOM, "-datastore", "dataStore", "DataStore", "none",
+     Tk_Offset(Table, storeMode), 0, &storeOpt },
     {TK_CONFIG_CUSTOM, "-drawmode", "drawMode", "DrawMode", "compatible",
      Tk_Offset(Table, drawMode), 0, &drawOpt },
     {TK_CONFIG_BOOLEAN, "-exportselection", "exportSelection",
@@ -329,7 +343,7 @@ static const char *updateOpts[] = {
     "-anchor",		"-background",	"-bg",		"-bd",
     "-borderwidth",	"-cache",	"-command",	"-colorigin",
     "-cols",		"-colstretchmode",		"-coltagcommand",
-    "-drawmode",	"-fg",		"-font",	"-foreground",
+    "-datastore",	"-drawmode",	"-fg",		"-font",	"-foreground",
     "-hasprocs",	"-height",	"-highlightbackground",
     "-highlightcolor",	"-highlightthickness",		"-insertbackground",
     "-insertborderwidth",		"-insertwidth",	"-invertselected",
@@ -507,6 +521,7 @@ Tk_TableObjCmd(clientData, interp, objc, objv)
     tablePtr->seen[0]		= -1;
 
     tablePtr->dataSource	= DATA_NONE;
+    tablePtr->store.mode	= STORE_NONE;
     tablePtr->activeBuf		= ckalloc(1);
     *(tablePtr->activeBuf)	= '\0';
 
@@ -831,6 +846,14 @@ TableWidgetObjCmd(clientData, interp, objc, objv)
 	    result = Table_SpanCmd(clientData, interp, objc, objv);
 	    break;
 
+	case CMD_STATS:
+	    result = Table_StatsCmd(clientData, interp, objc, objv);
+	    break;
+
+	case CMD_STORE:
+	    result = Table_StoreCmd(clientData, interp, objc, objv);
+	    break;
+
 	case CMD_TAG:
 	    result = Table_TagCmd(clientData, interp, objc, objv);
 	    break;
@@ -916,16 +939,17 @@ TableDestroy(ClientData clientdata)
 		(Tcl_VarTraceProc *)TableVarProc, (ClientData) tablePtr);
     }
 
-    /* free the int arrays */
-    if (tablePtr->colPixels) ckfree((char *) tablePtr->colPixels);
-    if (tablePtr->rowPixels) ckfree((char *) tablePtr->rowPixels);
-    if (tablePtr->colStarts) ckfree((char *) tablePtr->colStarts);
-    if (tablePtr->rowStarts) ckfree((char *) tablePtr->rowStarts);
+    /* free the row and column geometry */
+    TableGeomFree(&(tablePtr->colGeom));
+    TableGeomFree(&(tablePtr->rowGeom));
 
     /* delete cached active tag and string */
     if (tablePtr->activeTagPtr) ckfree((char *) tablePtr->activeTagPtr);
     if (tablePtr->activeBuf != NULL) ckfree(tablePtr->activeBuf);
 
+    /* release the native store */
+    TableStoreFree(tablePtr);
+
     /* delete the cache, row, column and cell style hash tables */
     Tcl_DeleteHashTable(tablePtr->cache);
     ckfree((char *) (tablePtr->cache));
@@ -964,6 +988,16 @@ TableDestroy(ClientData clientdata)
 	TableCleanupTag(tablePtr, (TableTag *) Tcl_GetHashValue(entryPtr));
 	ckfree((char *) Tcl_GetHashValue(entryPtr));
     }
+    if (tablePtr->scrollGc != NULL) {
+	Tk_FreeGC(tablePtr->display, tablePtr->scrollGc);
+    }
+
+    /* free up the cached styles, which use the tags */
+    if (tablePtr->styleTable) {
+	TableFlushStyles(tablePtr);
+	Tcl_DeleteHashTable(tablePtr->styleTable);
+	ckfree((char *) (tablePtr->styleTable));
+    }
     /* free up the stuff in the default tag */
     TableCleanupTag(tablePtr, &(tablePtr->defaultTag));
     /* And delete the actual hash table */
@@ -1019,7 +1053,7 @@ TableConfigure(interp, tablePtr, objc, objv, flags, forceUpdate)
 				 * for initial configuration */
 {
     Tcl_HashSearch search;
-    int oldUse, oldCaching, oldExport, oldTitleRows, oldTitleCols;
+    int oldUse, oldCaching, oldExport, oldTitleRows, oldTitleCols, oldStore;
     int result = TCL_OK;
     char *oldVar = NULL, **argv;
     Tcl_DString error;
@@ -1028,6 +1062,7 @@ TableConfigure(interp, tablePtr, objc, objv, flags, forceUpdate)
     oldExport	= tablePtr->exportSelection;
     oldCaching	= tablePtr->caching;
     oldUse	= tablePtr->useCmd;
+    oldStore	= tablePtr->storeMode;
     oldTitleRows	= tablePtr->titleRows;
     oldTitleCols	= tablePtr->titleCols;
     if (tablePtr->arrayVar != NULL) {
@@ -1040,6 +1075,8 @@ TableConfigure(interp, tablePtr, objc, objv, flags, forceUpdate)
     result = Tk_ConfigureWidget(interp, tablePtr->tkwin, tableSpecs,
 	    objc, (CONST84 char **) argv, (char *) tablePtr, flags);
     ckfree((char *) argv);
+    /* the table defaults are part of every cached style */
+    TableFlushStyles(tablePtr);
     if (result != TCL_OK) {
 	return TCL_ERROR;
     }
@@ -1048,13 +1085,19 @@ TableConfigure(interp, tablePtr, objc, objv, flags, forceUpdate)
 
     /* Any time we configure, reevaluate what our data source is */
     tablePtr->dataSource = DATA_NONE;
-    if (tablePtr->caching) {
-	tablePtr->dataSource |= DATA_CACHE;
-    }
-    if (tablePtr->command && tablePtr->useCmd) {
-	tablePtr->dataSource |= DATA_COMMAND;
-    } else if (tablePtr->arrayVar) {
-	tablePtr->dataSource |= DATA_ARRAY;
+    if (tablePtr->storeMode == STORE_DENSE ||
+	tablePtr->storeMode == STORE_SPARSE) {
+	/* the native store stands in for all the others */
+	tablePtr->dataSource = DATA_STORE;
+    } else {
+	if (tablePtr->caching) {
+	    tablePtr->dataSource |= DATA_CACHE;
+	}
+	if (tablePtr->command && tablePtr->useCmd) {
+	    tablePtr->dataSource |= DATA_COMMAND;
+	} else if (tablePtr->arrayVar) {
+	    tablePtr->dataSource |= DATA_ARRAY;
+	}
     }
 
     /* Check to see if the array variable was changed */
@@ -1156,6 +1199,15 @@ TableConfigure(interp, tablePtr, objc, objv, flags, forceUpdate)
     CONSTRAIN(tablePtr->titleRows, 0, tablePtr->rows);
     CONSTRAIN(tablePtr->titleCols, 0, tablePtr->cols);
 
+    /*
+     * Lay the native store out for the new mode and dimensions,
+     * and pick up the active cell if the data source changed.
+     */
+    TableStoreResize(tablePtr);
+    if (oldStore != tablePtr->storeMode) {
+	TableGetActiveBuf(tablePtr);
+    }
+
     /*
      * Handle change of default border style
      * The default borderwidth must be >= 0.
@@ -1299,6 +1351,21 @@ TableEventProc(clientData, eventPtr)
 		    INV_HIGHLIGHT);
 	    break;
 
+	case GraphicsExpose: /* part of a scroll copy that couldn't be done */
+	    TableInvalidate(tablePtr, eventPtr->xgraphicsexpose.x,
+		    eventPtr->xgraphicsexpose.y,
+		    eventPtr->xgraphicsexpose.width,
+		    eventPtr->xgraphicsexpose.height, 0);
+	    break;
+
+	case VisibilityNotify:
+	    if (eventPtr->xvisibility.state == VisibilityUnobscured) {
+		tablePtr->flags |= UNOBSCURED;
+	    } else {
+		tablePtr->flags &= ~UNOBSCURED;
+	    }
+	    break;
+
 	case DestroyNotify:
 	    /* remove the command from the interpreter */
 	    if (tablePtr->tkwin != NULL) {
@@ -1618,23 +1685,28 @@ TableDisplay(ClientData clientdata)
 	x, y, width, height, itemX, itemY, itemW, itemH,
 	row, col, urow, ucol, hrow=0, hcol=0, cx, cy, cw, ch, borders, bd[6],
 	numBytes, new, boundW, boundH, maxW, maxH, cellType,
-	originX, originY, activeCell, shouldInvert, ipadx, ipady, padx, pady;
-    GC tagGc = NULL, topGc, bottomGc;
+	originX, originY, activeCell, ipadx, ipady, padx, pady,
+	needIndex, styleFlags, lastFlags = -1, lastEpoch = -1, key[2];
+    GC tagGc = NULL, copyGc = NULL, topGc, bottomGc;
     const char *string = NULL;
     char buf[INDEX_BUFSIZE];
-    TableTag *tagPtr = NULL, *titlePtr, *selPtr, *activePtr, *flashPtr,
-	*rowPtr, *colPtr;
+    TableTag *tagPtr = NULL, *joinPtr, *rowPtr, *colPtr, *cellPtr,
+	*lastTags[3], **colTags;
+    TableStyle *stylePtr = NULL;
     Tcl_HashEntry *entryPtr;
     static XPoint rect[3] = { {0, 0}, {0, 0}, {0, 0} };
-    Tcl_HashTable *colTagsCache = NULL;
     Tcl_HashTable *drawnCache = NULL;
     Tk_TextLayout textLayout = NULL;
     TableEmbWindow *ewPtr;
+    Tcl_Time start, end;
+    long cells = 0;
 
     tablePtr->flags &= ~REDRAW_PENDING;
     if ((tkwin == NULL) || !Tk_IsMapped(tkwin)) {
 	return;
     }
+    Tcl_GetTime(&start);
+    tablePtr->displayCount++;
 
     boundW = Tk_Width(tkwin) - tablePtr->highlightWidth;
     boundH = Tk_Height(tkwin) - tablePtr->highlightWidth;
@@ -1665,16 +1737,6 @@ TableDisplay(ClientData clientdata)
 	    invalidWidth, invalidHeight, Tk_Depth(tkwin));
 #endif
 
-    /* set up the permanent tag styles */
-    entryPtr	= Tcl_FindHashEntry(tablePtr->tagTable, "title");
-    titlePtr	= (TableTag *) Tcl_GetHashValue(entryPtr);
-    entryPtr	= Tcl_FindHashEntry(tablePtr->tagTable, "sel");
-    selPtr	= (TableTag *) Tcl_GetHashValue(entryPtr);
-    entryPtr	= Tcl_FindHashEntry(tablePtr->tagTable, "active");
-    activePtr	= (TableTag *) Tcl_GetHashValue(entryPtr);
-    entryPtr	= Tcl_FindHashEntry(tablePtr->tagTable, "flash");
-    flashPtr	= (TableTag *) Tcl_GetHashValue(entryPtr);
-
     /* We need to find out the true cell span, not considering spans */
     tablePtr->flags |= AVOID_SPANS;
     /* find out the cells represented by the invalid region */
@@ -1684,23 +1746,42 @@ TableDisplay(ClientData clientdata)
     tablePtr->flags &= ~AVOID_SPANS;
 
     /*
-     * Initialize colTagsCache hash table to cache column tag names.
+     * Get the col tags once for all rows.  The cols in the 'dead zone'
+     * between the title cols and the first displayed col are skipped
+     * by the loop below, so they are skipped here too.
      */
-    colTagsCache = (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
-    Tcl_InitHashTable(colTagsCache, TCL_ONE_WORD_KEYS);
+    colTags = (TableTag **) ckalloc(MAX(1, colTo-colFrom+1)
+	    * sizeof(TableTag *));
+    for (col = colFrom; col <= colTo; col++) {
+	if (col < tablePtr->leftCol && col >= tablePtr->titleCols) {
+	    col = tablePtr->leftCol;
+	    if (col > colTo) break;
+	}
+	colTags[col-colFrom] = FindRowColTag(tablePtr,
+		col+tablePtr->colOffset, COL);
+    }
     /*
-     * Initialize drawnCache hash table to cache drawn cells.
-     * This is necessary to prevent spanning cells being drawn multiple times.
+     * Initialize drawnCache hash table to cache drawn cells, keyed by
+     * user row,col.  This is necessary to prevent spanning cells being
+     * drawn multiple times, so it is only needed with spans.
      */
-    drawnCache = (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
-    Tcl_InitHashTable(drawnCache, TCL_STRING_KEYS);
+    if (tablePtr->spanAffTbl) {
+	drawnCache = (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
+	Tcl_InitHashTable(drawnCache, 2);
+    }
+    /* the array index of a cell is only needed to look it up */
+    needIndex = (tablePtr->winTable->numEntries
+	    || tablePtr->cellStyles->numEntries
+	    || tablePtr->selCells->numEntries
+	    || (tablePtr->flashMode && tablePtr->flashCells->numEntries));
 
     /*
-     * Create the tag here.  This will actually create a JoinTag
-     * That will handle the priority management of merging for us.
-     * We only need one allocated, and we'll reset it for each cell.
+     * Create the tag here.  This will actually create a JoinTag, which
+     * embedded windows are displayed with.  Other cells use the cached
+     * style for their combination of tags, see TableGetStyle.
      */
-    tagPtr = TableNewTag(tablePtr);
+    joinPtr = TableNewTag(tablePtr);
+    lastTags[0] = lastTags[1] = lastTags[2] = NULL;
 
     /* Cycle through the cells and display them */
     for (row = rowFrom; row <= rowTo; row++) {
@@ -1737,10 +1818,10 @@ TableDisplay(ClientData clientdata)
 	    if (cellType == CELL_HIDDEN) {
 		/*
 		 * width,height holds the real start row,col of the span.
-		 * Put the use cell ref into a buffer for the hash lookups.
+		 * Use the user cell ref as the drawnCache key.
 		 */
-		TableMakeArrayIndex(width, height, buf);
-		Tcl_CreateHashEntry(drawnCache, buf, &new);
+		key[0] = width; key[1] = height;
+		Tcl_CreateHashEntry(drawnCache, (char *) key, &new);
 		if (!new) {
 		    /* Not new in the entry, so it's already drawn */
 		    continue;
@@ -1761,26 +1842,33 @@ TableDisplay(ClientData clientdata)
 
 	    /* Cache the col in user terms */
 	    ucol = col+tablePtr->colOffset;
+	    cells++;
 
 	    /* put the use cell ref into a buffer for the hash lookups */
-	    TableMakeArrayIndex(urow, ucol, buf);
-	    if (cellType != CELL_HIDDEN) {
-		Tcl_CreateHashEntry(drawnCache, buf, &new);
+	    if (needIndex) {
+		TableMakeArrayIndex(urow, ucol, buf);
+	    }
+	    if (drawnCache && cellType != CELL_HIDDEN) {
+		key[0] = urow; key[1] = ucol;
+		Tcl_CreateHashEntry(drawnCache, (char *) key, &new);
 	    }
-
-	    /*
-	     * Make sure we start with a clean tag (set to table defaults).
-	     */
-	    TableResetTag(tablePtr, tagPtr);
 
 	    /*
 	     * Check to see if we have an embedded window in this cell.
 	     */
-	    entryPtr = Tcl_FindHashEntry(tablePtr->winTable, buf);
+	    entryPtr = (tablePtr->winTable->numEntries == 0) ? NULL :
+		Tcl_FindHashEntry(tablePtr->winTable, buf);
 	    if (entryPtr != NULL) {
 		ewPtr = (TableEmbWindow *) Tcl_GetHashValue(entryPtr);
 
 		if (ewPtr->tkwin != NULL) {
+		    /*
+		     * Make sure we start with a clean tag (set to table
+		     * defaults).
+		     */
+		    tagPtr = joinPtr;
+		    TableResetTag(tablePtr, tagPtr);
+
 		    /* Display embedded window instead of text */
 
 		    /* if active, make it disabled to avoid
@@ -1823,74 +1911,66 @@ TableDisplay(ClientData clientdata)
 		y -= invalidY;
 	    }
 
-	    shouldInvert = 0;
 	    /*
-	     * Get the combined tag structure for the cell.
-	     * First clear out a new tag structure that we will build in
-	     * then add tags as we realize they belong.
-	     *
-	     * Tags have their own priorities which TableMergeTag will
-	     * take into account when merging tags.
+	     * Work out which tags apply to the cell: the col tag (found
+	     * above for the displayed cols), the row tag, the title,
+	     * cell, active, sel and flash tags.
 	     */
-
-	    /*
-	     * Merge colPtr if it exists
-	     * let's see if we have the value cached already
-	     * if not, run the findColTag routine and cache the value
-	     */
-	    entryPtr = Tcl_CreateHashEntry(colTagsCache, (char *)(size_t)ucol,
-	                                   &new);
-	    if (new) {
-		colPtr = FindRowColTag(tablePtr, ucol, COL);
-		Tcl_SetHashValue(entryPtr, colPtr);
+	    if (col >= colFrom && col <= colTo && (col >= tablePtr->leftCol
+		    || col < tablePtr->titleCols)) {
+		colPtr = colTags[col-colFrom];
 	    } else {
-		colPtr = (TableTag *) Tcl_GetHashValue(entryPtr);
-	    }
-	    if (colPtr != (TableTag *) NULL) {
-		TableMergeTag(tablePtr, tagPtr, colPtr);
-	    }
-	    /* Merge rowPtr if it exists */
-	    if (rowPtr != (TableTag *) NULL) {
-		TableMergeTag(tablePtr, tagPtr, rowPtr);
+		/* a span may start outside the displayed cols */
+		colPtr = FindRowColTag(tablePtr, ucol, COL);
 	    }
-	    /* Am I in the titles */
+	    styleFlags = 0;
 	    if (row < tablePtr->titleRows || col < tablePtr->titleCols) {
-		TableMergeTag(tablePtr, tagPtr, titlePtr);
+		styleFlags |= STYLE_TITLE;
 	    }
-	    /* Does this have a cell tag */
-	    entryPtr = Tcl_FindHashEntry(tablePtr->cellStyles, buf);
-	    if (entryPtr != NULL) {
-		TableMergeTag(tablePtr, tagPtr,
-			(TableTag *) Tcl_GetHashValue(entryPtr));
+	    cellPtr = NULL;
+	    if (tablePtr->cellStyles->numEntries) {
+		entryPtr = Tcl_FindHashEntry(tablePtr->cellStyles, buf);
+		if (entryPtr != NULL) {
+		    cellPtr = (TableTag *) Tcl_GetHashValue(entryPtr);
+		}
 	    }
-	    /* is this cell active? */
 	    if ((tablePtr->flags & HAS_ACTIVE) &&
 		    (tablePtr->state == STATE_NORMAL) &&
 		    row == tablePtr->activeRow && col == tablePtr->activeCol) {
-		if (tagPtr->state == STATE_DISABLED) {
-		    tablePtr->flags |= ACTIVE_DISABLED;
-		} else {
-		    TableMergeTag(tablePtr, tagPtr, activePtr);
-		    activeCell = 1;
-		    tablePtr->flags &= ~ACTIVE_DISABLED;
-		}
+		styleFlags |= STYLE_ACTIVE;
 	    }
-	    /* is this cell selected? */
-	    if (Tcl_FindHashEntry(tablePtr->selCells, buf) != NULL) {
-		if (tablePtr->invertSelected && !activeCell) {
-		    shouldInvert = 1;
-		} else {
-		    TableMergeTag(tablePtr, tagPtr, selPtr);
-		}
+	    if (tablePtr->selCells->numEntries &&
+		    Tcl_FindHashEntry(tablePtr->selCells, buf) != NULL) {
+		styleFlags |= STYLE_SEL;
 	    }
-	    /* if flash mode is on, is this cell flashing? */
-	    if (tablePtr->flashMode &&
+	    if (tablePtr->flashMode && tablePtr->flashCells->numEntries &&
 		    Tcl_FindHashEntry(tablePtr->flashCells, buf) != NULL) {
-		TableMergeTag(tablePtr, tagPtr, flashPtr);
+		styleFlags |= STYLE_FLASH;
 	    }
 
-	    if (shouldInvert) {
-		TableInvertTag(tagPtr);
+	    /*
+	     * Get the combined tag structure for the cell.  Neighbouring
+	     * cells mostly share one, so check the last one first.
+	     */
+	    if (styleFlags != lastFlags || colPtr != lastTags[0]
+		    || rowPtr != lastTags[1] || cellPtr != lastTags[2]
+		    || lastEpoch != tablePtr->styleEpoch) {
+		stylePtr = TableGetStyle(tablePtr, colPtr, rowPtr, cellPtr,
+			styleFlags);
+		lastFlags	= styleFlags;
+		lastTags[0]	= colPtr;
+		lastTags[1]	= rowPtr;
+		lastTags[2]	= cellPtr;
+		lastEpoch	= tablePtr->styleEpoch;
+	    }
+	    tagPtr = &(stylePtr->tag);
+	    if (styleFlags & STYLE_ACTIVE) {
+		if (stylePtr->active) {
+		    activeCell = 1;
+		    tablePtr->flags &= ~ACTIVE_DISABLED;
+		} else {
+		    tablePtr->flags |= ACTIVE_DISABLED;
+		}
 	    }
 
 	    /*
@@ -1968,21 +2048,34 @@ TableDisplay(ClientData clientdata)
 		}
 	    }
 
-	    /*
-	     * Get the GC for this particular blend of tags.
-	     * This creates the GC if it never existed, otherwise it
-	     * modifies the one we have, so we only need the one
-	     */
-	    TableGetGc(display, window, tagPtr, &tagGc);
-
 	    /* if this is the active cell, use the buffer */
 	    if (activeCell) {
 		string = tablePtr->activeBuf;
 	    } else {
 		/* Is there a value in the cell? If so, draw it  */
 		string = TableGetCellValue(tablePtr, urow, ucol);
+		if (lastEpoch != tablePtr->styleEpoch) {
+		    /* a -command or trace reconfigured the tags */
+		    stylePtr = TableGetStyle(tablePtr, colPtr, rowPtr,
+			    cellPtr, styleFlags);
+		    lastEpoch = tablePtr->styleEpoch;
+		    tagPtr = &(stylePtr->tag);
+		}
 	    }
 
+	    /*
+	     * Get the GC for this particular blend of tags, which is
+	     * kept with the style.  A named font can be reconfigured in
+	     * place, which changes its font id, so the GC is updated the
+	     * first time the style is used in each redraw.
+	     */
+	    if (stylePtr->gc == NULL
+		    || stylePtr->display != tablePtr->displayCount) {
+		TableGetGc(display, window, tagPtr, &(stylePtr->gc));
+		stylePtr->display = tablePtr->displayCount;
+	    }
+	    tagGc = stylePtr->gc;
+
 #ifdef TCL_UTF_MAX
 	    /*
 	     * We have to use strlen here because otherwise it stops
@@ -2285,7 +2378,8 @@ TableDisplay(ClientData clientdata)
 	    }
 	}
     }
-    ckfree((char *) tagPtr);
+    ckfree((char *) joinPtr);
+    ckfree((char *) colTags);
 #ifdef NO_XSETCLIP
     Tk_FreePixmap(display, clipWind);
 #endif
@@ -2296,9 +2390,10 @@ TableDisplay(ClientData clientdata)
     /* copy over and delete the pixmap if we are in slow mode */
     if (tablePtr->drawMode == DRAW_MODE_SLOW) {
 	/* Get a default valued GC */
-	TableGetGc(display, window, &(tablePtr->defaultTag), &tagGc);
-	XCopyArea(display, window, Tk_WindowId(tkwin), tagGc, 0, 0,
+	TableGetGc(display, window, &(tablePtr->defaultTag), &copyGc);
+	XCopyArea(display, window, Tk_WindowId(tkwin), copyGc, 0, 0,
 		invalidWidth, invalidHeight, invalidX, invalidY);
+	TableFreeGc(display, copyGc);
 	Tk_FreePixmap(display, window);
 	window = Tk_WindowId(tkwin);
     }
@@ -2333,17 +2428,23 @@ TableDisplay(ClientData clientdata)
 		invalidWidth, invalidY+invalidHeight-y-height);
     }
 
-    if (tagGc != NULL) {
-	TableFreeGc(display, tagGc);
-    }
     TableRedrawHighlight(tablePtr);
     /*
-     * Free the hash table used to cache evaluations.
+     * Free the hash table used to track spans.
      */
-    Tcl_DeleteHashTable(colTagsCache);
-    ckfree((char *) (colTagsCache));
-    Tcl_DeleteHashTable(drawnCache);
-    ckfree((char *) (drawnCache));
+    if (drawnCache) {
+	Tcl_DeleteHashTable(drawnCache);
+	ckfree((char *) (drawnCache));
+    }
+
+    /* Keep track of the redraw costs for the 'stats' command */
+    Tcl_GetTime(&end);
+    tablePtr->stats.redraws++;
+    tablePtr->stats.lastCells = cells;
+    tablePtr->stats.cells += cells;
+    tablePtr->stats.lastUsecs = (end.sec - start.sec) * 1000000
+	+ (end.usec - start.usec);
+    tablePtr->stats.usecs += tablePtr->stats.lastUsecs;
 }
 
 /*
@@ -2740,10 +2841,10 @@ TableGeometryRequest(tablePtr)
      * Vice versa for rows/height
      */
     x = MIN((tablePtr->maxReqCols==0 || tablePtr->maxReqCols > tablePtr->cols)?
-	    tablePtr->maxWidth : tablePtr->colStarts[tablePtr->maxReqCols],
+	    tablePtr->maxWidth : TableColStart(tablePtr, tablePtr->maxReqCols),
 	    tablePtr->maxReqWidth) + 2*tablePtr->highlightWidth;
     y = MIN((tablePtr->maxReqRows==0 || tablePtr->maxReqRows > tablePtr->rows)?
-	    tablePtr->maxHeight : tablePtr->rowStarts[tablePtr->maxReqRows],
+	    tablePtr->maxHeight : TableRowStart(tablePtr, tablePtr->maxReqRows),
 	    tablePtr->maxReqHeight) + 2*tablePtr->highlightWidth;
     Tk_GeometryRequest(tablePtr->tkwin, x, y);
 }
@@ -2825,6 +2926,121 @@ TableAdjustActive(tablePtr)
     tablePtr->oldActCol = tablePtr->activeCol;
 }
 
+/*
+ * A row|col with a preset height|width, see TableGetPresets
+ */
+typedef struct {
+    int index;			/* real row|col */
+    int pixels;			/* its size in pixels */
+} TablePreset;
+
+static int
+TableComparePresets(const VOID *first, const VOID *second)
+{
+    return ((TablePreset *) first)->index - ((TablePreset *) second)->index;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableGetPresets --
+ *	Collects the rows|cols that have a preset height|width in
+ *	sizeTbl, in index order, with their size in pixels.
+ *
+ * Results:
+ *	The number of presets.  *presetsPtr is set to a ckalloc'ed array
+ *	of them (NULL if none) that the caller must free.  *numPixelsPtr
+ *	gets their total size and *lastUnpresetPtr the last row|col
+ *	without a preset (0 if there is none).
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+TableGetPresets(Tcl_HashTable *sizeTbl, int count, int charSize, int pad,
+		TablePreset **presetsPtr, int *numPixelsPtr,
+		int *lastUnpresetPtr)
+{
+    Tcl_HashEntry *entryPtr;
+    Tcl_HashSearch search;
+    TablePreset *presets = NULL;
+    int num = 0, i, j, value;
+
+    *numPixelsPtr = 0;
+    if (sizeTbl->numEntries > 0) {
+	presets = (TablePreset *) ckalloc(sizeTbl->numEntries
+		* sizeof(TablePreset));
+	for (entryPtr = Tcl_FirstHashEntry(sizeTbl, &search);
+	     entryPtr != NULL; entryPtr = Tcl_NextHashEntry(&search)) {
+	    i = PTR2INT(Tcl_GetHashKey(sizeTbl, entryPtr));
+	    if (i < 0 || i >= count) {
+		continue;
+	    }
+	    value = (ssize_t) Tcl_GetHashValue(entryPtr);
+	    presets[num].index = i;
+	    /*
+	     * When a value in pixels is specified, we take that exact
+	     * amount, not adding in pad or border values.
+	     */
+	    presets[num].pixels = (value > 0) ? value * charSize + pad : -value;
+	    *numPixelsPtr += presets[num].pixels;
+	    num++;
+	}
+	qsort((VOID *) presets, (size_t) num, sizeof(TablePreset),
+		TableComparePresets);
+    }
+
+    *lastUnpresetPtr = 0;
+    for (i = count-1, j = num-1; i >= 0; i--, j--) {
+	if (j < 0 || presets[j].index != i) {
+	    *lastUnpresetPtr = i;
+	    break;
+	}
+    }
+    *presetsPtr = presets;
+    return num;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableSetGeom --
+ *	Lays out count rows|cols: unpreset ones are defSize + pad wide,
+ *	except lastUnpreset which gets lastPad instead, and presets keep
+ *	their size, padded the same way if padAll is set.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Resets geomPtr.  Only the presets and lastUnpreset are stored.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+TableSetGeom(TableGeom *geomPtr, int count, int num, TablePreset *presets,
+	     int defSize, int pad, int lastPad, int lastUnpreset, int padAll)
+{
+    int j, found = 0;
+
+    TableGeomReset(geomPtr, count, defSize + pad);
+    for (j = 0; j < num; j++) {
+	if (presets[j].index == lastUnpreset) {
+	    found = 1;
+	    TableGeomSet(geomPtr, presets[j].index,
+		    presets[j].pixels + (padAll ? lastPad : 0));
+	} else {
+	    TableGeomSet(geomPtr, presets[j].index,
+		    presets[j].pixels + (padAll ? pad : 0));
+	}
+    }
+    if (!found && lastPad != pad) {
+	TableGeomSet(geomPtr, lastUnpreset, defSize + lastPad);
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2848,11 +3064,11 @@ TableAdjustActive(tablePtr)
 void
 TableAdjustParams(register Table *tablePtr)
 {
-    int topRow, leftCol, row, col, total, i, value, x, y, width, height,
+    int topRow, leftCol, row, col, x, y, width, height,
 	w, h, hl, px, py, recalc, bd[4],
 	diff, unpreset, lastUnpreset, pad, lastPad, numPixels,
-	defColWidth, defRowHeight;
-    Tcl_HashEntry *entryPtr;
+	defColWidth, defRowHeight, numPresets;
+    TablePreset *presets;
 
     /*
      * Cache some values for many upcoming calculations
@@ -2884,60 +3100,24 @@ TableAdjustParams(register Table *tablePtr)
     }
 
     /*
-     * Set up the arrays to hold the col pixels and starts.
-     * ckrealloc was fixed in 8.2.1 to handle NULLs, so we can't rely on it.
-     */
-    if (tablePtr->colPixels) ckfree((char *) tablePtr->colPixels);
-    tablePtr->colPixels = (int *) ckalloc(tablePtr->cols * sizeof(int));
-    if (tablePtr->colStarts) ckfree((char *) tablePtr->colStarts);
-    tablePtr->colStarts = (int *) ckalloc((tablePtr->cols+1) * sizeof(int));
-
-    /*
-     * Get all the preset columns and set their widths
+     * Get all the preset columns and their widths
      */
-    lastUnpreset = 0;
-    numPixels = 0;
-    unpreset = 0;
-    for (i = 0; i < tablePtr->cols; i++) {
-	entryPtr = Tcl_FindHashEntry(tablePtr->colWidths, (char *) (size_t) i);
-	if (entryPtr == NULL) {
-	    tablePtr->colPixels[i] = -1;
-	    unpreset++;
-	    lastUnpreset = i;
-	} else {
-	    value = (ssize_t) Tcl_GetHashValue(entryPtr);
-	    if (value > 0) {
-		tablePtr->colPixels[i] = value * tablePtr->charWidth + px;
-	    } else {
-		/*
-		 * When a value in pixels is specified, we take that exact
-		 * amount, not adding in pad or border values.
-		 */
-		tablePtr->colPixels[i] = -value;
-	    }
-	    numPixels += tablePtr->colPixels[i];
-	}
-    }
+    numPresets = TableGetPresets(tablePtr->colWidths, tablePtr->cols,
+	    tablePtr->charWidth, px, &presets, &numPixels, &lastUnpreset);
+    unpreset = tablePtr->cols - numPresets;
 
     /*
      * Work out how much to pad each col depending on the mode.
      */
     diff  = w - numPixels - (unpreset * defColWidth);
-    total = 0;
 
     /*
-     * Now do the padding and calculate the column starts.
      * Diff lower than 0 means we can't see the entire set of columns,
-     * thus no special stretching will occur & we optimize the calculation.
+     * thus no special stretching will occur.
      */
     if (diff <= 0) {
-	for (i = 0; i < tablePtr->cols; i++) {
-	    if (tablePtr->colPixels[i] == -1) {
-		tablePtr->colPixels[i] = defColWidth;
-	    }
-	    tablePtr->colStarts[i] = total;
-	    total += tablePtr->colPixels[i];
-	}
+	pad		= 0;
+	lastPad		= 0;
     } else {
 	switch (tablePtr->colStretch) {
 	case STRETCH_MODE_NONE:
@@ -2964,55 +3144,28 @@ TableAdjustParams(register Table *tablePtr)
 	    lastUnpreset = tablePtr->cols - 1;
 	    lastPad	= diff - pad * lastUnpreset;
 	}
-
-	for (i = 0; i < tablePtr->cols; i++) {
-	    if (tablePtr->colPixels[i] == -1) {
-		tablePtr->colPixels[i] = defColWidth
-		    + ((i == lastUnpreset) ? lastPad : pad);
-	    } else if (tablePtr->colStretch == STRETCH_MODE_ALL) {
-		tablePtr->colPixels[i] += (i == lastUnpreset) ? lastPad : pad;
-	    }
-	    tablePtr->colStarts[i] = total;
-	    total += tablePtr->colPixels[i];
-	}
     }
-    tablePtr->colStarts[i] = tablePtr->maxWidth = total;
+
+    /*
+     * Now do the padding, which sets up the column starts.
+     */
+    TableSetGeom(&(tablePtr->colGeom), tablePtr->cols, numPresets, presets,
+	    defColWidth, pad, lastPad, lastUnpreset,
+	    (diff > 0 && tablePtr->colStretch == STRETCH_MODE_ALL));
+    if (presets) ckfree((char *) presets);
+    tablePtr->maxWidth = TableColStart(tablePtr, tablePtr->cols);
 
     /*
      * The 'do' loop is only necessary for rows because of FILL mode
      */
     recalc = 0;
+    presets = NULL;
     do {
-	/* Set up the arrays to hold the row pixels and starts */
-	/* FIX - this can be moved outside 'do' if you check >row size */
-	if (tablePtr->rowPixels) ckfree((char *) tablePtr->rowPixels);
-	tablePtr->rowPixels = (int *) ckalloc(tablePtr->rows * sizeof(int));
-
-	/* get all the preset rows and set their heights */
-	lastUnpreset	= 0;
-	numPixels	= 0;
-	unpreset	= 0;
-	for (i = 0; i < tablePtr->rows; i++) {
-	    entryPtr = Tcl_FindHashEntry(tablePtr->rowHeights,
-	                                 (char *) (size_t) i);
-	    if (entryPtr == NULL) {
-		tablePtr->rowPixels[i] = -1;
-		unpreset++;
-		lastUnpreset = i;
-	    } else {
-		value = (ssize_t) Tcl_GetHashValue(entryPtr);
-		if (value > 0) {
-		    tablePtr->rowPixels[i] = value * tablePtr->charHeight + py;
-		} else {
-		    /*
-		     * When a value in pixels is specified, we take that exact
-		     * amount, not adding in pad or border values.
-		     */
-		    tablePtr->rowPixels[i] = -value;
-		}
-		numPixels += tablePtr->rowPixels[i];
-	    }
-	}
+	/* get all the preset rows and their heights */
+	if (presets) ckfree((char *) presets);
+	numPresets = TableGetPresets(tablePtr->rowHeights, tablePtr->rows,
+		tablePtr->charHeight, py, &presets, &numPixels, &lastUnpreset);
+	unpreset = tablePtr->rows - numPresets;
 
 	/* work out how much to pad each row depending on the mode */
 	diff = h - numPixels - (unpreset * defRowHeight);
@@ -3060,24 +3213,14 @@ TableAdjustParams(register Table *tablePtr)
 	}
     } while (recalc);
 
-    if (tablePtr->rowStarts) ckfree((char *) tablePtr->rowStarts);
-    tablePtr->rowStarts = (int *) ckalloc((tablePtr->rows+1)*sizeof(int));
     /*
-     * Now do the padding and calculate the row starts
+     * Now do the padding, which sets up the row starts
      */
-    total = 0;
-    for (i = 0; i < tablePtr->rows; i++) {
-	if (tablePtr->rowPixels[i] == -1) {
-	    tablePtr->rowPixels[i] = defRowHeight
-		+ ((i==lastUnpreset)?lastPad:pad);
-	} else if (tablePtr->rowStretch == STRETCH_MODE_ALL) {
-	    tablePtr->rowPixels[i] += (i==lastUnpreset)?lastPad:pad;
-	}
-	/* calculate the start of each row */
-	tablePtr->rowStarts[i] = total;
-	total += tablePtr->rowPixels[i];
-    }
-    tablePtr->rowStarts[i] = tablePtr->maxHeight = total;
+    TableSetGeom(&(tablePtr->rowGeom), tablePtr->rows, numPresets, presets,
+	    defRowHeight, pad, lastPad, lastUnpreset,
+	    (tablePtr->rowStretch == STRETCH_MODE_ALL));
+    if (presets) ckfree((char *) presets);
+    tablePtr->maxHeight = TableRowStart(tablePtr, tablePtr->rows);
 
     /*
      * Make sure the top row and col have reasonable real indices
@@ -3103,8 +3246,8 @@ TableAdjustParams(register Table *tablePtr)
      * make sure we don't cut off the bottom row
      */
     for (; topRow > tablePtr->titleRows; topRow--) {
-	if ((tablePtr->maxHeight-(tablePtr->rowStarts[topRow-1] -
-		tablePtr->rowStarts[tablePtr->titleRows])) > h) {
+	if ((tablePtr->maxHeight-(TableRowStart(tablePtr, topRow-1) -
+		TableRowStart(tablePtr, tablePtr->titleRows))) > h) {
 	    break;
 	}
     }
@@ -3114,8 +3257,8 @@ TableAdjustParams(register Table *tablePtr)
      * make sure we don't cut off the left column
      */
     for (; leftCol > tablePtr->titleCols; leftCol--) {
-	if ((tablePtr->maxWidth-(tablePtr->colStarts[leftCol-1] -
-		tablePtr->colStarts[tablePtr->titleCols])) > w) {
+	if ((tablePtr->maxWidth-(TableColStart(tablePtr, leftCol-1) -
+		TableColStart(tablePtr, tablePtr->titleCols))) > w) {
 	    break;
 	}
     }
@@ -3158,14 +3301,14 @@ TableAdjustParams(register Table *tablePtr)
 		first = 0;
 		last  = 1;
 	    } else {
-		diff = tablePtr->rowStarts[tablePtr->titleRows];
-		last = (double) (tablePtr->rowStarts[tablePtr->rows]-diff);
+		diff = TableRowStart(tablePtr, tablePtr->titleRows);
+		last = (double) (TableRowStart(tablePtr, tablePtr->rows)-diff);
 		if (last <= 0.0) {
 		    first = 0;
 		    last  = 1;
 		} else {
-		    first = (tablePtr->rowStarts[topRow]-diff) / last;
-		    last  = (height+tablePtr->rowStarts[row]-diff) / last;
+		    first = (TableRowStart(tablePtr, topRow)-diff) / last;
+		    last  = (height+TableRowStart(tablePtr, row)-diff) / last;
 		}
 	    }
 	    sprintf(buf, " %g %g", first, last);
@@ -3182,14 +3325,14 @@ TableAdjustParams(register Table *tablePtr)
 		first = 0;
 		last  = 1;
 	    } else {
-		diff = tablePtr->colStarts[tablePtr->titleCols];
-		last = (double) (tablePtr->colStarts[tablePtr->cols]-diff);
+		diff = TableColStart(tablePtr, tablePtr->titleCols);
+		last = (double) (TableColStart(tablePtr, tablePtr->cols)-diff);
 		if (last <= 0.0) {
 		    first = 0;
 		    last  = 1;
 		} else {
-		    first = (tablePtr->colStarts[leftCol]-diff) / last;
-		    last  = (width+tablePtr->colStarts[col]-diff) / last;
+		    first = (TableColStart(tablePtr, leftCol)-diff) / last;
+		    last  = (width+TableColStart(tablePtr, col)-diff) / last;
 		}
 	    }
 	    sprintf(buf, " %g %g", first, last);
@@ -3211,15 +3354,15 @@ TableAdjustParams(register Table *tablePtr)
     if (row == tablePtr->rows-1 && tablePtr->rowStretch != STRETCH_MODE_NONE) {
 	diff = h-(y+height);
 	if (diff > 0) {
-	    tablePtr->rowPixels[tablePtr->rows-1] += diff;
-	    tablePtr->rowStarts[tablePtr->rows] += diff;
+	    TableGeomSet(&(tablePtr->rowGeom), tablePtr->rows-1,
+		    TableRowPixels(tablePtr, tablePtr->rows-1) + diff);
 	}
     }
     if (col == tablePtr->cols-1 && tablePtr->colStretch != STRETCH_MODE_NONE) {
 	diff = w-(x+width);
 	if (diff > 0) {
-	    tablePtr->colPixels[tablePtr->cols-1] += diff;
-	    tablePtr->colStarts[tablePtr->cols] += diff;
+	    TableGeomSet(&(tablePtr->colGeom), tablePtr->cols-1,
+		    TableColPixels(tablePtr, tablePtr->cols-1) + diff);
 	}
     }
 
@@ -3231,12 +3374,135 @@ TableAdjustParams(register Table *tablePtr)
      */
     if (tablePtr->topRow != tablePtr->oldTopRow ||
 	tablePtr->leftCol != tablePtr->oldLeftCol) {
+	int oldTop = tablePtr->oldTopRow, oldLeft = tablePtr->oldLeftCol;
+
 	/* set the old top row/col for the next time this function is called */
 	tablePtr->oldTopRow = tablePtr->topRow;
 	tablePtr->oldLeftCol = tablePtr->leftCol;
-	/* only the upper corner title cells wouldn't change */
-	TableInvalidateAll(tablePtr, 0);
+	/*
+	 * When only scrolling, try to move what is shown.  Otherwise
+	 * only the upper corner title cells wouldn't change.
+	 */
+	if (!(tablePtr->flags & SCROLL_BLIT)
+		|| !TableScrollBlit(tablePtr, oldTop, oldLeft)) {
+	    TableInvalidateAll(tablePtr, 0);
+	}
+    }
+    tablePtr->flags &= ~SCROLL_BLIT;
+}
+
+/*
+ * Scrolling copies the part of the window that is still valid with
+ * XCopyArea and learns about anything it could not copy through
+ * GraphicsExpose events, which only X11 delivers.
+ */
+#if defined(MAC_TCL) || defined(UNDER_CE) || defined(TK_PLATFORM_WIN) || defined(MAC_OSX_TK)
+#define NO_SCROLL_BLIT
+#endif
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableScrollBlit --
+ *	Scrolls the displayed table from oldTop,oldLeft to the current
+ *	topRow,leftCol by copying what stays visible into place, so only
+ *	the newly exposed rows and cols get redrawn.
+ *
+ * Results:
+ *	1 if the table was scrolled, 0 if it can't be done by copying
+ *	and the caller should invalidate the whole table.
+ *
+ * Side effects:
+ *	Copies within the window and invalidates the exposed strips.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+TableScrollBlit(register Table *tablePtr, int oldTop, int oldLeft)
+{
+#ifdef NO_SCROLL_BLIT
+    return 0;
+#else
+    Tk_Window tkwin = tablePtr->tkwin;
+    Display *display = tablePtr->display;
+    Window window;
+    int hl = tablePtr->highlightWidth;
+    int dx, dy, adx, ady, x0, y0, boundW, boundH;
+
+    /*
+     * Spans and embedded windows don't just move with their rows and
+     * cols, and what is obscured can't be copied.
+     */
+    if ((tkwin == NULL) || !Tk_IsMapped(tkwin)
+	    || !(tablePtr->flags & UNOBSCURED)
+	    || (tablePtr->spanTbl != NULL)
+	    || (tablePtr->winTable->numEntries > 0)) {
+	return 0;
+    }
+
+    /* how far the rows and cols move, and where they are shown */
+    dx = TableColStart(tablePtr, tablePtr->leftCol)
+	- TableColStart(tablePtr, oldLeft);
+    dy = TableRowStart(tablePtr, tablePtr->topRow)
+	- TableRowStart(tablePtr, oldTop);
+    adx = MAX(dx, -dx);
+    ady = MAX(dy, -dy);
+    boundW = Tk_Width(tkwin) - hl;
+    boundH = Tk_Height(tkwin) - hl;
+    x0 = hl + TableColStart(tablePtr, tablePtr->titleCols);
+    y0 = hl + TableRowStart(tablePtr, tablePtr->titleRows);
+    if (adx >= boundW - x0 || ady >= boundH - y0) {
+	/* nothing would be left to copy */
+	return 0;
+    }
+
+    if (tablePtr->scrollGc == NULL) {
+	XGCValues gcValues;
+
+	gcValues.graphics_exposures = True;
+	tablePtr->scrollGc = Tk_GetGC(tkwin, GCGraphicsExposures, &gcValues);
     }
+    window = Tk_WindowId(tkwin);
+
+    /*
+     * A pending redraw is for what was shown before the copy, so it
+     * also has to cover where that was copied to.
+     */
+    if (tablePtr->flags & REDRAW_PENDING) {
+	TableInvalidate(tablePtr, tablePtr->invalidX - dx,
+		tablePtr->invalidY - dy, tablePtr->invalidWidth,
+		tablePtr->invalidHeight, 0);
+    }
+
+    /* the rows move up|down, along with the title cols */
+    if (dy) {
+	XCopyArea(display, window, window, tablePtr->scrollGc,
+		hl, y0 + MAX(dy, 0), boundW - hl, boundH - y0 - ady,
+		hl, y0 - MIN(dy, 0));
+    }
+    /* then the cols move left|right, along with the title rows */
+    if (dx) {
+	XCopyArea(display, window, window, tablePtr->scrollGc,
+		x0 + MAX(dx, 0), hl, boundW - x0 - adx, boundH - hl,
+		x0 - MIN(dx, 0), hl);
+    }
+
+    /*
+     * Now redraw the exposed strips.  As a single invalid rectangle,
+     * a row strip and a col strip would cover the whole table, so the
+     * row strip is drawn right away when there are both.
+     */
+    if (dy) {
+	TableInvalidate(tablePtr, hl, (dy > 0) ? boundH - dy : y0,
+		boundW - hl, ady, dx ? INV_FORCE : 0);
+    }
+    if (dx) {
+	TableInvalidate(tablePtr, (dx > 0) ? boundW - dx : x0, hl,
+		adx, boundH - hl, 0);
+    }
+    tablePtr->stats.blits++;
+    return 1;
+#endif
 }
 
 /*
@@ -3372,14 +3638,12 @@ TableFetchSelection(clientData, offset, buffer, maxBytes)
 {
     register Table *tablePtr = (Table *) clientData;
     Tcl_Interp *interp = tablePtr->interp;
-    char *value, *rowsep = tablePtr->rowSep, *colsep = tablePtr->colSep;
+    char *rowsep = tablePtr->rowSep, *colsep = tablePtr->colSep;
     const char *data;
     Tcl_DString selection;
-    Tcl_HashEntry *entryPtr;
-    Tcl_HashSearch search;
-    int length, count, lastrow=0, needcs=0, r, c, listArgc, rslen=0, cslen=0;
+    TableCellPos *cells;
+    int length, count, lastrow=0, needcs=0, r, c, numCells, rslen=0, cslen=0;
     int numcols, numrows;
-    CONST84 char **listArgv;
 
     /* if we are not exporting the selection ||
      * we have no data source, return */
@@ -3388,28 +3652,16 @@ TableFetchSelection(clientData, offset, buffer, maxBytes)
 	return -1;
     }
 
-    /* First get a sorted list of the selected elements */
-    Tcl_DStringInit(&selection);
-    for (entryPtr = Tcl_FirstHashEntry(tablePtr->selCells, &search);
-	 entryPtr != NULL; entryPtr = Tcl_NextHashEntry(&search)) {
-	Tcl_DStringAppendElement(&selection,
-				 Tcl_GetHashKey(tablePtr->selCells, entryPtr));
-    }
-    value = TableCellSort(tablePtr, Tcl_DStringValue(&selection));
-    Tcl_DStringFree(&selection);
-
-    if (value == NULL ||
-	Tcl_SplitList(interp, value, &listArgc, &listArgv) != TCL_OK) {
-	return -1;
-    }
-    Tcl_Free(value);
+    /* First get the selected cells, sorted by row */
+    cells = TableSelCells(tablePtr, &numCells);
 
     Tcl_DStringInit(&selection);
     rslen = (rowsep?(strlen(rowsep)):0);
     cslen = (colsep?(strlen(colsep)):0);
     numrows = numcols = 0;
-    for (count = 0; count < listArgc; count++) {
-	TableParseArrayIndex(&r, &c, listArgv[count]);
+    for (count = 0; count < numCells; count++) {
+	r = cells[count].row;
+	c = cells[count].col;
 	if (count) {
 	    if (lastrow != r) {
 		lastrow = r;
@@ -3445,14 +3697,16 @@ TableFetchSelection(clientData, offset, buffer, maxBytes)
     if (!rslen && count) {
 	Tcl_DStringEndSublist(&selection);
     }
-    Tcl_Free((char *) listArgv);
+    if (cells != NULL) {
+	ckfree((char *) cells);
+    }
 
     if (tablePtr->selCmd != NULL) {
 	Tcl_DString script;
 	Tcl_DStringInit(&script);
 	ExpandPercents(tablePtr, tablePtr->selCmd, numrows+1, numcols+1,
 		       Tcl_DStringValue(&selection), (char *)NULL,
-		       listArgc, &script, CMD_ACTIVATE);
+		       numCells, &script, CMD_ACTIVATE);
 	if (Tcl_GlobalEval(interp, Tcl_DStringValue(&script)) == TCL_ERROR) {
 	    Tcl_AddErrorInfo(interp,
 			     "\n    (error in table selection command)");
@@ -3789,6 +4043,55 @@ ExpandPercents(tablePtr, before, r, c, old, new, index, dsPtr, cmdType)
     Tcl_DStringAppend(dsPtr, "", 1);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tktable_StoreFill --
+ *	C interface to bulk load the native store of the table widget
+ *	pathName, for data sources that live in C.  objv holds rows*cols
+ *	values in row-major order to place from the user index row,col.
+ *	The table must have been configured with -datastore.
+ *
+ * Results:
+ *	A standard Tcl result.  On success, the interp result holds the
+ *	number of cells set, which is bounded by the table dimensions.
+ *
+ * Side effects:
+ *	The affected cells are redrawn.
+ *
+ *----------------------------------------------------------------------
+ */
+EXTERN int
+Tktable_StoreFill(interp, pathName, row, col, rows, cols, objv)
+     Tcl_Interp *interp;
+     CONST char *pathName;	/* Path name of the table widget. */
+     int row, col;		/* Top left cell, in user coords. */
+     int rows, cols;		/* Dimensions of the block of values. */
+     Tcl_Obj *CONST objv[];	/* rows*cols values, row-major. */
+{
+    Tcl_CmdInfo info;
+    Table *tablePtr;
+
+    if (!Tcl_GetCommandInfo(interp, pathName, &info) ||
+	info.objProc != TableWidgetObjCmd) {
+	Tcl_ResetResult(interp);
+	Tcl_AppendResult(interp, "\"", pathName, "\" is not a table widget",
+			 (char *) NULL);
+	return TCL_ERROR;
+    }
+    tablePtr = (Table *) info.objClientData;
+    if (!(tablePtr->dataSource & DATA_STORE)) {
+	Tcl_ResetResult(interp);
+	Tcl_AppendResult(interp, "no data store in table \"", pathName,
+			 "\", see -datastore", (char *) NULL);
+	return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(TableStoreFill(tablePtr,
+	    row-tablePtr->rowOffset, col-tablePtr->colOffset,
+	    rows, cols, objv)));
+    return TCL_OK;
+}
+
 /* Function to call on loading the Table module */
 
 #ifdef BUILD_tkTable
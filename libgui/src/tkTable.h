@@ -130,6 +130,10 @@ extern "C" {
  * OVER_BORDER:		Non-zero means we are over a table cell border
  * REDRAW_ON_MAP:	Forces a redraw on the unmap
  * AVOID_SPANS:		prevent cell spans from being used
+ * UNOBSCURED:		Non-zero means the window is fully visible, so
+ *			scrolling can copy what it already shows.
+ * SCROLL_BLIT:		topRow/leftCol were moved by scrolling, so
+ *			TableAdjustParams may copy instead of redrawing.
  *
  * FIX - consider adding UPDATE_SCROLLBAR a la entry
  */
@@ -147,6 +151,8 @@ extern "C" {
 #define OVER_BORDER		(1L<<11)
 #define REDRAW_ON_MAP		(1L<<12)
 #define AVOID_SPANS		(1L<<13)
+#define UNOBSCURED		(1L<<14)
+#define SCROLL_BLIT		(1L<<15)
 
 /* Flags for TableInvalidate && TableRedraw */
 #define ROW		(1L<<0)
@@ -179,6 +185,18 @@ extern "C" {
 #define DATA_CACHE	(1<<1)
 #define	DATA_ARRAY	(1<<2)
 #define DATA_COMMAND	(1<<3)
+#define DATA_STORE	(1<<4)
+
+/*
+ * Layouts of the native cell store, selected by -datastore
+ */
+#define STORE_NONE	1
+#define STORE_DENSE	2
+#define STORE_SPARSE	3
+
+#define STORE_CHUNK_BITS	6	/* log2 of cells per sparse chunk */
+#define STORE_CHUNK_SIZE	(1<<STORE_CHUNK_BITS)
+#define STORE_CHUNK_MASK	(STORE_CHUNK_SIZE-1)
 
 /*
  * Definitions for configuring -borderwidth
@@ -227,6 +245,69 @@ typedef struct {
     int		showtext;	/* whether to display text over image */
 } TableTag;
 
+/*
+ * A composite tag as drawn in a cell, cached by TableGetStyle for each
+ * combination of col, row and cell tags and these STYLE_* bits.
+ */
+#define STYLE_TITLE	(1<<0)
+#define STYLE_ACTIVE	(1<<1)
+#define STYLE_SEL	(1<<2)
+#define STYLE_FLASH	(1<<3)
+
+typedef struct {
+    TableTag	tag;		/* the merged tag */
+    int		active;		/* whether the active tag was merged in */
+    GC		gc;		/* GC for the tag, created when first drawn */
+    int		display;	/* displayCount when gc was last updated */
+} TableStyle;
+
+/*
+ * Redraw statistics, reported by the stats command
+ */
+typedef struct {
+    long redraws;		/* number of calls to TableDisplay */
+    long cells;			/* number of cells painted */
+    long blits;			/* number of scrolls done by copying */
+    long usecs;			/* total time spent redrawing */
+    long lastCells;		/* cells painted by the last redraw */
+    long lastUsecs;		/* time taken by the last redraw */
+} TableStats;
+
+/*
+ * The native cell store.  Cells are indexed by table (0-based) row and
+ * column, and hold a reference to their value, NULL meaning empty.
+ */
+typedef struct {
+    int mode;			/* STORE_{NONE,DENSE,SPARSE} as allocated */
+    int rows, cols;		/* dimensions of the dense array */
+    Tcl_Obj **cells;		/* dense: row-major array of rows*cols */
+    Tcl_HashTable *chunks;	/* sparse: runs of STORE_CHUNK_SIZE cells
+				 * along a row, keyed by {row, col>>bits} */
+    int count;			/* number of non-empty cells */
+} TableStore;
+
+/*
+ * Geometry of the rows or columns of a table.  They are all size pixels,
+ * except for the exceptions kept sorted by index, so that the starts are
+ * computed rather than stored for every row.  See TableGeomStart.
+ */
+typedef struct {
+    int count;			/* number of rows|cols */
+    int size;			/* pixel size of the uniform rows|cols */
+    int num, max;		/* number of exceptions, and allocated */
+    int *index;			/* sorted row|col of each exception */
+    int *pixels;		/* pixel size of each exception */
+    int *sums;			/* sums[j]: pixels the exceptions before
+				 * index[j] add to the uniform layout */
+} TableGeom;
+
+/*
+ * A cell in user coords, as returned sorted by TableSelCells.
+ */
+typedef struct {
+    int row, col;
+} TableCellPos;
+
 /*  The widget structure for the table Widget */
 
 typedef struct {
@@ -267,6 +348,9 @@ typedef struct {
 				 * for table values */
     int useCmd;			/* Signals whether to use command or the
 				 * array variable, will be 0 if command errs */
+    int storeMode;		/* -datastore: none, dense or sparse.  When
+				 * set, the native store replaces -command,
+				 * -variable and -cache as the data source */
     char *selCmd;		/* the command that is called to when a
 				 * [selection get] call occurs for a table */
     char *valCmd;		/* Command prefix to use when invoking
@@ -335,11 +419,12 @@ typedef struct {
     int flags;			/* An or'ed combination of flags concerning
 				 * redraw/cursor etc. */
     int dataSource;		/* where our data comes from:
-				 * DATA_{NONE,CACHE,ARRAY,COMMAND} */
+				 * DATA_{NONE,CACHE,ARRAY,COMMAND,STORE} */
+    TableStore store;		/* native cell store, see -datastore */
     int maxWidth, maxHeight;	/* max width|height required in pixels */
     int charWidth, charHeight;	/* size of a character in the default font */
-    int *colPixels, *rowPixels;	/* Array of the pixel widths/heights */
-    int *colStarts, *rowStarts;	/* Array of start pixels for rows|columns */
+    TableGeom colGeom, rowGeom;	/* pixel widths|heights and starts of
+				 * the cols|rows, see TableGeomStart */
     int scanMarkX, scanMarkY;	/* Used by "scan" and "border" to mark */
     int scanMarkRow, scanMarkCol;/* necessary information for dragto */
     /* values in these are kept in user coords */
@@ -358,6 +443,9 @@ typedef struct {
     Tcl_HashTable *rowStyles;	/* table for row styles */
     Tcl_HashTable *colStyles;	/* table for col styles */
     Tcl_HashTable *cellStyles;	/* table for cell styles */
+    Tcl_HashTable *styleTable;	/* cache of composite tags */
+    int styleEpoch;		/* bumped whenever styleTable is flushed */
+    int displayCount;		/* bumped by every TableDisplay */
     Tcl_HashTable *flashCells;	/* table of flashing cells */
     Tcl_HashTable *selCells;	/* table of selected cells */
     Tcl_TimerToken cursorTimer;	/* timer token for the cursor blinking */
@@ -374,6 +462,9 @@ typedef struct {
     /* The invalid rectangle if there is an update pending */
     int invalidX, invalidY, invalidWidth, invalidHeight;
     int seen[4];			/* see TableUndisplay */
+    GC scrollGc;		/* GC to copy with when scrolling, see
+				 * TableScrollBlit */
+    TableStats stats;		/* redraw statistics */
 
 #ifdef POSTSCRIPT
     /* Pointer to information used for generating Postscript for the canvas.
@@ -473,6 +564,8 @@ extern int	Table_SelIncludesCmd _ANSI_ARGS_((ClientData clientData,
 			Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]));
 extern int	Table_SelSetCmd _ANSI_ARGS_((ClientData clientData,
 			Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]));
+extern int	Table_StatsCmd _ANSI_ARGS_((ClientData clientData,
+			Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]));
 extern int	Table_ViewCmd _ANSI_ARGS_((ClientData clientData,
 			Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]));
 
@@ -499,6 +592,10 @@ extern void	TableInvertTag _ANSI_ARGS_((TableTag *baseTag));
 extern int	TableGetTagBorders _ANSI_ARGS_((TableTag *tagPtr,
 			int *left, int *right, int *top, int *bottom));
 extern void	TableInitTags _ANSI_ARGS_((Table *tablePtr));
+extern TableStyle *TableGetStyle _ANSI_ARGS_((Table *tablePtr,
+			TableTag *colPtr, TableTag *rowPtr, TableTag *cellPtr,
+			int flags));
+extern void	TableFlushStyles _ANSI_ARGS_((Table *tablePtr));
 extern TableTag *FindRowColTag _ANSI_ARGS_((Table *tablePtr,
 			int cell, int type));
 extern void	TableCleanupTag _ANSI_ARGS_((Table *tablePtr,
@@ -518,6 +615,14 @@ extern CONST86 char *	TableOptionBdGet _ANSI_ARGS_((ClientData clientData,
 			Tcl_FreeProc **freeProcPtr));
 extern int	TableTagConfigureBd _ANSI_ARGS_((Table *tablePtr,
 			TableTag *tagPtr, char *oldValue, int nullOK));
+extern void	TableGeomReset _ANSI_ARGS_((TableGeom *geomPtr, int count,
+			int size));
+extern void	TableGeomSet _ANSI_ARGS_((TableGeom *geomPtr, int i,
+			int pixels));
+extern int	TableGeomPixels _ANSI_ARGS_((TableGeom *geomPtr, int i));
+extern int	TableGeomStart _ANSI_ARGS_((TableGeom *geomPtr, int i));
+extern int	TableGeomFind _ANSI_ARGS_((TableGeom *geomPtr, int pixel));
+extern void	TableGeomFree _ANSI_ARGS_((TableGeom *geomPtr));
 extern int	Cmd_OptionSet _ANSI_ARGS_((ClientData clientData,
 					   Tcl_Interp *interp,
 					   Tk_Window unused, CONST84 char *value,
@@ -550,6 +655,16 @@ extern int    TableMoveCellValue _ANSI_ARGS_((Table *tablePtr,
 			int fromr, int fromc, char *frombuf,
 			int tor, int toc, char *tobuf, int outOfBounds));
 
+extern Tcl_Obj *	TableStoreGet _ANSI_ARGS_((Table *tablePtr, int r, int c));
+extern void	TableStoreSet _ANSI_ARGS_((Table *tablePtr, int r, int c,
+			Tcl_Obj *valuePtr));
+extern int	TableStoreFill _ANSI_ARGS_((Table *tablePtr, int r, int c,
+			int rows, int cols, Tcl_Obj *CONST objv[]));
+extern void	TableStoreResize _ANSI_ARGS_((Table *tablePtr));
+extern void	TableStoreFree _ANSI_ARGS_((Table *tablePtr));
+extern int	Table_StoreCmd _ANSI_ARGS_((ClientData clientData,
+			Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]));
+
 extern int	TableGetIcursor _ANSI_ARGS_((Table *tablePtr, char *arg,
 			int *posn));
 #define TableGetIcursorObj(tablePtr, objPtr, posnPtr) \
@@ -570,10 +685,11 @@ extern void	TableSpanSanCheck _ANSI_ARGS_((register Table *tablePtr));
  * HEADERS IN TKTABLECELLSORT
  */
 /*
- * We keep the old CellSort true because it is used for grabbing
- * the selection, so we really want them ordered
+ * The selection is always sorted, because grabbing it needs the cells
+ * ordered by row
  */
-extern char *	TableCellSort _ANSI_ARGS_((Table *tablePtr, char *str));
+extern TableCellPos *	TableSelCells _ANSI_ARGS_((Table *tablePtr,
+			int *countPtr));
 #ifdef NO_SORT_CELLS
 #  define TableCellSortObj(interp, objPtr) (objPtr)
 #else
@@ -597,6 +713,9 @@ extern void	Tcl_DStringAppendAll _ANSI_ARGS_(TCL_VARARGS(Tcl_DString *, arg1));
 
 EXTERN int Tktable_Init		_ANSI_ARGS_((Tcl_Interp *interp));
 EXTERN int Tktable_SafeInit	_ANSI_ARGS_((Tcl_Interp *interp));
+EXTERN int Tktable_StoreFill	_ANSI_ARGS_((Tcl_Interp *interp,
+			CONST char *pathName, int row, int col,
+			int rows, int cols, Tcl_Obj *CONST objv[]));
 
 extern void	TableGetActiveBuf _ANSI_ARGS_((register Table *tablePtr));
 extern void	ExpandPercents _ANSI_ARGS_((Table *tablePtr, const char *before,
@@ -628,6 +747,19 @@ extern void	TableAddFlash _ANSI_ARGS_((Table *tablePtr, int row, int col));
       */
 #define TableParseArrayIndex(r, c, i)	sscanf((i), "%d,%d", (r), (c))
 
+     /*
+      * Pixel size and first pixel of a row|col in real coords.
+      * The start of row|col rows|cols is the total height|width.
+      */
+#define TableRowPixels(tablePtr, i) \
+	TableGeomPixels(&((tablePtr)->rowGeom), (i))
+#define TableColPixels(tablePtr, i) \
+	TableGeomPixels(&((tablePtr)->colGeom), (i))
+#define TableRowStart(tablePtr, i) \
+	TableGeomStart(&((tablePtr)->rowGeom), (i))
+#define TableColStart(tablePtr, i) \
+	TableGeomStart(&((tablePtr)->colGeom), (i))
+
      /*
       * Macro for finding the last cell of the table
       */
@@ -96,8 +96,8 @@ TableCellCoords(Table *tablePtr, int row, int col,
      */
     CONSTRAIN(row, 0, tablePtr->rows-1);
     CONSTRAIN(col, 0, tablePtr->cols-1);
-    *w = tablePtr->colPixels[col];
-    *h = tablePtr->rowPixels[row];
+    *w = TableColPixels(tablePtr, col);
+    *h = TableRowPixels(tablePtr, row);
     /*
      * Adjust for sizes of spanning cells
      * and ensure that this cell isn't "hidden"
@@ -136,7 +136,7 @@ TableCellCoords(Table *tablePtr, int row, int col,
 		} else {
 		    rs = MIN(tablePtr->rows-1, row+rs);
 		}
-		*h = tablePtr->rowStarts[rs+1]-tablePtr->rowStarts[row];
+		*h = TableRowStart(tablePtr, rs+1)-TableRowStart(tablePtr, row);
 		result = CELL_SPAN;
 	    } else if (rs <= 0) {
 		/* currently negative spans are not supported */
@@ -150,7 +150,7 @@ TableCellCoords(Table *tablePtr, int row, int col,
 		} else {
 		    cs = MIN(tablePtr->cols-1, col+cs);
 		}
-		*w = tablePtr->colStarts[cs+1]-tablePtr->colStarts[col];
+		*w = TableColStart(tablePtr, cs+1)-TableColStart(tablePtr, col);
 		result = CELL_SPAN;
 	    } else if (cs <= 0) {
 		/* currently negative spans are not supported */
@@ -158,15 +158,15 @@ TableCellCoords(Table *tablePtr, int row, int col,
 	}
     }
 setxy:
-    *x = hl + tablePtr->colStarts[col];
+    *x = hl + TableColStart(tablePtr, col);
     if (col >= tablePtr->titleCols) {
-	*x -= tablePtr->colStarts[tablePtr->leftCol]
-	    - tablePtr->colStarts[tablePtr->titleCols];
+	*x -= TableColStart(tablePtr, tablePtr->leftCol)
+	    - TableColStart(tablePtr, tablePtr->titleCols);
     }
-    *y = hl + tablePtr->rowStarts[row];
+    *y = hl + TableRowStart(tablePtr, row);
     if (row >= tablePtr->titleRows) {
-	*y -= tablePtr->rowStarts[tablePtr->topRow]
-	    - tablePtr->rowStarts[tablePtr->titleRows];
+	*y -= TableRowStart(tablePtr, tablePtr->topRow)
+	    - TableRowStart(tablePtr, tablePtr->titleRows);
     }
     return result;
 }
@@ -216,8 +216,8 @@ TableCellVCoords(Table *tablePtr, int row, int col,
 	 * we might need to treat full better is CELL_SPAN but primary
 	 * cell is visible
 	 */
-	int topX = tablePtr->colStarts[tablePtr->titleCols]+hl;
-	int topY = tablePtr->rowStarts[tablePtr->titleRows]+hl;
+	int topX = TableColStart(tablePtr, tablePtr->titleCols)+hl;
+	int topY = TableRowStart(tablePtr, tablePtr->titleRows)+hl;
 	if ((col < tablePtr->leftCol) && (col >= tablePtr->titleCols)) {
 	    if (full || (x+w < topX)) {
 		return 0;
@@ -294,25 +294,22 @@ TableCellVCoords(Table *tablePtr, int row, int col,
 void
 TableWhatCell(register Table *tablePtr, int x, int y, int *row, int *col)
 {
-    int i;
     x = MAX(0, x); y = MAX(0, y);
     /* Adjust for table's global highlightthickness border */
     x -= tablePtr->highlightWidth;
     y -= tablePtr->highlightWidth;
     /* Adjust the x coord if not in the column titles to change display coords
      * into internal coords */
-    x += (x < tablePtr->colStarts[tablePtr->titleCols]) ? 0 :
-	tablePtr->colStarts[tablePtr->leftCol] -
-	tablePtr->colStarts[tablePtr->titleCols];
-    y += (y < tablePtr->rowStarts[tablePtr->titleRows]) ? 0 :
-	tablePtr->rowStarts[tablePtr->topRow] -
-	tablePtr->rowStarts[tablePtr->titleRows];
+    x += (x < TableColStart(tablePtr, tablePtr->titleCols)) ? 0 :
+	TableColStart(tablePtr, tablePtr->leftCol) -
+	TableColStart(tablePtr, tablePtr->titleCols);
+    y += (y < TableRowStart(tablePtr, tablePtr->titleRows)) ? 0 :
+	TableRowStart(tablePtr, tablePtr->topRow) -
+	TableRowStart(tablePtr, tablePtr->titleRows);
     x = MIN(x, tablePtr->maxWidth-1);
     y = MIN(y, tablePtr->maxHeight-1);
-    for (i = 1; x >= tablePtr->colStarts[i]; i++);
-    *col = i - 1;
-    for (i = 1; y >= tablePtr->rowStarts[i]; i++);
-    *row = i - 1;
+    *col = TableGeomFind(&(tablePtr->colGeom), x);
+    *row = TableGeomFind(&(tablePtr->rowGeom), y);
     if (tablePtr->spanAffTbl && !(tablePtr->flags & AVOID_SPANS)) {
 	char buf[INDEX_BUFSIZE];
 	Tcl_HashEntry *entryPtr;
@@ -366,13 +363,12 @@ TableAtBorder(Table * tablePtr, int x, int y, int *row, int *col)
      */
     x = MAX(0, x); y = MAX(0, y);
     x -= tablePtr->highlightWidth; y -= tablePtr->highlightWidth;
-    x += (x < tablePtr->colStarts[tablePtr->titleCols]) ? 0 :
-	tablePtr->colStarts[tablePtr->leftCol] -
-	tablePtr->colStarts[tablePtr->titleCols];
+    x += (x < TableColStart(tablePtr, tablePtr->titleCols)) ? 0 :
+	TableColStart(tablePtr, tablePtr->leftCol) -
+	TableColStart(tablePtr, tablePtr->titleCols);
     x = MIN(x, tablePtr->maxWidth - 1);
-    for (i = 1; (i <= tablePtr->cols) &&
-	     (x + (bd[0] + bd[1])) >= tablePtr->colStarts[i]; i++);
-    if (x > tablePtr->colStarts[--i] + bd[4]) {
+    i = TableGeomFind(&(tablePtr->colGeom), x + (bd[0] + bd[1]));
+    if (x > TableColStart(tablePtr, i) + bd[4]) {
 	borders--;
 	*col = -1;
 	bcol = (i < tablePtr->leftCol && i >= tablePtr->titleCols) ?
@@ -381,13 +377,12 @@ TableAtBorder(Table * tablePtr, int x, int y, int *row, int *col)
 	bcol = *col = (i < tablePtr->leftCol && i >= tablePtr->titleCols) ?
 	    tablePtr->titleCols-1 : i-1;
     }
-    y += (y < tablePtr->rowStarts[tablePtr->titleRows]) ? 0 :
-	tablePtr->rowStarts[tablePtr->topRow] -
-	tablePtr->rowStarts[tablePtr->titleRows];
+    y += (y < TableRowStart(tablePtr, tablePtr->titleRows)) ? 0 :
+	TableRowStart(tablePtr, tablePtr->topRow) -
+	TableRowStart(tablePtr, tablePtr->titleRows);
     y = MIN(y, tablePtr->maxHeight - 1);
-    for (i = 1; i <= tablePtr->rows &&
-	     (y + (bd[2] + bd[3])) >= tablePtr->rowStarts[i]; i++);
-    if (y > tablePtr->rowStarts[--i]+bd[5]) {
+    i = TableGeomFind(&(tablePtr->rowGeom), y + (bd[2] + bd[3]));
+    if (y > TableRowStart(tablePtr, i)+bd[5]) {
 	borders--;
 	*row = -1;
 	brow = (i < tablePtr->topRow && i >= tablePtr->titleRows) ?
@@ -455,6 +450,22 @@ TableGetCellValue(Table *tablePtr, int r, int c)
     Tcl_HashEntry *entryPtr = NULL;
     int new = 1;
 
+    if (tablePtr->dataSource & DATA_STORE) {
+	/*
+	 * The native store is indexed directly, so there is no need
+	 * to build the "r,c" index, nor to check the cache.
+	 */
+	Tcl_Obj *valuePtr = TableStoreGet(tablePtr,
+		r-tablePtr->rowOffset, c-tablePtr->colOffset);
+	if (valuePtr != NULL) {
+	    result = Tcl_GetString(valuePtr);
+	}
+#ifdef PROCS
+	TableMakeArrayIndex(r, c, buf);
+#endif
+	goto VALUE;
+    }
+
     TableMakeArrayIndex(r, c, buf);
 
     if (tablePtr->caching) {
@@ -567,11 +578,24 @@ TableSetCellValue(Table *tablePtr, int r, int c, const char *value)
     char buf[INDEX_BUFSIZE];
     int code = TCL_OK, flash = 0;
 
-    TableMakeArrayIndex(r, c, buf);
-
     if (tablePtr->state == STATE_DISABLED) {
 	return TCL_OK;
     }
+    if (tablePtr->dataSource & DATA_STORE) {
+	TableStoreSet(tablePtr, r-tablePtr->rowOffset, c-tablePtr->colOffset,
+		(value == NULL || *value == '\0') ? (Tcl_Obj *) NULL :
+		Tcl_NewStringObj(value, -1));
+	if (tablePtr->flashMode) {
+	    r -= tablePtr->rowOffset;
+	    c -= tablePtr->colOffset;
+	    TableAddFlash(tablePtr, r, c);
+	    TableRefresh(tablePtr, r, c, CELL);
+	}
+	return TCL_OK;
+    }
+
+    TableMakeArrayIndex(r, c, buf);
+
     if (tablePtr->command && tablePtr->useCmd) {
 	Tcl_DString script;
 
@@ -665,6 +689,28 @@ TableMoveCellValue(Table *tablePtr, int fromr, int fromc, char *frombuf,
 	return TableSetCellValue(tablePtr, tor, toc, "");
     }
 
+    if (tablePtr->dataSource & DATA_STORE) {
+	/*
+	 * Just hand the value over, the reference moves with it.
+	 */
+	Tcl_Obj *valuePtr;
+
+	if (tablePtr->state == STATE_DISABLED) {
+	    return TCL_OK;
+	}
+	valuePtr = TableStoreGet(tablePtr, fromr-tablePtr->rowOffset,
+		fromc-tablePtr->colOffset);
+	if (valuePtr != NULL) {
+	    Tcl_IncrRefCount(valuePtr);
+	}
+	TableStoreSet(tablePtr, tor-tablePtr->rowOffset,
+		toc-tablePtr->colOffset, valuePtr);
+	if (valuePtr != NULL) {
+	    Tcl_DecrRefCount(valuePtr);
+	}
+	return TCL_OK;
+    }
+
     if (tablePtr->caching && (!(tablePtr->command && tablePtr->useCmd))) {
 	Tcl_HashEntry *entryPtr;
 	/*
@@ -719,6 +765,407 @@ TableMoveCellValue(Table *tablePtr, int fromr, int fromc, char *frombuf,
 
 }
 
+/*
+ * The native cell store.  A dense store keeps one value pointer per cell
+ * in a single row-major array that follows the table dimensions.  A sparse
+ * store only keeps runs of STORE_CHUNK_SIZE cells along a row for those
+ * parts of the table that hold values, so huge mostly empty tables cost
+ * next to nothing.  Either way, cells are addressed by integer row,col and
+ * never go through the "r,c" string index.
+ */
+typedef struct {
+    int used;			/* number of non-empty cells in the run */
+    Tcl_Obj *cells[STORE_CHUNK_SIZE];
+} TableStoreChunk;
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * StoreGet --
+ *	Looks up a cell of the store, in table (0-based) coords.
+ *
+ * Results:
+ *	The value of the cell, or NULL if it is empty.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+static Tcl_Obj *
+StoreGet(TableStore *storePtr, int r, int c)
+{
+    if (r < 0 || c < 0) {
+	return NULL;
+    }
+    if (storePtr->mode == STORE_DENSE) {
+	if (storePtr->cells == NULL ||
+	    r >= storePtr->rows || c >= storePtr->cols) {
+	    return NULL;
+	}
+	return storePtr->cells[(size_t) r * storePtr->cols + c];
+    } else if (storePtr->mode == STORE_SPARSE) {
+	Tcl_HashEntry *entryPtr;
+	int key[2];
+
+	key[0] = r;
+	key[1] = c >> STORE_CHUNK_BITS;
+	entryPtr = Tcl_FindHashEntry(storePtr->chunks, (char *) key);
+	if (entryPtr != NULL) {
+	    return ((TableStoreChunk *) Tcl_GetHashValue(entryPtr))
+		->cells[c & STORE_CHUNK_MASK];
+	}
+    }
+    return NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * StorePut --
+ *	Stores a value in a cell of the store, in table (0-based) coords.
+ *	A NULL or empty value clears the cell.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The store takes its own reference to the value, and releases
+ *	the one to the previous value.  Cells outside a dense store
+ *	are silently dropped.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+StorePut(TableStore *storePtr, int r, int c, Tcl_Obj *valuePtr)
+{
+    Tcl_Obj **slotPtr = NULL, *oldPtr;
+    TableStoreChunk *chunkPtr = NULL;
+    Tcl_HashEntry *entryPtr = NULL;
+    int len, new;
+
+    if (valuePtr != NULL) {
+	Tcl_IncrRefCount(valuePtr);
+	Tcl_GetStringFromObj(valuePtr, &len);
+	if (len == 0) {
+	    Tcl_DecrRefCount(valuePtr);
+	    valuePtr = NULL;
+	}
+    }
+    if (r < 0 || c < 0) {
+	goto DROP;
+    }
+
+    if (storePtr->mode == STORE_DENSE) {
+	if (r >= storePtr->rows || c >= storePtr->cols) {
+	    goto DROP;
+	}
+	if (storePtr->cells == NULL) {
+	    size_t size = (size_t) storePtr->rows * storePtr->cols;
+
+	    if (valuePtr == NULL) {
+		return;
+	    }
+	    if (size > ((unsigned int) -1) / sizeof(Tcl_Obj *)) {
+		/* too big for one block, -datastore sparse is for that */
+		goto DROP;
+	    }
+	    storePtr->cells = (Tcl_Obj **) ckalloc(size * sizeof(Tcl_Obj *));
+	    memset((VOID *) storePtr->cells, 0, size * sizeof(Tcl_Obj *));
+	}
+	slotPtr = &(storePtr->cells[(size_t) r * storePtr->cols + c]);
+    } else if (storePtr->mode == STORE_SPARSE) {
+	int key[2];
+
+	key[0] = r;
+	key[1] = c >> STORE_CHUNK_BITS;
+	if (valuePtr == NULL) {
+	    entryPtr = Tcl_FindHashEntry(storePtr->chunks, (char *) key);
+	    if (entryPtr == NULL) {
+		return;
+	    }
+	} else {
+	    entryPtr = Tcl_CreateHashEntry(storePtr->chunks, (char *) key,
+		    &new);
+	    if (new) {
+		chunkPtr = (TableStoreChunk *) ckalloc(sizeof(TableStoreChunk));
+		memset((VOID *) chunkPtr, 0, sizeof(TableStoreChunk));
+		Tcl_SetHashValue(entryPtr, (ClientData) chunkPtr);
+	    }
+	}
+	chunkPtr = (TableStoreChunk *) Tcl_GetHashValue(entryPtr);
+	slotPtr = &(chunkPtr->cells[c & STORE_CHUNK_MASK]);
+    } else {
+	goto DROP;
+    }
+
+    oldPtr = *slotPtr;
+    *slotPtr = valuePtr;
+    if (oldPtr != NULL) {
+	Tcl_DecrRefCount(oldPtr);
+	storePtr->count--;
+	if (chunkPtr) chunkPtr->used--;
+    }
+    if (valuePtr != NULL) {
+	storePtr->count++;
+	if (chunkPtr) chunkPtr->used++;
+    }
+    if (chunkPtr && chunkPtr->used == 0) {
+	ckfree((char *) chunkPtr);
+	Tcl_DeleteHashEntry(entryPtr);
+    }
+    return;
+
+    DROP:
+    if (valuePtr != NULL) {
+	Tcl_DecrRefCount(valuePtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * StoreRelease --
+ *	Releases all the values held in a store.  If intoPtr is not
+ *	NULL, the values that fit into it are moved there first.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The store is emptied and its memory freed.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+StoreRelease(TableStore *storePtr, TableStore *intoPtr)
+{
+    Tcl_Obj *valuePtr;
+    int r, c, i;
+
+    if (storePtr->mode == STORE_DENSE && storePtr->cells != NULL) {
+	Tcl_Obj **cellPtr = storePtr->cells;
+
+	for (r = 0; r < storePtr->rows; r++) {
+	    for (c = 0; c < storePtr->cols; c++, cellPtr++) {
+		if ((valuePtr = *cellPtr) != NULL) {
+		    if (intoPtr) StorePut(intoPtr, r, c, valuePtr);
+		    Tcl_DecrRefCount(valuePtr);
+		}
+	    }
+	}
+	ckfree((char *) storePtr->cells);
+    } else if (storePtr->mode == STORE_SPARSE) {
+	Tcl_HashEntry *entryPtr;
+	Tcl_HashSearch search;
+	TableStoreChunk *chunkPtr;
+	int *key;
+
+	for (entryPtr = Tcl_FirstHashEntry(storePtr->chunks, &search);
+	     entryPtr != NULL; entryPtr = Tcl_NextHashEntry(&search)) {
+	    key = (int *) Tcl_GetHashKey(storePtr->chunks, entryPtr);
+	    chunkPtr = (TableStoreChunk *) Tcl_GetHashValue(entryPtr);
+	    for (i = 0; i < STORE_CHUNK_SIZE; i++) {
+		if ((valuePtr = chunkPtr->cells[i]) != NULL) {
+		    if (intoPtr) StorePut(intoPtr, key[0],
+			    (key[1] << STORE_CHUNK_BITS) + i, valuePtr);
+		    Tcl_DecrRefCount(valuePtr);
+		}
+	    }
+	    ckfree((char *) chunkPtr);
+	}
+	Tcl_DeleteHashTable(storePtr->chunks);
+	ckfree((char *) storePtr->chunks);
+    }
+    memset((VOID *) storePtr, 0, sizeof(TableStore));
+    storePtr->mode = STORE_NONE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableStoreGet --
+ *	Takes a row,col pair in table (0-based) coords and returns the
+ *	value held for it in the native store.
+ *
+ * Results:
+ *	The value object, or NULL for an empty cell.  The store keeps
+ *	the reference.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+Tcl_Obj *
+TableStoreGet(Table *tablePtr, int r, int c)
+{
+    return StoreGet(&(tablePtr->store), r, c);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableStoreSet --
+ *	Takes a row,col pair in table (0-based) coords and stores the
+ *	value in the native store.  A NULL or empty value clears the cell.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	A dense store follows the table dimensions if they grew.
+ *	No redraw is scheduled, that is up to the caller.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+TableStoreSet(Table *tablePtr, int r, int c, Tcl_Obj *valuePtr)
+{
+    TableStore *storePtr = &(tablePtr->store);
+
+    if (storePtr->mode == STORE_DENSE &&
+	(r >= storePtr->rows || c >= storePtr->cols)) {
+	TableStoreResize(tablePtr);
+    }
+    StorePut(storePtr, r, c, valuePtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableStoreFill --
+ *	Bulk loads a block of the native store.  objv holds rows*cols
+ *	values in row-major order, to be placed starting at the table
+ *	(0-based) cell r,c.  This is the C interface for data sources
+ *	that refresh large parts of a table at once.
+ *
+ * Results:
+ *	The number of cells set.  The block is bounded by the table
+ *	dimensions.
+ *
+ * Side effects:
+ *	The affected cells are redrawn, and flashed if -flashmode is on.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+TableStoreFill(Table *tablePtr, int r, int c, int rows, int cols,
+	       Tcl_Obj *CONST objv[])
+{
+    int i, j, maxr, maxc;
+
+    if (!(tablePtr->dataSource & DATA_STORE) || r < 0 || c < 0) {
+	return 0;
+    }
+    maxr = MIN(r+rows, tablePtr->rows);
+    maxc = MIN(c+cols, tablePtr->cols);
+    if (maxr <= r || maxc <= c) {
+	return 0;
+    }
+    if (tablePtr->store.mode != tablePtr->storeMode ||
+	(tablePtr->storeMode == STORE_DENSE &&
+	 (maxr > tablePtr->store.rows || maxc > tablePtr->store.cols))) {
+	TableStoreResize(tablePtr);
+    }
+    for (i = r; i < maxr; i++) {
+	Tcl_Obj *CONST *rowv = objv + (size_t) (i-r) * cols;
+	for (j = c; j < maxc; j++) {
+	    StorePut(&(tablePtr->store), i, j, rowv[j-c]);
+	}
+    }
+    if (tablePtr->flashMode) {
+	for (i = r; i < maxr; i++) {
+	    for (j = c; j < maxc; j++) {
+		TableAddFlash(tablePtr, i, j);
+	    }
+	}
+    }
+    if ((tablePtr->flags & HAS_ACTIVE) &&
+	tablePtr->activeRow >= r && tablePtr->activeRow < maxr &&
+	tablePtr->activeCol >= c && tablePtr->activeCol < maxc) {
+	TableGetActiveBuf(tablePtr);
+    }
+    if (maxr-r == 1 && maxc-c == 1) {
+	TableRefresh(tablePtr, r, c, CELL);
+    } else {
+	TableInvalidateAll(tablePtr, 0);
+    }
+    return (maxr-r) * (maxc-c);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableStoreResize --
+ *	Brings the native store in line with -datastore and the table
+ *	dimensions.  Values are carried over to a new layout, and those
+ *	that no longer fit a dense store are released.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	May reallocate the store.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+TableStoreResize(Table *tablePtr)
+{
+    TableStore *storePtr = &(tablePtr->store);
+    TableStore old;
+    int mode = tablePtr->storeMode;
+
+    if (mode != STORE_DENSE && mode != STORE_SPARSE) {
+	mode = STORE_NONE;
+    }
+    if (storePtr->mode == mode && (mode != STORE_DENSE ||
+	    (storePtr->rows == tablePtr->rows &&
+	     storePtr->cols == tablePtr->cols))) {
+	return;
+    }
+    if (mode == STORE_DENSE && storePtr->mode == STORE_DENSE &&
+	storePtr->cells == NULL) {
+	/* nothing allocated yet, just take the new dimensions */
+	storePtr->rows = tablePtr->rows;
+	storePtr->cols = tablePtr->cols;
+	return;
+    }
+
+    old = *storePtr;
+    memset((VOID *) storePtr, 0, sizeof(TableStore));
+    storePtr->mode = mode;
+    storePtr->rows = tablePtr->rows;
+    storePtr->cols = tablePtr->cols;
+    if (mode == STORE_SPARSE) {
+	storePtr->chunks = (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
+	Tcl_InitHashTable(storePtr->chunks, 2);
+    }
+    StoreRelease(&old, (mode == STORE_NONE) ? (TableStore *) NULL : storePtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableStoreFree --
+ *	Releases all values held in the native store.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The store is emptied and its memory freed.  The next
+ *	TableStoreResize sets up the layout again.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+TableStoreFree(Table *tablePtr)
+{
+    StoreRelease(&(tablePtr->store), (TableStore *) NULL);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1017,6 +1464,159 @@ Table_SetCmd(ClientData clientData, register Tcl_Interp *interp,
     return TCL_OK;
 }
 
+/* store subcommands */
+static CONST84 char *storeNames[] = {
+    "clear", "fill", "get", (char *)NULL
+};
+enum storeCommand {
+    STORE_CLEAR, STORE_FILL, STORE_GET
+};
+
+/*
+ *--------------------------------------------------------------
+ *
+ * Table_StoreCmd --
+ *	This procedure is invoked to process the store method
+ *	that corresponds to a widget managed by this module.
+ *	It gives bulk access to the native cell store.
+ *	See the user documentation for details on what it does.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	See the user documentation.
+ *
+ *--------------------------------------------------------------
+ */
+int
+Table_StoreCmd(ClientData clientData, register Tcl_Interp *interp,
+	       int objc, Tcl_Obj *CONST objv[])
+{
+    register Table *tablePtr = (Table *)clientData;
+    int cmdIndex, r1, c1, r2, c2, row, col, listc, count;
+    Tcl_Obj **listv, *resultPtr;
+
+    if (objc < 3) {
+	Tcl_WrongNumArgs(interp, 2, objv, "option ?arg arg ...?");
+	return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[2], storeNames,
+			    "store option", 0, &cmdIndex) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (!(tablePtr->dataSource & DATA_STORE)) {
+	Tcl_AppendStringsToObj(Tcl_GetObjResult(interp),
+		"no data store in table \"", Tk_PathName(tablePtr->tkwin),
+		"\", see -datastore", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    switch ((enum storeCommand) cmdIndex) {
+	case STORE_CLEAR:
+	    /* store clear ?first? ?last? */
+	    if (objc > 5) {
+		Tcl_WrongNumArgs(interp, 3, objv, "?first? ?last?");
+		return TCL_ERROR;
+	    }
+	    if (objc == 3) {
+		TableStoreFree(tablePtr);
+		TableStoreResize(tablePtr);
+	    } else {
+		if (TableGetIndexObj(tablePtr, objv[3], &r1, &c1) != TCL_OK ||
+		    TableGetIndexObj(tablePtr, objv[objc-1], &r2, &c2)
+		    != TCL_OK) {
+		    return TCL_ERROR;
+		}
+		r1 -= tablePtr->rowOffset; r2 -= tablePtr->rowOffset;
+		c1 -= tablePtr->colOffset; c2 -= tablePtr->colOffset;
+		for (row = MIN(r1,r2); row <= MAX(r1,r2); row++) {
+		    for (col = MIN(c1,c2); col <= MAX(c1,c2); col++) {
+			TableStoreSet(tablePtr, row, col, (Tcl_Obj *) NULL);
+		    }
+		}
+	    }
+	    if (tablePtr->flags & HAS_ACTIVE) {
+		TableGetActiveBuf(tablePtr);
+	    }
+	    TableInvalidateAll(tablePtr, 0);
+	    break;
+
+	case STORE_FILL: {
+	    /* store fill index rowList ?rowList ...? */
+	    int i, j, maxc, cols = 0;
+	    Tcl_Obj **cellv = NULL, **rowv;
+
+	    if (objc < 5) {
+		Tcl_WrongNumArgs(interp, 3, objv, "index rowList ?rowList ...?");
+		return TCL_ERROR;
+	    }
+	    if (TableGetIndexObj(tablePtr, objv[3], &r1, &c1) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    r1 -= tablePtr->rowOffset;
+	    c1 -= tablePtr->colOffset;
+	    rowv = (Tcl_Obj **) objv + 4;
+	    count = objc - 4;
+	    count = MIN(count, tablePtr->rows - r1);
+	    maxc = tablePtr->cols - c1;
+	    for (i = 0; i < count; i++) {
+		if (Tcl_ListObjGetElements(interp, rowv[i], &listc, &listv)
+		    != TCL_OK) {
+		    return TCL_ERROR;
+		}
+		cols = MAX(cols, MIN(listc, maxc));
+	    }
+	    if (count <= 0 || cols <= 0) {
+		Tcl_SetIntObj(Tcl_GetObjResult(interp), 0);
+		break;
+	    }
+	    /*
+	     * Lay the rows out as one row-major block.  Short rows
+	     * leave the rest of their cells untouched.
+	     */
+	    cellv = (Tcl_Obj **) ckalloc(sizeof(Tcl_Obj *) * count * cols);
+	    for (i = 0; i < count; i++) {
+		Tcl_ListObjGetElements(NULL, rowv[i], &listc, &listv);
+		for (j = 0; j < cols; j++) {
+		    cellv[i*cols+j] = (j < listc) ? listv[j] :
+			TableStoreGet(tablePtr, r1+i, c1+j);
+		}
+	    }
+	    count = TableStoreFill(tablePtr, r1, c1, count, cols, cellv);
+	    ckfree((char *) cellv);
+	    Tcl_SetIntObj(Tcl_GetObjResult(interp), count);
+	    break;
+	}
+
+	case STORE_GET:
+	    /* store get first ?last? */
+	    if (objc != 4 && objc != 5) {
+		Tcl_WrongNumArgs(interp, 3, objv, "first ?last?");
+		return TCL_ERROR;
+	    }
+	    if (TableGetIndexObj(tablePtr, objv[3], &r1, &c1) != TCL_OK ||
+		TableGetIndexObj(tablePtr, objv[objc-1], &r2, &c2) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    r1 -= tablePtr->rowOffset; r2 -= tablePtr->rowOffset;
+	    c1 -= tablePtr->colOffset; c2 -= tablePtr->colOffset;
+	    resultPtr = Tcl_NewObj();
+	    for (row = MIN(r1,r2); row <= MAX(r1,r2); row++) {
+		Tcl_Obj *rowPtr = Tcl_NewObj(), *valuePtr;
+		for (col = MIN(c1,c2); col <= MAX(c1,c2); col++) {
+		    valuePtr = TableStoreGet(tablePtr, row, col);
+		    Tcl_ListObjAppendElement(NULL, rowPtr, (valuePtr != NULL) ?
+			    valuePtr : Tcl_NewObj());
+		}
+		Tcl_ListObjAppendElement(NULL, resultPtr, rowPtr);
+	    }
+	    Tcl_SetObjResult(interp, resultPtr);
+	    break;
+    }
+    return TCL_OK;
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -2,8 +2,10 @@
  * tkTableCell.c --
  *
  *	This module implements cell sort functions for table
- *	widgets.  The MergeSort algorithm and other aux sorting
- *	functions were taken from tclCmdIL.c lsort command:
+ *	widgets.  Cells are sorted as (row, col) integer pairs with a
+ *	radix sort.  Lists that aren't all cells fall back to the
+ *	MergeSort algorithm and other aux sorting functions, which
+ *	were taken from tclCmdIL.c lsort command:
 
  * tclCmdIL.c --
  *
@@ -43,75 +45,191 @@ typedef struct SortElement {
 					 * NULL for end of list. */
 } SortElement;
 
-static int		TableSortCompareProc _ANSI_ARGS_((CONST VOID *first,
-							  CONST VOID *second));
+/*
+ * Cells are sorted as structures of the following type, with what is
+ * to be returned for the cell in data.
+ */
+
+typedef struct CellElement {
+    int row, col;			/* User coords of the cell. */
+    ClientData data;			/* Whatever the cell stands for. */
+} CellElement;
+
+static int		ParseCell _ANSI_ARGS_((CONST char *str,
+					       int *rowPtr, int *colPtr));
+static void		RadixSortCells _ANSI_ARGS_((CellElement *cells,
+						    int length));
+#ifndef NO_SORT_CELLS
 static SortElement *    MergeSort _ANSI_ARGS_((SortElement *headPt));
 static SortElement *    MergeLists _ANSI_ARGS_((SortElement *leftPtr,
 						SortElement *rightPtr));
 static int		DictionaryCompare _ANSI_ARGS_((char *left,
 						       char *right));
+#endif
 
 /*
  *----------------------------------------------------------------------
  *
- * TableSortCompareProc --
- *	This procedure is invoked by qsort to determine the proper
- *	ordering between two elements.
+ * ParseCell --
+ *	Parses a cell index of the form row,col.  Unlike sscanf, this
+ *	doesn't depend on the locale and accepts nothing else around
+ *	the two integers.
  *
  * Results:
- *	< 0 means first is "smaller" than "second", > 0 means "first"
- *	is larger than "second", and 0 means they should be treated
- *	as equal.
+ *	1 and the row and col in rowPtr and colPtr if str is a cell
+ *	index, 0 otherwise.
  *
  * Side effects:
- *	None, unless a user-defined comparison command does something
- *	weird.
+ *	None.
  *
  *----------------------------------------------------------------------
  */
 static int
-TableSortCompareProc(first, second)
-    CONST VOID *first, *second;		/* Elements to be compared. */
+ParseCell(CONST char *str, int *rowPtr, int *colPtr)
 {
-    char *str1 = *((char **) first);
-    char *str2 = *((char **) second);
+    int i, neg, digits, value[2];
+    unsigned long n;
 
-    return DictionaryCompare(str1, str2);
+    for (i = 0; i < 2; i++) {
+	neg = (*str == '-');
+	if (neg) {
+	    str++;
+	}
+	for (n = 0, digits = 0; *str >= '0' && *str <= '9'; str++, digits++) {
+	    n = n * 10 + (*str - '0');
+	    if (n > 0x7fffffffUL) {
+		return 0;
+	    }
+	}
+	if (digits == 0 || *str != ((i == 0) ? ',' : '\0')) {
+	    return 0;
+	}
+	str++;
+	value[i] = neg ? -((int) n) : (int) n;
+    }
+    *rowPtr = value[0];
+    *colPtr = value[1];
+    return 1;
 }
 
 /*
  *----------------------------------------------------------------------
  *
- * TableCellSort --
- *	Sort a list of table cell elements (of form row,col)
+ * RadixSortCells --
+ *	Sorts an array of cells by row, then col, with a least
+ *	significant digit radix sort on bytes.  Bytes that are the same
+ *	for all cells, like the high bytes of small rows and cols, are
+ *	skipped, so the usual table takes 2 or 3 passes.
  *
  * Results:
- *	Returns the sorted list of elements.  Because Tcl_Merge allocs
- *	the space for result, it must later be Tcl_Free'd by caller.
+ *	None.
  *
  * Side effects:
- *	Behaviour undefined for ill-formed input list of elements.
+ *	The cells are sorted in place.  The sort is stable.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+RadixSortCells(CellElement *cells, int length)
+{
+    /*
+     * Pass 0-3 are the bytes of col from the lowest, 4-7 those of row.
+     * The sign bit is flipped so that negative indices come first.
+     */
+#   define CELL_BYTE(cellPtr, pass) \
+	(((((unsigned) ((pass) < 4 ? (cellPtr)->col : (cellPtr)->row)) \
+		^ 0x80000000U) >> (((pass) & 3) * 8)) & 0xff)
+    int count[8][256];
+    CellElement *from = cells, *to, *tmp;
+    int i, pass, pos, n;
+
+    if (length < 2) {
+	return;
+    }
+    memset((VOID *) count, 0, sizeof(count));
+    for (i = 0; i < length; i++) {
+	for (pass = 0; pass < 8; pass++) {
+	    count[pass][CELL_BYTE(&cells[i], pass)]++;
+	}
+    }
+
+    to = (CellElement *) ckalloc(length * sizeof(CellElement));
+    tmp = to;
+    for (pass = 0; pass < 8; pass++) {
+	if (count[pass][CELL_BYTE(&from[0], pass)] == length) {
+	    /* all cells have the same byte here */
+	    continue;
+	}
+	for (i = 0, pos = 0; i < 256; i++) {
+	    n = count[pass][i];
+	    count[pass][i] = pos;
+	    pos += n;
+	}
+	for (i = 0; i < length; i++) {
+	    to[count[pass][CELL_BYTE(&from[i], pass)]++] = from[i];
+	}
+	to = from;
+	from = (to == cells) ? tmp : cells;
+    }
+    if (from != cells) {
+	memcpy((VOID *) cells, (VOID *) from, length * sizeof(CellElement));
+    }
+    ckfree((char *) tmp);
+#   undef CELL_BYTE
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableSelCells --
+ *	Gets the selected cells, sorted by row then col.
+ *
+ * Results:
+ *	Returns a ckalloc'ed array of the selected cells in user coords,
+ *	which must later be ckfree'd by the caller, and their number in
+ *	countPtr.  The array is NULL if nothing is selected.
+ *
+ * Side effects:
+ *	None.
  *
  *----------------------------------------------------------------------
  */
-char *
-TableCellSort(Table *tablePtr, char *str)
+TableCellPos *
+TableSelCells(Table *tablePtr, int *countPtr)
 {
-    int listArgc;
-    const char **listArgv;
-    char *result;
+    Tcl_HashEntry *entryPtr;
+    Tcl_HashSearch search;
+    CellElement *cells;
+    TableCellPos *result;
+    char *key;
+    int length, i;
 
-    if (Tcl_SplitList(tablePtr->interp, str, &listArgc, &listArgv) != TCL_OK) {
-	return str;
+    length = tablePtr->selCells->numEntries;
+    *countPtr = length;
+    if (length == 0) {
+	return NULL;
+    }
+
+    cells = (CellElement *) ckalloc(length * sizeof(CellElement));
+    for (i = 0, entryPtr = Tcl_FirstHashEntry(tablePtr->selCells, &search);
+	 entryPtr != NULL; i++, entryPtr = Tcl_NextHashEntry(&search)) {
+	key = Tcl_GetHashKey(tablePtr->selCells, entryPtr);
+	if (!ParseCell(key, &cells[i].row, &cells[i].col)) {
+	    TableParseArrayIndex(&cells[i].row, &cells[i].col, key);
+	}
     }
-    /* Thread safety: qsort is reportedly not thread-safe... */
-    qsort((VOID *) listArgv, (size_t) listArgc, sizeof (char *),
-	  TableSortCompareProc);
-    result = Tcl_Merge(listArgc, listArgv);
-    ckfree((char *) listArgv);
+    RadixSortCells(cells, length);
+
+    result = (TableCellPos *) ckalloc(length * sizeof(TableCellPos));
+    for (i = 0; i < length; i++) {
+	result[i].row = cells[i].row;
+	result[i].col = cells[i].col;
+    }
+    ckfree((char *) cells);
     return result;
 }
 
+#ifndef NO_SORT_CELLS
 /*
  *----------------------------------------------------------------------
  *
@@ -351,7 +469,6 @@ MergeSort(headPtr)
     return elementPtr;
 }
 
-#ifndef NO_SORT_CELLS
 /*
  *----------------------------------------------------------------------
  *
@@ -359,7 +476,9 @@ MergeSort(headPtr)
  *	Sorts a list of table cell elements (of form row,col) in place
  *
  * Results:
- *	Sorts list of elements in place.
+ *	Sorts list of elements in place.  When all elements are cells,
+ *	they are sorted numerically by row then col, otherwise they
+ *	are sorted in dictionary order.
  *
  * Side effects:
  *	Behaviour undefined for ill-formed input list of elements.
@@ -373,6 +492,7 @@ TableCellSortObj(Tcl_Interp *interp, Tcl_Obj *listObjPtr)
     Tcl_Obj *sortedObjPtr, **listObjPtrs;
     SortElement *elementArray;
     SortElement *elementPtr;
+    CellElement *cells;
 
     if (Tcl_ListObjGetElements(interp, listObjPtr,
 			       &length, &listObjPtrs) != TCL_OK) {
@@ -382,6 +502,27 @@ TableCellSortObj(Tcl_Interp *interp, Tcl_Obj *listObjPtr)
 	return listObjPtr;
     }
 
+    /* Cells are sorted as integers, parsing each only once */
+    cells = (CellElement *) ckalloc(length * sizeof(CellElement));
+    for (i = 0; i < length; i++) {
+	if (!ParseCell(Tcl_GetString(listObjPtrs[i]),
+		       &cells[i].row, &cells[i].col)) {
+	    break;
+	}
+	cells[i].data = (ClientData) listObjPtrs[i];
+    }
+    if (i == length) {
+	RadixSortCells(cells, length);
+	sortedObjPtr = Tcl_NewObj();
+	for (i = 0; i < length; i++) {
+	    Tcl_ListObjAppendElement(NULL, sortedObjPtr,
+				     (Tcl_Obj *) cells[i].data);
+	}
+	ckfree((char *) cells);
+	return sortedObjPtr;
+    }
+    ckfree((char *) cells);
+
     elementArray = (SortElement *) ckalloc(length * sizeof(SortElement));
     for (i=0; i < length; i++){
 	elementArray[i].objPtr = listObjPtrs[i];
@@ -665,14 +665,21 @@ Table_CurselectionCmd(ClientData clientData, register Tcl_Interp *interp,
 	}
     } else {
 	Tcl_Obj *objPtr = Tcl_NewObj();
+	TableCellPos *cells;
+	char buf[INDEX_BUFSIZE];
+	int i, numCells;
 
-	for (entryPtr = Tcl_FirstHashEntry(tablePtr->selCells, &search);
-	     entryPtr != NULL; entryPtr = Tcl_NextHashEntry(&search)) {
-	    value = Tcl_GetHashKey(tablePtr->selCells, entryPtr);
+	/* The cells are sorted as integers, the indices only made here */
+	cells = TableSelCells(tablePtr, &numCells);
+	for (i = 0; i < numCells; i++) {
+	    TableMakeArrayIndex(cells[i].row, cells[i].col, buf);
 	    Tcl_ListObjAppendElement(NULL, objPtr,
-				     Tcl_NewStringObj(value, -1));
+				     Tcl_NewStringObj(buf, -1));
 	}
-	Tcl_SetObjResult(interp, TableCellSortObj(interp, objPtr));
+	if (cells != NULL) {
+	    ckfree((char *) cells);
+	}
+	Tcl_SetObjResult(interp, objPtr);
     }
     return TCL_OK;
 }
@@ -846,6 +853,7 @@ Table_ScanCmd(ClientData clientData, register Tcl_Interp *interp,
 
 	    /* Adjust the table if new top left */
 	    if (oldTop != tablePtr->topRow || oldLeft != tablePtr->leftCol) {
+		tablePtr->flags |= SCROLL_BLIT;
 		TableAdjustParams(tablePtr);
 	    }
 	    break;
@@ -1134,6 +1142,63 @@ SET_CELLS:
     return TCL_OK;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * Table_StatsCmd --
+ *	This procedure is invoked to process the stats method
+ *	that corresponds to a table widget managed by this module.
+ *	See the user documentation for details on what it does.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	The statistics are zeroed by "stats reset".
+ *
+ *--------------------------------------------------------------
+ */
+int
+Table_StatsCmd(ClientData clientData, register Tcl_Interp *interp,
+	       int objc, Tcl_Obj *CONST objv[])
+{
+    register Table *tablePtr = (Table *) clientData;
+    TableStats *statsPtr = &(tablePtr->stats);
+    Tcl_Obj *resultPtr;
+
+    if (objc > 3 || (objc == 3 && strcmp(Tcl_GetString(objv[2]), "reset"))) {
+	Tcl_WrongNumArgs(interp, 2, objv, "?reset?");
+	return TCL_ERROR;
+    }
+
+    resultPtr = Tcl_GetObjResult(interp);
+    Tcl_ListObjAppendElement(NULL, resultPtr, Tcl_NewStringObj("redraws", -1));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewLongObj(statsPtr->redraws));
+    Tcl_ListObjAppendElement(NULL, resultPtr, Tcl_NewStringObj("cells", -1));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewLongObj(statsPtr->cells));
+    Tcl_ListObjAppendElement(NULL, resultPtr, Tcl_NewStringObj("blits", -1));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewLongObj(statsPtr->blits));
+    Tcl_ListObjAppendElement(NULL, resultPtr, Tcl_NewStringObj("usecs", -1));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewLongObj(statsPtr->usecs));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewStringObj("lastcells", -1));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewLongObj(statsPtr->lastCells));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewStringObj("lastusecs", -1));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewLongObj(statsPtr->lastUsecs));
+
+    if (objc == 3) {
+	memset((VOID *) statsPtr, 0, sizeof(TableStats));
+    }
+    return TCL_OK;
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -1178,20 +1243,20 @@ Table_ViewCmd(ClientData clientData, register Tcl_Interp *interp,
 		first = 0;
 		last  = 1;
 	    } else {
-		diff = tablePtr->rowStarts[tablePtr->titleRows];
-		last = (double) (tablePtr->rowStarts[tablePtr->rows]-diff);
-		first = (tablePtr->rowStarts[tablePtr->topRow]-diff) / last;
-		last  = (h+tablePtr->rowStarts[row]-diff) / last;
+		diff = TableRowStart(tablePtr, tablePtr->titleRows);
+		last = (double) (TableRowStart(tablePtr, tablePtr->rows)-diff);
+		first = (TableRowStart(tablePtr, tablePtr->topRow)-diff) / last;
+		last  = (h+TableRowStart(tablePtr, row)-diff) / last;
 	    }
 	} else {
 	    if (col < tablePtr->titleCols) {
 		first = 0;
 		last  = 1;
 	    } else {
-		diff = tablePtr->colStarts[tablePtr->titleCols];
-		last = (double) (tablePtr->colStarts[tablePtr->cols]-diff);
-		first = (tablePtr->colStarts[tablePtr->leftCol]-diff) / last;
-		last  = (w+tablePtr->colStarts[col]-diff) / last;
+		diff = TableColStart(tablePtr, tablePtr->titleCols);
+		last = (double) (TableColStart(tablePtr, tablePtr->cols)-diff);
+		first = (TableColStart(tablePtr, tablePtr->leftCol)-diff) / last;
+		last  = (w+TableColStart(tablePtr, col)-diff) / last;
 	    }
 	}
 	Tcl_ListObjAppendElement(NULL, resultPtr, Tcl_NewDoubleObj(first));
@@ -1259,6 +1324,7 @@ Table_ViewCmd(ClientData clientData, register Tcl_Interp *interp,
 	CONSTRAIN(tablePtr->leftCol, tablePtr->titleCols, tablePtr->cols-1);
 	/* Do the table adjustment if topRow || leftCol changed */
 	if (oldTop != tablePtr->topRow || oldLeft != tablePtr->leftCol) {
+	    tablePtr->flags |= SCROLL_BLIT;
 	    TableAdjustParams(tablePtr);
 	}
     }
@@ -91,6 +91,18 @@ typedef struct {
     unsigned int pstate, pjustify, pmultiline, pwrap, pshowtext;
 } TableJoinTag;
 
+/*
+ * The key of a cached composite tag in styleTable.  Tags are keyed by
+ * their pointers, which stay unique until the tag is deleted, and that
+ * flushes the cache.
+ */
+typedef struct {
+    TableTag	*colPtr, *rowPtr, *cellPtr;
+    long	flags;		/* STYLE_* bits */
+} TableStyleKey;
+
+#define STYLE_KEY_WORDS	(sizeof(TableStyleKey) / sizeof(int))
+
 /*
  *----------------------------------------------------------------------
  *
@@ -529,6 +541,137 @@ TableInitTags(Table *tablePtr)
     TableTagGetEntry(tablePtr, "active", ARSIZE(activeArgs), activeArgs);
     TableTagGetEntry(tablePtr, "sel", ARSIZE(selArgs), selArgs);
     TableTagGetEntry(tablePtr, "title", ARSIZE(titleArgs), titleArgs);
+
+    tablePtr->styleTable = (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
+    Tcl_InitHashTable(tablePtr->styleTable, STYLE_KEY_WORDS);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableGetStyle --
+ *	Gets the composite tag for a cell with the given col, row and
+ *	cell tags (any may be NULL) and STYLE_* flags, merging it only
+ *	the first time that combination is drawn.
+ *
+ * Results:
+ *	Returns the cached style.  It stays valid until the next call
+ *	to TableFlushStyles.
+ *
+ * Side effects:
+ *	May add an entry to the style cache.
+ *
+ *----------------------------------------------------------------------
+ */
+TableStyle *
+TableGetStyle(Table *tablePtr, TableTag *colPtr, TableTag *rowPtr,
+	      TableTag *cellPtr, int flags)
+{
+    TableStyleKey key;
+    TableStyle *stylePtr;
+    TableTag *tagPtr;
+    Tcl_HashEntry *entryPtr;
+    int new, invert = 0;
+
+    memset((VOID *) &key, 0, sizeof(key));
+    key.colPtr	= colPtr;
+    key.rowPtr	= rowPtr;
+    key.cellPtr	= cellPtr;
+    key.flags	= flags;
+    entryPtr = Tcl_CreateHashEntry(tablePtr->styleTable, (char *) &key, &new);
+    if (!new) {
+	return (TableStyle *) Tcl_GetHashValue(entryPtr);
+    }
+
+    stylePtr = (TableStyle *) ckalloc(sizeof(TableStyle));
+    stylePtr->active	= 0;
+    stylePtr->gc	= NULL;
+    stylePtr->display	= 0;
+
+    /*
+     * Tags have their own priorities which TableMergeTag will
+     * take into account when merging tags.
+     */
+    tagPtr = TableNewTag(tablePtr);
+    TableResetTag(tablePtr, tagPtr);
+    if (colPtr != NULL) {
+	TableMergeTag(tablePtr, tagPtr, colPtr);
+    }
+    if (rowPtr != NULL) {
+	TableMergeTag(tablePtr, tagPtr, rowPtr);
+    }
+    if (flags & STYLE_TITLE) {
+	TableMergeTag(tablePtr, tagPtr,
+		TableTagGetEntry(tablePtr, "title", 0, NULL));
+    }
+    if (cellPtr != NULL) {
+	TableMergeTag(tablePtr, tagPtr, cellPtr);
+    }
+    /* a disabled cell doesn't take the active tag */
+    if ((flags & STYLE_ACTIVE) && (tagPtr->state != STATE_DISABLED)) {
+	TableMergeTag(tablePtr, tagPtr,
+		TableTagGetEntry(tablePtr, "active", 0, NULL));
+	stylePtr->active = 1;
+    }
+    if (flags & STYLE_SEL) {
+	if (tablePtr->invertSelected && !stylePtr->active) {
+	    invert = 1;
+	} else {
+	    TableMergeTag(tablePtr, tagPtr,
+		    TableTagGetEntry(tablePtr, "sel", 0, NULL));
+	}
+    }
+    if (flags & STYLE_FLASH) {
+	TableMergeTag(tablePtr, tagPtr,
+		TableTagGetEntry(tablePtr, "flash", 0, NULL));
+    }
+    if (invert) {
+	TableInvertTag(tagPtr);
+    }
+
+    memcpy((VOID *) &(stylePtr->tag), (VOID *) tagPtr, sizeof(TableTag));
+    ckfree((char *) tagPtr);
+    Tcl_SetHashValue(entryPtr, (ClientData) stylePtr);
+    return stylePtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableFlushStyles --
+ *	Empties the style cache.  This must be called whenever a tag,
+ *	its priority or the table defaults change.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Frees the cached styles and their GCs.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+TableFlushStyles(Table *tablePtr)
+{
+    Tcl_HashEntry *entryPtr;
+    Tcl_HashSearch search;
+    TableStyle *stylePtr;
+
+    if ((tablePtr->styleTable == NULL)
+	    || (tablePtr->styleTable->numEntries == 0)) {
+	return;
+    }
+    for (entryPtr = Tcl_FirstHashEntry(tablePtr->styleTable, &search);
+	 entryPtr != NULL; entryPtr = Tcl_NextHashEntry(&search)) {
+	stylePtr = (TableStyle *) Tcl_GetHashValue(entryPtr);
+	if (stylePtr->gc != NULL) {
+	    XFreeGC(tablePtr->display, stylePtr->gc);
+	}
+	ckfree((char *) stylePtr);
+    }
+    Tcl_DeleteHashTable(tablePtr->styleTable);
+    Tcl_InitHashTable(tablePtr->styleTable, STYLE_KEY_WORDS);
+    tablePtr->styleEpoch++;
 }
 
 /*
@@ -989,6 +1132,8 @@ Table_TagCmd(ClientData clientData, register Tcl_Interp *interp,
 			tagConfig, objc-4, argv+4, (char *) tagPtr,
 			TK_CONFIG_ARGV_ONLY);
 		ckfree((char *) argv);
+		/* even a failed configure may have changed some options */
+		TableFlushStyles(tablePtr);
 		if (result == TCL_ERROR) {
 		    return TCL_ERROR;
 		}
@@ -1087,7 +1232,8 @@ Table_TagCmd(ClientData clientData, register Tcl_Interp *interp,
 		    }
 		    tablePtr->tagPrioSize--;
 
-		    /* Release the tag structure */
+		    /* Release the tag structure and any style using it */
+		    TableFlushStyles(tablePtr);
 		    TableCleanupTag(tablePtr, tagPtr);
 		    ckfree((char *) tagPtr);
 
@@ -1256,6 +1402,7 @@ Table_TagCmd(ClientData clientData, register Tcl_Interp *interp,
 	    }
 	    /* since we deleted a tag, redraw the screen */
 	    if (refresh) {
+		TableFlushStyles(tablePtr);
 		TableInvalidateAll(tablePtr, 0);
 	    }
 	    return TCL_OK;
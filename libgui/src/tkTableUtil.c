@@ -338,3 +338,253 @@ Cmd_GetError(Tcl_Interp *interp, const Cmd_Struct *cmds, const char *arg)
     Tcl_AppendResult(interp, (i?", ":""), cmds->name, (char *) 0);
   }
 }
+
+/*
+ * Row and column geometry.
+ *
+ * Rows (or cols) are all the same size, except for the few listed in a
+ * TableGeom as exceptions, sorted by index.  sums[j] is what the
+ * exceptions before index[j] add to (or take from) the uniform layout,
+ * so the start of any row is i*size plus one prefix sum, and nothing
+ * is ever allocated per row.  Lookups are binary searches over the
+ * exceptions only.
+ */
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableGeomRank --
+ *	Finds how many exceptions come before index i.
+ *
+ * Results:
+ *	The number of exceptions with an index < i.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+TableGeomRank(TableGeom *geomPtr, int i)
+{
+    int lo = 0, hi = geomPtr->num, mid;
+
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (geomPtr->index[mid] < i) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    return lo;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableGeomReset --
+ *	Resets a geometry to count rows|cols of size pixels each.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	All exceptions are dropped, but their space is kept.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+TableGeomReset(TableGeom *geomPtr, int count, int size)
+{
+    geomPtr->count	= MAX(0, count);
+    geomPtr->size	= size;
+    geomPtr->num	= 0;
+    if (geomPtr->sums != NULL) {
+	geomPtr->sums[0] = 0;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableGeomSet --
+ *	Sets the pixel size of row|col i.  Setting them in increasing
+ *	order, as TableAdjustParams does, only ever appends.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	May grow the exception arrays.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+TableGeomSet(TableGeom *geomPtr, int i, int pixels)
+{
+    int j, pos;
+
+    if (i < 0 || i >= geomPtr->count) {
+	return;
+    }
+    pos = TableGeomRank(geomPtr, i);
+    if (pos == geomPtr->num || geomPtr->index[pos] != i) {
+	if (geomPtr->max == 0) {
+	    /* ckrealloc can't be relied on to handle NULLs before 8.2.1 */
+	    geomPtr->max = 16;
+	    geomPtr->index = (int *) ckalloc(geomPtr->max * sizeof(int));
+	    geomPtr->pixels = (int *) ckalloc(geomPtr->max * sizeof(int));
+	    geomPtr->sums = (int *) ckalloc((geomPtr->max + 1) * sizeof(int));
+	    geomPtr->sums[0] = 0;
+	} else if (geomPtr->num == geomPtr->max) {
+	    geomPtr->max *= 2;
+	    geomPtr->index = (int *) ckrealloc((char *) geomPtr->index,
+		    geomPtr->max * sizeof(int));
+	    geomPtr->pixels = (int *) ckrealloc((char *) geomPtr->pixels,
+		    geomPtr->max * sizeof(int));
+	    geomPtr->sums = (int *) ckrealloc((char *) geomPtr->sums,
+		    (geomPtr->max + 1) * sizeof(int));
+	}
+	if (pos < geomPtr->num) {
+	    memmove((VOID *) (geomPtr->index + pos + 1),
+		    (VOID *) (geomPtr->index + pos),
+		    (geomPtr->num - pos) * sizeof(int));
+	    memmove((VOID *) (geomPtr->pixels + pos + 1),
+		    (VOID *) (geomPtr->pixels + pos),
+		    (geomPtr->num - pos) * sizeof(int));
+	}
+	geomPtr->num++;
+	geomPtr->index[pos] = i;
+    }
+    geomPtr->pixels[pos] = pixels;
+    for (j = pos; j < geomPtr->num; j++) {
+	geomPtr->sums[j+1] = geomPtr->sums[j]
+	    + geomPtr->pixels[j] - geomPtr->size;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableGeomPixels --
+ *	Returns the pixel size of row|col i.
+ *
+ * Results:
+ *	The size in pixels.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+TableGeomPixels(TableGeom *geomPtr, int i)
+{
+    int pos = TableGeomRank(geomPtr, i);
+
+    if (pos < geomPtr->num && geomPtr->index[pos] == i) {
+	return geomPtr->pixels[pos];
+    }
+    return geomPtr->size;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableGeomStart --
+ *	Returns the first pixel of row|col i.  The start of row|col
+ *	count is the total height|width.
+ *
+ * Results:
+ *	The start in pixels.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+TableGeomStart(TableGeom *geomPtr, int i)
+{
+    CONSTRAIN(i, 0, geomPtr->count);
+    return i * geomPtr->size + ((geomPtr->num == 0) ? 0 :
+	    geomPtr->sums[TableGeomRank(geomPtr, i)]);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableGeomFind --
+ *	Maps a pixel back to a row|col.
+ *
+ * Results:
+ *	The last row|col i whose start is <= pixel, which is count
+ *	when pixel lies beyond the end.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+TableGeomFind(TableGeom *geomPtr, int pixel)
+{
+    int lo = 0, hi = geomPtr->num, mid, i, start, limit;
+
+    if (pixel <= 0) {
+	pixel = 0;
+    }
+    /* find the last exception starting at or before pixel */
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (geomPtr->index[mid] * geomPtr->size + geomPtr->sums[mid]
+		<= pixel) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    /* the uniform run after it ends just before the next exception */
+    limit = (lo < geomPtr->num) ? geomPtr->index[lo] - 1 : geomPtr->count;
+    if (--lo < 0) {
+	i = 0;
+	start = 0;
+    } else {
+	start = geomPtr->index[lo] * geomPtr->size + geomPtr->sums[lo];
+	if (pixel < start + geomPtr->pixels[lo]) {
+	    return geomPtr->index[lo];
+	}
+	i = geomPtr->index[lo] + 1;
+	start += geomPtr->pixels[lo];
+    }
+    if (geomPtr->size > 0) {
+	i += (pixel - start) / geomPtr->size;
+    } else {
+	i = limit;
+    }
+    return MIN(i, limit);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TableGeomFree --
+ *	Frees the exception arrays of a geometry.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+TableGeomFree(TableGeom *geomPtr)
+{
+    if (geomPtr->index) ckfree((char *) geomPtr->index);
+    if (geomPtr->pixels) ckfree((char *) geomPtr->pixels);
+    if (geomPtr->sums) ckfree((char *) geomPtr->sums);
+    memset((VOID *) geomPtr, 0, sizeof(TableGeom));
+}